@@ -0,0 +1,103 @@
+// VL_ReadDirectoryFilesRecursively stores ~100k paths in the temporary arena
+#define VICLIB_TEMP_SIZE (64*1024*1024)
+#define VL_BUILD_IMPLEMENTATION
+#include "../vl_build.h"
+
+/* Benchmark for the parallel directory walker
+ * usage: dir_walk_bench [tree directory] [dirs per level] [depth] [files per leaf dir] [threads]
+ * The defaults generate 16 + 16^2 + 16^3 directories and ~100k files
+ */
+
+typedef struct {
+    vl_mutex lock;
+    size_t files;
+    size_t dirs;
+} walk_counts;
+
+static bool CountVisit(vl_walk_entry *entry, void *userData)
+{
+    walk_counts *counts = (walk_counts*)userData;
+    VL_MutexLock(&counts->lock);
+    if(entry->type == VL_FILE_DIRECTORY) counts->dirs++;
+    else counts->files++;
+    VL_MutexUnlock(&counts->lock);
+    return true;
+}
+
+static bool GenerateTree(string_builder *path, int dirsPerLevel, int depth, int filesPerLeaf)
+{
+    size_t mark = path->count;
+    if(!MkdirIfNotExist(path->items)) return false;
+
+    if(depth == 0) {
+        for(int i = 0; i < filesPerLeaf; i++) {
+            path->count = mark;
+            SbAppendf(path, "/file%d.c", i);
+            if(!WriteEntireFile(path->items, path->items, path->count)) return false;
+        }
+    } else {
+        for(int i = 0; i < dirsPerLevel; i++) {
+            path->count = mark;
+            SbAppendf(path, "/dir%d", i);
+            if(!GenerateTree(path, dirsPerLevel, depth - 1, filesPerLeaf)) return false;
+        }
+    }
+    path->count = mark;
+    path->items[mark] = '\0';
+    return true;
+}
+
+static void BenchWalk(const char *tree, size_t threads)
+{
+    walk_counts counts = {0};
+    VL_MutexInit(&counts.lock);
+    u64 start = VL_GetNanos();
+    bool ok = VL_WalkDirectory(tree, CountVisit, .userData = &counts, .threads = threads);
+    u64 time = VL_GetNanos() - start;
+    VL_MutexDestroy(&counts.lock);
+    printf("walk  %2zu threads: "PRINT_TIME_Fmt" (%zu dirs, %zu files)%s\n",
+           threads, PRINT_TIME_Arg(time), counts.dirs, counts.files, ok ? "" : " FAILED");
+}
+
+static void BenchCopy(const char *tree, size_t threads)
+{
+    const char *dst = temp_sprintf("%s_copy%zu", tree, threads);
+    u64 start = VL_GetNanos();
+    bool ok = VL_CopyDirectoryRecursively(tree, dst, .threads = threads);
+    u64 time = VL_GetNanos() - start;
+    printf("copy  %2zu threads: "PRINT_TIME_Fmt"%s\n", threads, PRINT_TIME_Arg(time), ok ? "" : " FAILED");
+}
+
+int main(int argc, char **argv)
+{
+    VL_Init();
+    const char *tree = argc > 1 ? argv[1] : "dir_walk_bench_tree";
+    int dirsPerLevel = argc > 2 ? atoi(argv[2]) : 16;
+    int depth = argc > 3 ? atoi(argv[3]) : 3;
+    int filesPerLeaf = argc > 4 ? atoi(argv[4]) : 24;
+
+    if(!VL_FileExists(tree)) {
+        VL_MinimalLogLevel = VL_WARNING;
+        string_builder path = {0};
+        SbAppendf(&path, "%s", tree);
+        printf("generating %s...\n", tree);
+        if(!GenerateTree(&path, dirsPerLevel, depth, filesPerLeaf)) return 1;
+        SbFree(path);
+    }
+
+    size_t procs = argc > 5 ? (size_t)atoi(argv[5]) : (size_t)VL_GetCountProcs();
+    BenchWalk(tree, 1);
+    BenchWalk(tree, procs);
+
+    vl_file_paths files = {0};
+    u64 start = VL_GetNanos();
+    VL_ReadDirectoryFilesRecursively(tree, &files);
+    u64 time = VL_GetNanos() - start;
+    printf("VL_ReadDirectoryFilesRecursively: "PRINT_TIME_Fmt" (%zu files)\n", PRINT_TIME_Arg(time), files.count);
+    DaFree(files);
+    temp_reset();
+
+    BenchCopy(tree, 1);
+    BenchCopy(tree, procs);
+    return 0;
+}
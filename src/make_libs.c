@@ -10,48 +10,47 @@
 #define DEBUG_DIRECTORY "debug"
 #define RELEASE_DIRECTORY "release"
 
-bool CompileLib(vl_cmd *cmd, vl_compile_ctx *ctx, const char *name, bool debug)
+// Every library is built as static and dynamic, none of them depend on each other so they all run in parallel.
+// Each variant writes its files to its own directory
+void AddLibTargets(vl_build_graph *graph, vl_compile_ctx ctx, const char *name, bool debug)
 {
-    ctx->debug = debug;
-    ctx->output = name;
-    ctx->sourceFiles.count = 0;
-    DaAppend(&ctx->sourceFiles, temp_sprintf("../src/%s.c", name));
+    ctx.debug = debug;
+    ctx.output = name;
+    ctx.sourceFiles = (vl_file_paths){0};
+    DaAppend(&ctx.sourceFiles, temp_sprintf("../src/%s.c", name));
 
 #if OS_WINDOWS
-    ctx->cc = CCompiler_MSVC;
-    ctx->type = Compile_StaticLibrary;
-    ctx->outputDir = temp_sprintf("%s/msvc", debug ? DEBUG_DIRECTORY : RELEASE_DIRECTORY);
-    if(!VL_CCompile(cmd, ctx)) {
-        fprintf(stderr, "Could not build %s.lib", name);
-        return false;
-    }
+    ctx.cc = CCompiler_MSVC;
+    ctx.type = Compile_StaticLibrary;
+    ctx.outputDir = temp_sprintf("%s/msvc", debug ? DEBUG_DIRECTORY : RELEASE_DIRECTORY);
+    // NOTE: /FS since the compiles running at once share the pdb of their directory
+    ctx.extraMsvcFlags = (vl_file_paths){0};
+    DaAppend(&ctx.extraMsvcFlags, "/FS");
+    DaAppend(&ctx.extraMsvcFlags, temp_sprintf("/Fd:%s/", ctx.outputDir));
+    VL_GraphAddCompile(graph, temp_sprintf("%s/%s.lib", ctx.outputDir, name), ctx);
 
-    ctx->type = Compile_DynamicLibrary;
-    if(!VL_CCompile(cmd, ctx)) {
-        fprintf(stderr, "Could not build %s.dll", name);
-        return false;
-    }
+    // NOTE: The import library of the dll is "<name>.lib" too, so dlls have their own directory.
+    // cl writes the object of a compile that links to the current directory without /Fo
+    ctx.type = Compile_DynamicLibrary;
+    ctx.outputDir = temp_sprintf("%s/msvc/dll", debug ? DEBUG_DIRECTORY : RELEASE_DIRECTORY);
+    ctx.extraMsvcFlags = (vl_file_paths){0};
+    DaAppend(&ctx.extraMsvcFlags, "/FS");
+    DaAppend(&ctx.extraMsvcFlags, temp_sprintf("/Fd:%s/", ctx.outputDir));
+    DaAppend(&ctx.extraMsvcFlags, temp_sprintf("/Fo:%s/%s.obj", ctx.outputDir, name));
+    VL_GraphAddCompile(graph, temp_sprintf("%s/%s.dll", ctx.outputDir, name), ctx);
 #endif
 
-    ctx->outputDir = temp_sprintf("%s/" GCC_OUT_DIRECTORY, debug ? DEBUG_DIRECTORY : RELEASE_DIRECTORY);
-    ctx->cc = CCompiler_GCC;
-    ctx->type = Compile_StaticLibrary;
-    ctx->extraCompilerFlags.count = 0;
-    if(!VL_CCompile(cmd, ctx)) {
-        fprintf(stderr, "Could not build "GCC_OUT_DIRECTORY"/lib%s.a", name);
-        return false;
-    }
+    ctx.outputDir = temp_sprintf("%s/" GCC_OUT_DIRECTORY, debug ? DEBUG_DIRECTORY : RELEASE_DIRECTORY);
+    ctx.cc = CCompiler_GCC;
+    ctx.type = Compile_StaticLibrary;
+    ctx.extraCompilerFlags = (vl_file_paths){0};
+    VL_GraphAddCompile(graph, temp_sprintf("%s/lib%s.a", ctx.outputDir, name), ctx);
 
-    ctx->type = Compile_DynamicLibrary;
+    ctx.type = Compile_DynamicLibrary;
 #if !OS_WINDOWS
-    DaAppend(&ctx->extraCompilerFlags, "-fPIC");
+    DaAppend(&ctx.extraCompilerFlags, "-fPIC");
 #endif
-    if(!VL_CCompile(cmd, ctx)) {
-        fprintf(stderr, "Could not build "GCC_OUT_DIRECTORY"%s" VL_DLL_EXTENSION, name);
-        return false;
-    }
-
-    return true;
+    VL_GraphAddCompile(graph, temp_sprintf("%s/%s" VL_DLL_EXTENSION, ctx.outputDir, name), ctx);
 }
 
 int main(int argc, char **argv)
@@ -61,7 +60,6 @@ int main(int argc, char **argv)
     MkdirIfNotExist("bin");
     VL_Pushd("bin");
 
-    vl_cmd cmd = {0};
     vl_compile_ctx ctx = {
         .cc = CCompiler_MSVC,
         .type = Compile_StaticLibrary,
@@ -75,18 +73,24 @@ int main(int argc, char **argv)
 #if defined(_WIN32)
     MkdirIfNotExist(DEBUG_DIRECTORY   "/msvc");
     MkdirIfNotExist(RELEASE_DIRECTORY "/msvc");
+    MkdirIfNotExist(DEBUG_DIRECTORY   "/msvc/dll");
+    MkdirIfNotExist(RELEASE_DIRECTORY "/msvc/dll");
 #endif
     MkdirIfNotExist(DEBUG_DIRECTORY "/" GCC_OUT_DIRECTORY);
     MkdirIfNotExist(RELEASE_DIRECTORY "/" GCC_OUT_DIRECTORY);
 
-    CompileLib(&cmd, &ctx, "viclib", true);
-    CompileLib(&cmd, &ctx, "vl_build", true);
-    CompileLib(&cmd, &ctx, "vl_serialize", true);
+    vl_build_graph graph = {0};
+    AddLibTargets(&graph, ctx, "viclib", true);
+    AddLibTargets(&graph, ctx, "vl_build", true);
+    AddLibTargets(&graph, ctx, "vl_serialize", true);
+
+    AddLibTargets(&graph, ctx, "viclib", false);
+    AddLibTargets(&graph, ctx, "vl_build", false);
+    AddLibTargets(&graph, ctx, "vl_serialize", false);
 
-    CompileLib(&cmd, &ctx, "viclib", false);
-    CompileLib(&cmd, &ctx, "vl_build", false);
-    CompileLib(&cmd, &ctx, "vl_serialize", false);
+    bool ok = VL_GraphRun(&graph);
+    VL_GraphFree(&graph);
 
     VL_Popd();
-    return 0;
+    return ok ? 0 : 1;
 }
\ No newline at end of file
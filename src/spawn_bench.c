@@ -0,0 +1,92 @@
+#define VL_BUILD_IMPLEMENTATION
+#include "../vl_build.h"
+
+/* Benchmark for starting processes
+ * usage: spawn_bench [processes] [ballast MiB]
+ * The ballast is touched memory that makes this process as big as a build driver with a stat cache,
+ * fork gets slower the more memory the parent has mapped, posix_spawn shouldn't
+ */
+
+#if !OS_WINDOWS
+// The old way VL_CmdStartProcess worked, to compare against
+static vl_proc ForkExec(vl_cmd cmd)
+{
+    pid_t cpid = fork();
+    if(cpid == 0) {
+        vl_cmd cmdNull = {0};
+        DaAppendMany(&cmdNull, cmd.items, cmd.count);
+        CmdAppend(&cmdNull, NULL);
+        execvp(cmd.items[0], (char * const*)cmdNull.items);
+        exit(1);
+    }
+    return cpid;
+}
+#endif
+
+static void BenchSpawn(const char *name, vl_cmd cmd, int count, bool useFork)
+{
+    u64 start = VL_GetNanos();
+    bool ok = true;
+    for(int i = 0; i < count && ok; i++) {
+#if !OS_WINDOWS
+        vl_proc proc = useFork ? ForkExec(cmd) : VL_CmdStartProcess(cmd, 0, 0, 0, false);
+#else
+        (void)useFork;
+        vl_proc proc = VL_CmdStartProcess(cmd, 0, 0, 0, false);
+#endif
+        ok = VL_ProcWait(proc);
+    }
+    u64 time = VL_GetNanos() - start;
+    printf("%-20s %d processes: %8.2fms (%6.1f us/process)%s\n", name, count,
+           (double)time/1e6, (double)time/1e3/count, ok ? "" : " FAILED");
+}
+
+static void BenchAsync(vl_cmd cmd, int count, size_t maxProcs)
+{
+    vl_procs procs = {0};
+    vl_cmd run = {0};
+    u64 start = VL_GetNanos();
+    bool ok = true;
+    for(int i = 0; i < count && ok; i++) {
+        CmdExtend(&run, &cmd);
+        ok = CmdRun(&run, .async = &procs, .maxProcs = maxProcs);
+    }
+    ok = VL_ProcsWait(procs) && ok;
+    u64 time = VL_GetNanos() - start;
+    printf("CmdRun async %2zu jobs %d processes: %8.2fms (%6.1f us/process)%s\n", maxProcs, count,
+           (double)time/1e6, (double)time/1e3/count, ok ? "" : " FAILED");
+    DaFree(procs);
+    CmdFree(run);
+}
+
+int main(int argc, char **argv)
+{
+    VL_Init();
+    // NOTE: Don't print every command CmdRun runs
+    VL_MinimalLogLevel = VL_WARNING;
+    int count = argc > 1 ? atoi(argv[1]) : 500;
+    size_t ballastMiB = argc > 2 ? (size_t)atoi(argv[2]) : 512;
+
+    char *ballast = (char*)malloc(ballastMiB*1024*1024);
+    if(ballastMiB && !ballast) {
+        fprintf(stderr, "Could not allocate %zu MiB\n", ballastMiB);
+        return 1;
+    }
+    // NOTE: Touch every page so it's actually mapped
+    for(size_t i = 0; i < ballastMiB*1024*1024; i += 4096) ballast[i] = (char)i;
+    printf("ballast: %zu MiB\n", ballastMiB);
+
+    vl_cmd cmd = {0};
+#if OS_WINDOWS
+    CmdAppend(&cmd, "cmd.exe", "/c", "exit", "0");
+#else
+    CmdAppend(&cmd, "true");
+    BenchSpawn("fork+execvp", cmd, count, true);
+#endif
+    BenchSpawn("VL_CmdStartProcess", cmd, count, false);
+    BenchAsync(cmd, count, (size_t)VL_GetCountProcs());
+
+    CmdFree(cmd);
+    free(ballast);
+    return 0;
+}
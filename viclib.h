@@ -2275,7 +2275,8 @@ defer:
     return result;
 
 #elif OS_LINUX || OS_MAC
-    int fd = open(File, O_CREAT | O_WRONLY | O_TRUNC);
+    // NOTE: O_CREAT without a mode takes whatever is on the stack as the permissions
+    int fd = open(File, O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
     if(fd == -1) {
         if(errno == EACCES || errno == EPERM) VL_ErrorNumber = ERROR_FILE_ACCESS_DENIED;
         else if(errno == ENOMEM) VL_ErrorNumber = ERROR_NO_MEM;
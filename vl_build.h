@@ -33,6 +33,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <pthread.h>
 #endif
 
 #define VL_INC_STDIO_H
@@ -106,10 +107,138 @@ typedef struct {
     size_t capacity;
 } vl_file_paths;
 
+/* Minimal threads, only used where the work is not process based (directory walking) */
+#if OS_WINDOWS
+typedef HANDLE vl_thread;
+typedef SRWLOCK vl_mutex;
+typedef CONDITION_VARIABLE vl_cond;
+#else
+typedef pthread_t vl_thread;
+typedef pthread_mutex_t vl_mutex;
+typedef pthread_cond_t vl_cond;
+#endif
+
+typedef void (*vl_thread_proc)(void *arg);
+
+VLIBPROC bool VL_ThreadStart(vl_thread *thread, vl_thread_proc proc, void *arg);
+VLIBPROC void VL_ThreadJoin(vl_thread thread);
+VLIBPROC void VL_MutexInit(vl_mutex *mutex);
+VLIBPROC void VL_MutexLock(vl_mutex *mutex);
+VLIBPROC void VL_MutexUnlock(vl_mutex *mutex);
+VLIBPROC void VL_MutexDestroy(vl_mutex *mutex);
+VLIBPROC void VL_CondInit(vl_cond *cond);
+VLIBPROC void VL_CondWait(vl_cond *cond, vl_mutex *mutex);
+VLIBPROC void VL_CondBroadcast(vl_cond *cond);
+VLIBPROC void VL_CondDestroy(vl_cond *cond);
+
+typedef struct {
+    u64 mtime; /* last write time, nanoseconds since the epoch on posix and a FILETIME on windows */
+    u64 size;
+    u64 inode; /* always 0 on windows */
+    file_type type;
+} vl_file_stat;
+
+// Follows symlinks
+VLIBPROC bool VL_GetFileStat(const char *path, vl_file_stat *fileStat);
+
+#ifndef VL_DIR_ITER_BUFFER_SIZE
+# define VL_DIR_ITER_BUFFER_SIZE (8*1024)
+#endif
+
+typedef struct {
+    view name; /* null terminated, only valid until the next VL_DirIterNext */
+    file_type type; /* from d_type, the entry is only stat'ed if the filesystem doesn't provide it */
+} vl_dir_entry;
+
+/* Streaming directory reader, doesn't allocate. "." and ".." are skipped.
+Usage:
+```c
+vl_dir_iter it;
+if(VL_DirIterOpen(&it, "src", .ext = ".c")) {
+    while(VL_DirIterNext(&it)) {
+        printf(VIEW_FMT"\n", VIEW_ARG(it.entry.name));
+    }
+    VL_DirIterClose(&it);
+}
+```
+ */
+typedef struct {
+    const char *path;
+    view ext;
+    const char *glob;
+    bool failed; /* VL_DirIterNext returned false because of an error */
+    vl_dir_entry entry;
+
+    bool hasStat;
+    vl_file_stat stat;
+#if OS_WINDOWS
+    HANDLE hFind;
+    WIN32_FIND_DATAA data;
+    bool pendingFirst;
+#else
+    int fd; /* the directory, use it with the *at() syscalls */
+# if OS_LINUX
+    u64 buffer[VL_DIR_ITER_BUFFER_SIZE/sizeof(u64)];
+    size_t bufferCount;
+    size_t bufferPos;
+# else
+    void *dir; /* DIR* */
+# endif
+#endif
+} vl_dir_iter;
+
+struct VL_DirIterOpen_opts {
+    const char *path;
+    /* Filters, they don't apply to directories so recursive walks can still descend */
+    const char *ext; /* only entries ending with ext, like VL_CopyDirectoryRecursively */
+    const char *glob; /* only entries matching the pattern, see VL_GlobMatch */
+    bool quietMissing; /* a directory that doesn't exist (anymore) fails without logging an error */
+};
+
+#define VL_DirIterOpen(iter, dir_path, ...) \
+    VL_DirIterOpen_Opt((iter), (struct VL_DirIterOpen_opts){.path = (dir_path), __VA_ARGS__})
+VLIBPROC bool VL_DirIterOpen_Opt(vl_dir_iter *it, struct VL_DirIterOpen_opts opt);
+VLIBPROC bool VL_DirIterNext(vl_dir_iter *it);
+// Lazily stats the current entry (without following symlinks), at most once per entry
+VLIBPROC bool VL_DirIterStat(vl_dir_iter *it, vl_file_stat *fileStat);
+VLIBPROC void VL_DirIterClose(vl_dir_iter *it);
+
+// Supports '*', '?' and character classes ("[abc]", "[a-z]", "[!abc]")
+VLIBPROC bool VL_GlobMatch(const char *pattern, view name);
+
+typedef struct {
+    const char *path; /* root path + relative path */
+    const char *relPath; /* path relative to the root, "" for the root itself */
+    const char *name; /* last component of path */
+    file_type type; /* taken from d_type when possible, so no stat is needed */
+    int worker; /* index of the thread visiting this entry, in [0, threads) */
+#if !OS_WINDOWS
+    int dirFd; /* parent directory, use it with the *at() syscalls. -1 for the root */
+#endif
+} vl_walk_entry;
+
+/* Called from worker threads, return false to stop the walk.
+ * Directories are visited before any of their children */
+typedef bool (*vl_walk_proc)(vl_walk_entry *entry, void *userData);
+
+struct VL_WalkDirectory_opts {
+    const char *root;
+    vl_walk_proc visit;
+    void *userData;
+    size_t threads; /* 0 means VL_GetCountProcs() */
+};
+
+/* Parallel recursive directory walk. Each thread has its own queue of directories
+ * and steals from the others when it runs out */
+#define VL_WalkDirectory(root_path, visit_proc, ...) \
+    VL_WalkDirectory_Opt((struct VL_WalkDirectory_opts){.root = (root_path), .visit = (visit_proc), __VA_ARGS__})
+VLIBPROC bool VL_WalkDirectory_Opt(struct VL_WalkDirectory_opts opt);
+
 struct VL_CopyDirectoryRecursively_opts {
     const char *src;
     const char *dst;
     const char *ext;
+    size_t threads; /* 0 means VL_GetCountProcs() */
 };
 
 VLIBPROC bool MkdirIfNotExist(const char *path);
@@ -118,6 +247,7 @@ VLIBPROC bool VL_CopyFile(const char *src, const char *dst);
     VL_CopyDirectoryRecursively_Opt((struct VL_CopyDirectoryRecursively_opts){.src = (src_path), __VA_ARGS__})
 VLIBPROC bool VL_CopyDirectoryRecursively_Impl(const char *src_path, const char *dst_path, const char *ext);
 VLIBPROC bool VL_CopyDirectoryRecursively_Opt(struct VL_CopyDirectoryRecursively_opts opt);
+// Order of the children is not specified since the directory is walked in parallel
 VLIBPROC bool VL_ReadDirectoryFilesRecursively(const char *parent, vl_file_paths *children);
 VLIBPROC bool VL_ReadEntireDir(const char *parent, vl_file_paths *children);
 VLIBPROC bool VL_DeleteFile(const char *path);
@@ -211,6 +341,10 @@ VLIBPROC int VL__ProcWaitAsync(vl_proc proc, int ms);
 // Wait until all the processes have finished
 VLIBPROC bool VL_ProcsWait(vl_procs procs);
 
+/* Blocks until any of the processes ends (pidfds kept until it's reaped or a SIGCHLD pipe, on windows
+ * WaitForMultipleObjects with a thread per batch of handles if there's more than 64) and returns its index, ok tells whether it succeeded. It's reaped, so remove it from the list */
+VLIBPROC size_t VL_ProcsWaitAny(vl_procs procs, bool *ok);
+
 // Wait until all the processes have finished and empty the procs array.
 VLIBPROC bool VL_ProcsFlush(vl_procs *procs);
 
@@ -233,6 +367,12 @@ typedef struct {
     const char *stdinPath;
     const char *stdoutPath;
     const char *stderrPath;
+    /* Capture stdout and stderr (the ones not redirected to a path) and print them all at once when
+     * the command ends, so the output of parallel commands doesn't interleave.
+     * It's read while waiting on the command, so start and wait captured commands from one thread */
+    bool captureOutput;
+    // With captureOutput, print the output in the order the commands were started, not the order they end
+    bool orderedOutput;
 } vl_cmd_opts;
 
 // Render a string representation of a command into a string builder. Keep in mind the the
@@ -244,6 +384,52 @@ VLIBPROC bool CmdRun_Opt(vl_cmd_opts opt);
 /* '/dev/null' on windows will be automatically changed to 'NUL' and vice versa */
 #define CmdRun(Cmd, ...) CmdRun_Opt((vl_cmd_opts){.cmd = (Cmd), __VA_ARGS__})
 
+typedef struct {
+    vl_proc proc;
+    char token; /* the byte read from the jobserver, written back when proc ends */
+    bool implicit; /* the token this process has without reading it, nothing to give back */
+} vl__jobserver_token;
+
+typedef struct {
+    bool disabled; /* don't use the jobserver in MAKEFLAGS, set it before running anything */
+    bool initialized;
+    bool client; /* CmdRun takes tokens */
+    bool server; /* made by VL_JobserverServe */
+#if OS_WINDOWS
+    HANDLE semaphore;
+#else
+    int readFd; /* its own open file description, nonblocking, when it could be made */
+    int writeFd;
+    bool pollRead; /* readFd is make's, it's polled before reading instead */
+#endif
+    char *fifoPath; /* made by VL_JobserverServe, removed by VL_JobserverFree */
+    char *previousMakeflags;
+    struct {
+        vl__jobserver_token *items;
+        size_t count;
+        size_t capacity;
+    } held; /* by the running commands */
+} vl_jobserver;
+
+extern vl_jobserver VL_jobserver;
+
+/* GNU make jobserver: when MAKEFLAGS has --jobserver-auth (the build runs from a make rule with -j and '+'),
+ * every command CmdRun starts takes a token from it first, so nested builds share one parallelism budget.
+ * The first running command uses the token this process has. The token of a command that ended goes to
+ * the next one even before it's waited for, so the jobs limit of VL_CCompile and VL_GraphRun still works */
+VLIBPROC bool VL_JobserverActive(void);
+
+struct VL_JobserverServe_opts {
+    size_t jobs; /* 0 means VL_GetCountProcs() */
+    bool pipeFds; /* "--jobserver-auth=R,W" for make older than 4.4, instead of "fifo:PATH" (ninja only reads fifos) */
+};
+/* Makes this process the jobserver of the commands it runs: MAKEFLAGS gets the jobs tokens, so make, ninja (1.13+)
+ * and cmake --build started by it take from the same jobs as CmdRun. Nothing is done when there's one already */
+VLIBPROC bool VL_JobserverServe_Opt(struct VL_JobserverServe_opts opt);
+#define VL_JobserverServe(Jobs, ...) VL_JobserverServe_Opt((struct VL_JobserverServe_opts){.jobs = (Jobs), __VA_ARGS__})
+// Closes the jobserver, MAKEFLAGS is set back when it was made by VL_JobserverServe
+VLIBPROC void VL_JobserverFree(void);
+
 #define CmdAppend(cmd, ...) \
     DaAppendMany(cmd, \
                   ((const char*[]){__VA_ARGS__}), \
@@ -275,6 +461,8 @@ extern struct vl__pushd_buf_type VL__pushDirectoryBuffer;
 VLIBPROC const char *VL_PathName(const char *path);
 VLIBPROC bool VL_Rename(const char *old, const char *New);
 VLIBPROC const char *VL_temp_GetCurrentDir(void);
+// Path of the program name in PATH (".exe" is added on windows if it has no extension) on the temporary storage, NULL if it's not there
+VLIBPROC const char *VL_temp_FindExecutable(const char *name);
 VLIBPROC bool VL_SetCurrentDir(const char *path);
 VLIBPROC bool VL_Pushd(const char *path);
 VLIBPROC bool VL_Popd(void);
@@ -290,11 +478,27 @@ VLIBPROC bool VL_GetLastWriteTime(const char *file, u64 *writeTime);
 #define VL_NeedsRebuild(out, in, ...) VL_NeedsRebuild_Impl(out, ((const char*[]){in, __VA_ARGS__}), sizeof((const char*[]){in, __VA_ARGS__})/sizeof(const char*))
 VLIBPROC int VL_NeedsRebuild_Impl(const char *output_path, const char **input_paths, size_t input_paths_count);
 
+typedef struct {
+    view name;
+    bool angled; /* <name> */
+} vl__include;
+
 typedef struct vl_filetime_node vl_filetime_node;
 struct vl_filetime_node {
     view file;
-    u64 time;
-    //bool exploredAllDependencies;
+    u64 time; /* vl_file_stat.mtime */
+    u64 size;
+    u64 inode;
+    file_type type;
+    bool exists;
+    bool checked; /* stat'ed by this process since it was last invalidated */
+    bool persisted; /* loaded with VL_FileTimeCacheLoad */
+    bool hasHash; /* contentHash is valid for this (time, size, inode) */
+    u64 contentHash;
+    bool hasIncludes; /* includes are valid for this (time, size, inode) */
+    u32 includeCount;
+    vl__include *includes; /* the #include directives, resolved on every VL_ScanIncludes. On the heap with their names */
+    u32 scanMark;
     vl_filetime_node *next;
 };
 
@@ -302,8 +506,14 @@ struct vl_filetime_node {
 #define VL_BUILD_FILETIME_TABLE_SIZE 1024
 #endif // VL_BUILD_FILETIME_TABLE_SIZE
 
+/* Only used when VL_needsRebuildContext.Arena is not set. It has the paths and build database entries, one
+   per path however often they change, when it's full new paths stop being cached (logged once) */
+#ifndef VL_BUILD_FILETIME_ARENA_SIZE
+#define VL_BUILD_FILETIME_ARENA_SIZE (16*1024*1024)
+#endif // VL_BUILD_FILETIME_ARENA_SIZE
+
 typedef struct {
-    vl_filetime_node *items;
+    vl_filetime_node *items; /* VL_BUILD_FILETIME_TABLE_SIZE buckets, collisions are chained */
     size_t count;
     size_t capacity;
 } vl_filetime_nodelist;
@@ -313,15 +523,89 @@ typedef struct {
     uint32_t countTimes;
 } vl_filetime_table;
 
+typedef struct {
+    view path;
+    u64 hash;
+} vl_build_db_input;
+
+typedef struct vl_build_db_entry vl_build_db_entry;
+struct vl_build_db_entry {
+    view output;
+    u64 commandHash;
+    vl_build_db_input *inputs; /* on the heap with their paths, replaced by each record */
+    size_t inputCount;
+    bool recorded;
+    /* Inputs found by the last VL_Needs_C_Rebuild, recorded once VL_CCompile succeeds. Can be inputs */
+    vl_build_db_input *pending;
+    size_t pendingCount;
+    vl_build_db_entry *next;
+};
+
+typedef struct {
+    vl_build_db_entry **buckets; /* VL_BUILD_FILETIME_TABLE_SIZE, collisions are chained */
+    uint32_t countEntries;
+    uint32_t countRecords; /* records in the file, it gets compacted when there are too many */
+    bool loaded;
+} vl_build_db;
+
+/* Stat cache used by every rebuild check, so each path is stat'ed at most once per process.
+ * It's not thread safe. Files written by the build have to be invalidated with
+ * VL_FileTimeInvalidate, VL_CCompile does it for its outputs and VL_WatchRebuild for changed paths */
 typedef struct {
     vl_filetime_table table;
-    vl_filetime_node *freelist;
     vl_file_paths *includePaths;
-    memory_arena *Arena;
+    memory_arena *Arena; /* allocated on first use if not set */
+
+    /* Content hash mode: VL_Needs_C_Rebuild compares the hashes of the inputs (sources, precompiled header,
+     * extraDependencies and includes, as the depfile of the last compile lists them) and of the compile
+     * command against the ones recorded by the last successful VL_CCompile instead of mtimes,
+     * so touching a file or checking out a branch doesn't rebuild anything that didn't change */
+    bool contentHash;
+    const char *buildDbPath; /* the records, loaded on first use and appended to, NULL keeps them in memory */
+    vl_build_db buildDb;
+    u32 scanMark; /* last VL_ScanIncludes, to visit each header once */
 } vl_needrebuild_context;
 
 extern vl_needrebuild_context VL_needsRebuildContext;
 
+// Like VL_GetFileStat but memoized in VL_needsRebuildContext. Returns false if the file doesn't exist
+VLIBPROC bool VL_GetFileStatCached(const char *path, vl_file_stat *fileStat);
+VLIBPROC void VL_FileTimeInvalidate(const char *path);
+// Every path is stat'ed again, for when it's not known what changed
+VLIBPROC void VL_FileTimeInvalidateAll(void);
+/* The cache file keeps (mtime, size, inode) and the content hash per path. Loaded entries are still
+ * stat'ed once, the hash is reused if the file has the same mtime, size and inode */
+VLIBPROC bool VL_FileTimeCacheLoad(const char *cache_path);
+VLIBPROC bool VL_FileTimeCacheSave(const char *cache_path);
+
+// xxHash64
+typedef struct {
+    u64 lanes[4];
+    u64 seed;
+    u64 total;
+    u8 tail[32];
+    size_t tailCount;
+} vl_hash_state;
+
+VLIBPROC void VL_HashBegin(vl_hash_state *state, u64 seed);
+VLIBPROC void VL_HashUpdate(vl_hash_state *state, const void *data, size_t size);
+VLIBPROC u64 VL_HashEnd(vl_hash_state *state);
+VLIBPROC u64 VL_HashBytes(const void *data, size_t size, u64 seed);
+
+#ifndef VL_HASH_FILE_CHUNK_SIZE
+#define VL_HASH_FILE_CHUNK_SIZE (64*1024)
+#endif // VL_HASH_FILE_CHUNK_SIZE
+
+// Streams the file with ReadFileChunk, the hash is memoized in the stat cache
+VLIBPROC bool VL_HashFile(const char *path, u64 *hash);
+
+/* Content hash versions of VL_NeedsRebuild for custom build steps, commandHash can be anything that
+ * identifies how the output is made (see VL_HashBytes). Record the inputs after the output was built */
+VLIBPROC int VL_NeedsRebuildHashed(const char *output_path, u64 commandHash, const char **input_paths, size_t input_paths_count);
+VLIBPROC bool VL_BuildDbRecord(const char *output_path, u64 commandHash, const char **input_paths, size_t input_paths_count);
+// Rewrites VL_needsRebuildContext.buildDbPath with only the latest record of each output
+VLIBPROC bool VL_BuildDbSave(void);
+
 #ifndef VL_BUILD_FILENAME_HASH
 #define VL_BUILD_FILENAME_HASH(v, hash) do {\
     /* djb2 */ \
@@ -408,6 +692,7 @@ typedef enum {
     Compile_Object,
     Compile_DynamicLibrary,
     Compile_StaticLibrary,
+    Compile_PrecompiledHeader, /* the precompiledHeader of a ctx, made by VL_CCompile */
 } vl_compile_type;
 
 typedef enum {
@@ -416,16 +701,91 @@ typedef enum {
     Optimize_Size = 2, /* -Os for gcc, clang, msvc */
 } vl_optimization_option;
 
+typedef enum {
+    Pgo_None = 0,
+    /* Instrumented, running it writes profiles: -fprofile-generate (.gcda next to the objects),
+       -fprofile-instr-generate (<profileDir>/<id>.profraw) or /GL /GENPROFILE (<profileDir>/<output>.pgd) */
+    Pgo_Generate,
+    /* Optimized with the profiles: -fprofile-use (.gcda next to the objects),
+       -fprofile-instr-use (<profileDir>/default.profdata) or /GL /USEPROFILE. Not supported with tcc */
+    Pgo_Use,
+} vl_pgo_mode;
+
+typedef enum {
+    Lto_None = 0,
+    Lto_Full, /* -flto=<VL_GetCountProcs()>, -flto or /GL /LTCG */
+    Lto_Thin, /* -flto=thin with clang (linked with -flto-jobs), gcc and msvc don't have it so it's Lto_Full */
+} vl_lto_mode;
+
+typedef enum {
+    Linker_Default = 0,
+    Linker_Fast, /* the first of mold, lld and gold that is installed, the default linker if none is */
+    Linker_Mold,
+    Linker_Lld,
+    Linker_Gold,
+} vl_linker;
+
+// NOTE: The values are the ones written in the dispatcher of VL_CCompileIsaVariants
+typedef enum {
+    Isa_Default = 0, /* what the compiler targets by default */
+    Isa_X86_64_V1, /* -march=x86-64 */
+    Isa_X86_64_V2, /* -march=x86-64-v2 (sse4.2, popcnt), nothing for msvc */
+    Isa_X86_64_V3, /* -march=x86-64-v3 (avx2, fma, bmi2) or /arch:AVX2 */
+    Isa_X86_64_V4, /* -march=x86-64-v4 (avx512) or /arch:AVX512 */
+    Isa_Armv8_2, /* -march=armv8.2-a or /arch:armv8.2 */
+} vl_isa;
+
+#define VL_ISA(isa) (1u << (isa))
+
 typedef struct {
     vl_c_compiler cc;
     vl_compile_type type;
     vl_optimization_option optimize;
+    vl_pgo_mode pgo; /* profile guided optimization, VL_PgoBuild does all the steps */
+    vl_lto_mode lto; /* static libraries are archived with gcc-ar, llvm-ar or lib /LTCG so the linker sees it */
+    /* "-fuse-ld=<linker>" when linking with gcc or clang, checked to be in PATH once, the default linker is
+       used if it's not (and lld with gcc lto, it can't read gcc's objects). Ignored with msvc and tcc */
+    vl_linker linker;
+    vl_isa isa; /* the cpus the output runs on, ignored with tcc */
 
     bool debug; /* Adds "-g", "-Zi" or nothing */
+    bool splitDwarf; /* with debug, adds "-gsplit-dwarf" for gcc, clang: the debug info goes to .dwo files the linker skips (gcc ignores it with lto) */
+    bool icf; /* identical code folding: "-Wl,--icf=all" with mold, lld or gold, "/OPT:ICF" or nothing */
     bool incremental; /* only for msvc */
     bool gcSections; /* adds "-Wl,--gc-sections", "-opt:ref" or nothing */
     bool warnings; /* adds "-Wall -Wextra", "-W4" or nothing */
     bool warningsAsErrors; /* adds "-Werror", "-WX" or nothing */
+    /* VL_Needs_C_Rebuild reads the includes from "<output>.d". With one source file the compile writes it
+       (-MMD -MF, /showIncludes). With more (or msvc with async or stdoutPath) the compile removes it and the next
+       check runs the compiler for them once and writes it. With this set, every check runs the compiler */
+    bool noDepFile;
+    /* Compile each source to its own object "<outputDir>/<output>-<source>-<hash>.o" in parallel (up to the
+       maxProcs of VL_CCompile, VL_GetCountProcs() by default) skipping the ones that are up to date,
+       then link or archive them, again from all of them when the list in "<final>.objects" changes.
+       VL_CCompile always waits in this mode, the output of each
+       compile is captured (orderedOutput of the opts is used). Static libraries always do this,
+       their archive is updated with only the objects that changed */
+    bool separateObjects;
+    /* Static libraries are thin archives (ar rcsT): they have the paths of the objects instead of a copy,
+       so the objects have to stay where they are. Ignored with msvc */
+    bool thinArchive;
+    /* Unity build, with separateObjects: the sources are grouped into "<outputDir>/<output>-unity<hash>.c"
+       files that #include them, about unityBatchSize each (at most twice that), and those are compiled instead.
+       The batches are cut from the sorted paths where a path hashes to a boundary, so adding or changing a
+       source only rebuilds its batch.
+       The sources of a batch share one translation unit (static names, macros), 0 disables it */
+    size_t unityBatchSize;
+    /* Header built once into "<outputDir>/<output>-pch.h.gch" (".h.pch" for clang, ".pch" for msvc) when it or
+       what it includes changes, and force included in every compile of the ctx (-include, -include-pch, /FI /Yu).
+       The sources can still include it, its include guard skips it. Ignored with tcc */
+    const char *precompiledHeader;
+    /* The output of the target this compile is part of, ctx->output if NULL. separateObjects sets it on each
+       object, the precompiled header and profiles are named after it. When set the precompiled header is
+       only used, it's checked and built with the target */
+    const char *targetOutput;
+    const char *profileDir; /* where the pgo profiles are, "<outputDir>/<output>-pgo" if NULL */
+    /* More inputs of every output (profiles, a linker script), the outputs are rebuilt when one is newer */
+    vl_file_paths extraDependencies;
     vl_file_paths sourceFiles;
     const char *output;
     const char *outputDir;
@@ -460,11 +820,401 @@ if(!VL_CCompile(&cmd, &ctx)) {
 VLIBPROC bool VL_CCompile_Opt(vl_compile_ctx *ctx, vl_cmd_opts opt);
 #define VL_CCompile(Cmd, ctx, ...) \
     VL_CCompile_Opt((ctx), (vl_cmd_opts){.cmd = (Cmd), __VA_ARGS__})
+// Only appends the compile command VL_CCompile would run to cmd
+VLIBPROC void VL_CCompileCmd(vl_compile_ctx *ctx, vl_cmd *cmd);
 
-// Checks the filetime of all input files and all files #included by them
+// Checks the filetime of all input files and all files #included by them,
+// the includes come from the depfile of the last compile, if there's none the compiler is run to get them
 VLIBPROC int VL_Needs_C_Rebuild(vl_cmd *cmd, vl_compile_ctx *ctx);
 
 VLIBPROC char *VL_GetFilePathFromCompileCtx(vl_compile_ctx *ctx);
+// "<output>.d", written by VL_CCompile
+VLIBPROC char *VL_GetDepFilePathFromCompileCtx(vl_compile_ctx *ctx);
+/* Appends every header included by the sources of ctx, directly or not, without running the compiler
+   (VL_Needs_C_Rebuild uses it for tcc). Headers are lexed once per change and looked up next to the
+   file including them and in ctx->includePaths, the ones not found (system headers) are skipped.
+   #if is not evaluated. The paths live in VL_needsRebuildContext */
+VLIBPROC bool VL_ScanIncludes(vl_compile_ctx *ctx, vl_file_paths *includes);
+
+struct VL_PgoBuild_opts {
+    vl_compile_ctx *ctx;
+    vl_cmd *cmd;
+    vl_cmd training; /* the workload, run with the instrumented build (see VL_PgoInstrumentedPath) */
+    size_t maxProcs; /* for separateObjects compiles */
+};
+
+/* Profile guided build of ctx: builds it instrumented in its profileDir, runs training, merges the profiles
+ * (llvm-profdata for clang, gcc's .gcda are copied next to the objects) and builds ctx with them.
+ * Each step is only done when out of date, the training is rerun when the instrumented build changes
+ * (its sources did) or the training command does, and the optimized build when the profiles do.
+Example usage:
+```c
+vl_cmd training = {0};
+CmdAppend(&training, VL_PgoInstrumentedPath(&ctx), "--benchmark");
+if(!VL_PgoBuild(&cmd, &ctx, training)) return 1;
+```
+ */
+VLIBPROC bool VL_PgoBuild_Opt(struct VL_PgoBuild_opts opt);
+#define VL_PgoBuild(Cmd, Ctx, Training, ...) \
+    VL_PgoBuild_Opt((struct VL_PgoBuild_opts){.cmd = (Cmd), .ctx = (Ctx), .training = (Training), __VA_ARGS__})
+// The executable or library built by the instrumented step of VL_PgoBuild
+VLIBPROC const char *VL_PgoInstrumentedPath(vl_compile_ctx *ctx);
+
+struct VL_CCompileIsaVariants_opts {
+    vl_compile_ctx *ctx;
+    unsigned isas; /* VL_ISA(isa) of each variant, 0 means every one of the architecture vl_build.h was built for the compiler takes */
+    size_t maxJobs; /* processes at once, 0 means VL_GetCountProcs() */
+    bool keepGoing;
+};
+
+/* Builds ctx once per isa into "<output>-<isa>" ("app-x86-64-v3", "app-baseline" for Isa_Default) in parallel
+ * with a build graph, and writes "<outputDir>/<output>-isa.h": the variant file names best first and
+ * VL_IsaBestVariant(), which returns the first one the cpu it runs on supports (cpuid, getauxval).
+ * For an executable it also builds "<output>" from "<output>-dispatch.c", a launcher that execs the best
+ * variant from its own directory. For libraries include the header in the program to pick the one to load,
+ * or to link with. Each variant is only rebuilt when out of date like any compile.
+Example usage:
+```c
+vl_compile_ctx ctx = {.optimize = Optimize_Speed, .sourceFiles = VL_GetDaStrSlice("main.c"), .output = "app"};
+if(!VL_CCompileIsaVariants(&ctx, .isas = VL_ISA(Isa_X86_64_V1) | VL_ISA(Isa_X86_64_V3))) return 1;
+```
+ */
+VLIBPROC bool VL_CCompileIsaVariants_Opt(struct VL_CCompileIsaVariants_opts opt);
+#define VL_CCompileIsaVariants(Ctx, ...) \
+    VL_CCompileIsaVariants_Opt((struct VL_CCompileIsaVariants_opts){.ctx = (Ctx), __VA_ARGS__})
+
+#ifndef VL_TOOLCHAIN_CACHE
+# define VL_TOOLCHAIN_CACHE ".vl-toolchain"
+#endif
+
+typedef enum {
+    Feature_Lto = 1 << 0, /* -flto */
+    Feature_ThinLto = 1 << 1, /* -flto=thin, only clang is probed for it */
+    Feature_SplitDwarf = 1 << 2, /* -gsplit-dwarf */
+    Feature_Pch = 1 << 3, /* -x c-header */
+} vl_toolchain_feature;
+
+/* What a compiler is and which options it takes. gcc and clang are probed by compiling a small file with
+ * each option, up to VL_GetCountProcs() at once (lto also links it), msvc and tcc only get their path and version. It's done the first time a compiler is
+ * used and saved in VL_toolchains.cachePath keyed by the mtime and size of its binary, so it only runs again
+ * when the compiler changes. VL_CCompile leaves out the lto, isa, splitDwarf and precompiledHeader options of
+ * a ctx its compiler doesn't take (warning once, thin lto falls back to full), only uses the linkers that
+ * linked and the compile cache uses it as the compiler identity instead of running it */
+typedef struct {
+    const char *path; /* the binary VL_cc runs, found in PATH */
+    u64 mtime;
+    u64 size;
+    const char *version; /* first line of "--version" ("-v" for tcc, the banner for msvc) */
+    const char *target; /* "-dumpmachine": "x86_64-linux-gnu", empty for msvc and tcc */
+    unsigned features; /* vl_toolchain_feature */
+    unsigned isas; /* VL_ISA(isa) of each -march it takes */
+    unsigned linkers; /* 1 << linker for each -fuse-ld= that links */
+    unsigned warnedFeatures;
+    unsigned warnedIsas;
+} vl_toolchain;
+
+typedef struct {
+    const char *cachePath; /* NULL means VL_TOOLCHAIN_CACHE, "" keeps them in memory only */
+    bool disabled; /* nothing is probed, VL_CCompile uses every option as it is */
+    bool loaded;
+    u8 state[4]; /* by vl_c_compiler: 0 not looked up, 1 found, 2 not found, 3 read from the cache but not checked */
+    vl_toolchain compilers[4];
+} vl_toolchains;
+
+extern vl_toolchains VL_toolchains;
+
+// The toolchain of cc, read from the cache or probed the first time. NULL when disabled or cc can't be run
+VLIBPROC vl_toolchain *VL_GetToolchain(vl_c_compiler cc);
+
+/* Compile cache (like ccache) for one source object compiles: Compile_Object, Compile_StaticLibrary
+ * and separateObjects objects that write a depfile. The key is the hash of the compile command
+ * (VL_CmdRender without the output), the compiler's version and the source, an entry is only used
+ * if the headers listed by its depfile still have the same contents. The object and depfile are
+ * copied into place instead of compiling. Warnings of cached compiles are not shown again,
+ * async VL_CCompile calls only read the cache since their results are not known */
+typedef struct {
+    const char *dir; /* NULL disables the cache, VL_COMPILE_CACHE_DIR from the environment is used if it's set */
+    u64 maxSize; /* bytes, the least recently used files are removed past it. 0 means 5GB */
+    size_t hits;
+    size_t misses;
+    size_t stores;
+    size_t evictions;
+} vl_compile_cache;
+
+extern vl_compile_cache VL_compileCache;
+
+// Removes the least recently used files until the cache is under 90% of maxSize, stores do it too
+VLIBPROC bool VL_CompileCacheTrim(void);
+VLIBPROC void VL_CompileCacheLogStats(void);
+
+typedef struct {
+    char *name;
+    const char *category; /* "cmd", "check", "copy", "cache" or the one given to VL_TraceBegin */
+    u64 start; /* VL_GetNanos() */
+    u64 end; /* 0 until it ends */
+    u64 thread; /* the thread that recorded it */
+    u32 slot; /* job slot of a process starting at 1, 0 for work done in the build itself */
+} vl_trace_event;
+
+typedef struct {
+    vl_proc proc;
+    size_t event;
+} vl__trace_proc;
+
+typedef struct {
+    bool enabled;
+    vl_mutex lock;
+    u64 origin; /* when it was enabled */
+    u64 mainThread;
+    struct {
+        vl_trace_event *items;
+        size_t count;
+        size_t capacity;
+    } events;
+    struct {
+        vl__trace_proc *items;
+        size_t count;
+        size_t capacity;
+    } running;
+    struct {
+        bool *items; /* busy job slots, 0 is never used */
+        size_t count;
+        size_t capacity;
+    } slots;
+} vl_trace;
+
+extern vl_trace VL_trace;
+
+/* Build tracing: records every process started with the job slot it ran in, the dependency checks,
+ * file copies and compile cache lookups. VL_TraceSave in vl_serialize.h writes them as a Chrome trace
+ * (chrome://tracing, ui.perfetto.dev) to see the critical path and the idle slots */
+VLIBPROC void VL_TraceEnable(void);
+// Spans for custom steps, the name is copied. Returns the event for VL_TraceEnd, does nothing when disabled
+VLIBPROC size_t VL_TraceBegin(const char *category, const char *name);
+VLIBPROC void VL_TraceEnd(size_t event);
+VLIBPROC void VL_TraceFree(void);
+
+typedef struct {
+    char *path;
+    bool isDir;
+    bool shallow;
+#if OS_LINUX
+    int wd; /* watch of the parent directory for files */
+    const char *name; /* last component of path, for files */
+#endif
+} vl__watch_root;
+
+typedef struct {
+    size_t offset; /* into the snapshot names */
+    const char *path;
+    u64 mtime;
+    u64 size;
+} vl__watch_file;
+
+typedef struct {
+    string_builder names;
+    struct { vl__watch_file *items; size_t count; size_t capacity; } files;
+} vl__watch_snapshot;
+
+#if OS_LINUX
+typedef struct {
+    int wd;
+    char *path;
+    bool all; /* report every entry, otherwise only the watched files inside */
+    bool recursive;
+} vl__watch_dir;
+#endif
+
+/* Reports batches of changed paths under a set of files and directories.
+ * Uses inotify on linux and polls with VL_GetFileStat everywhere else (or with .forcePolling).
+ * Files are watched through their parent directory, so editors that save by renaming still work.
+Usage:
+```c
+vl_watch watch;
+VL_WatchInit(&watch);
+VL_WatchAdd(&watch, "src");
+while(VL_WatchWait(&watch, -1)) {
+    for(size_t i = 0; i < watch.changed.count; i++) printf("%s\n", watch.changed.items[i]);
+}
+VL_WatchFree(&watch);
+```
+ */
+typedef struct {
+    vl_file_paths changed; /* last batch, valid until the next VL_WatchWait */
+    bool overflowed; /* events were lost before the last batch (inotify queue overflow), anything could have changed */
+    int pollIntervalMs;
+    int debounceMs;
+    bool polling;
+
+    struct { vl__watch_root *items; size_t count; size_t capacity; } roots;
+    vl__watch_snapshot snapshot; /* polling only */
+    vl__watch_snapshot scan;
+    bool snapshotStale; /* roots were added since the snapshot, it's taken again by the next VL_WatchWait */
+#if OS_LINUX
+    int fd;
+    struct { vl__watch_dir *items; size_t count; size_t capacity; } dirs;
+#endif
+} vl_watch;
+
+struct VL_WatchInit_opts {
+    vl_watch *watch;
+    bool forcePolling;
+    int pollIntervalMs; /* 0 means 250 */
+    int debounceMs; /* time without new events before a batch is reported, 0 means 30 */
+};
+
+struct VL_WatchAdd_opts {
+    vl_watch *watch;
+    const char *path;
+    bool shallow; /* don't watch subdirectories */
+};
+
+#define VL_WatchInit(w, ...) VL_WatchInit_Opt((struct VL_WatchInit_opts){.watch = (w), __VA_ARGS__})
+VLIBPROC bool VL_WatchInit_Opt(struct VL_WatchInit_opts opt);
+/* Directories are watched recursively unless .shallow is set. When polling, the tree is listed once by
+ * the next VL_WatchWait, so changes made before it aren't reported */
+#define VL_WatchAdd(w, file_path, ...) VL_WatchAdd_Opt((struct VL_WatchAdd_opts){.watch = (w), .path = (file_path), __VA_ARGS__})
+VLIBPROC bool VL_WatchAdd_Opt(struct VL_WatchAdd_opts opt);
+/* Blocks until something changes and fills watch->changed, timeoutMs < 0 waits forever.
+ * Returns true with an empty batch on timeout and false on errors */
+VLIBPROC bool VL_WatchWait(vl_watch *watch, int timeoutMs);
+VLIBPROC void VL_WatchFree(vl_watch *watch);
+
+/* Return false to stop watching */
+typedef bool (*vl_watch_batch_proc)(vl_file_paths *changed, void *userData);
+
+struct VL_WatchRebuild_opts {
+    vl_cmd *cmd;
+    vl_compile_ctx *targets;
+    size_t count;
+    vl_watch_batch_proc onBatch; /* called after the targets affected by a batch were rebuilt */
+    void *userData;
+    bool forcePolling;
+};
+
+/* Watch mode for build scripts: builds the out of date targets, then watches their sources, the headers
+ * listed in their depfiles (VL_ScanIncludes for tcc), the directories of the sources and the include paths.
+ * On every batch of changes only the targets with a changed source or header are checked with
+ * VL_Needs_C_Rebuild and recompiled, or with a change in an include path before their headers are known.
+ * Compile errors are logged and don't stop the loop */
+#define VL_WatchRebuild(Cmd, Targets, Count, ...) \
+    VL_WatchRebuild_Opt((struct VL_WatchRebuild_opts){.cmd = (Cmd), .targets = (Targets), .count = (Count), __VA_ARGS__})
+VLIBPROC bool VL_WatchRebuild_Opt(struct VL_WatchRebuild_opts opt);
+
+typedef struct {
+    const char *output;
+    u64 commandHash;
+    const char *captured; /* msvc /showIncludes output */
+    u64 cacheKey; /* 0 if the compile cache isn't used */
+    bool cached; /* restored from the compile cache, no process was started */
+} vl__compile_step;
+
+typedef struct {
+    size_t *items;
+    size_t count;
+    size_t capacity;
+} vl_target_ids;
+
+typedef enum {
+    VL_TARGET_COMPILE,
+    VL_TARGET_CMD,
+    VL_TARGET_LINK, /* link or archive of a separateObjects compile, made by VL_GraphRun */
+} vl_target_kind;
+
+typedef enum {
+    VL_TARGET_WAITING = 0,
+    VL_TARGET_RUNNING,
+    VL_TARGET_DONE,
+    VL_TARGET_FAILED,
+    VL_TARGET_SKIPPED, /* a dependency failed */
+} vl_target_state;
+
+typedef struct {
+    const char *name;
+    vl_target_kind kind;
+    vl_compile_ctx ctx; /* VL_TARGET_COMPILE and VL_TARGET_LINK */
+    vl_cmd cmd; /* VL_TARGET_CMD */
+    size_t cost; /* estimated run time for the critical path, the source count by default */
+    vl_target_ids deps;
+    bool object; /* a source of a separateObjects target, ctx.output is owned by the graph */
+    bool ownsSourceFiles; /* ctx.sourceFiles (unity files, the precompiled header) are owned by the graph */
+
+    /* scheduler state */
+    vl_target_state state;
+    bool ran; /* wasn't up to date, the targets depending on it are run too */
+    size_t priority; /* cost of the longest chain of dependents starting here */
+    size_t pendingDeps;
+    vl_target_ids dependents;
+    vl_proc proc;
+    vl__compile_step step;
+} vl_target;
+
+typedef struct {
+    vl_target *items;
+    size_t count;
+    size_t capacity;
+} vl_build_graph;
+
+struct VL_GraphRun_opts {
+    vl_build_graph *graph;
+    size_t maxJobs; /* processes at once, 0 means VL_GetCountProcs() */
+    bool keepGoing; /* keep building what doesn't depend on a failed target, like make -k */
+    bool orderedOutput; /* the output of each target is printed when it ends, with this in the order they started */
+};
+
+/* Build graph: targets are added and refer to the targets they depend on by the index the
+ * VL_GraphAdd* functions return. VL_GraphRun runs the ready ones in parallel, those with the most
+ * expensive chain of dependents first. Compiles that VL_Needs_C_Rebuild finds up to date are skipped
+ * unless a dependency was run, separateObjects compiles become one target per object plus the link.
+ * ctx is copied, the lists in it must stay alive until the graph is run */
+VLIBPROC size_t VL_GraphAddCompile(vl_build_graph *graph, const char *name, vl_compile_ctx ctx);
+// Takes ownership of cmd, commands are always run
+VLIBPROC size_t VL_GraphAddCmd(vl_build_graph *graph, const char *name, vl_cmd cmd);
+VLIBPROC void VL_GraphDepends(vl_build_graph *graph, size_t target, size_t dependency);
+#define VL_GraphRun(Graph, ...) VL_GraphRun_Opt((struct VL_GraphRun_opts){.graph = (Graph), __VA_ARGS__})
+VLIBPROC bool VL_GraphRun_Opt(struct VL_GraphRun_opts opt);
+VLIBPROC void VL_GraphFree(vl_build_graph *graph);
+
+#ifndef VL_DAEMON_SOCKET
+# define VL_DAEMON_SOCKET ".vl-build.sock"
+#endif
+
+struct VL_BuildDaemon_opts {
+    vl_build_graph *graph;
+    const char *socketPath; /* NULL means VL_DAEMON_SOCKET */
+    int idleTimeoutMs; /* return when no client connects for this long, 0 waits forever */
+    bool forcePolling;
+};
+/* Build daemon: keeps graph, the stat cache and watches on the sources, their headers (from the depfiles)
+ * and include paths in memory, and answers clients on a unix domain socket with the commands of the
+ * targets that are out of date. Targets are only checked again after one of their inputs changed, after
+ * a client built them or when their outputs changed (they're stat'd on every query, the builds write them).
+ * It returns when a client sends stop (VL_DaemonStop). Not available on windows
+Usage:
+```c
+if(argc > 1 && strcmp(argv[1], "daemon") == 0) return !VL_BuildDaemon(&graph);
+int built = VL_DaemonBuild(NULL, .graph = &graph);
+if(built < 0) built = VL_GraphRun(&graph); // no daemon running, or it had another graph
+```
+ */
+#define VL_BuildDaemon(Graph, ...) VL_BuildDaemon_Opt((struct VL_BuildDaemon_opts){.graph = (Graph), __VA_ARGS__})
+VLIBPROC bool VL_BuildDaemon_Opt(struct VL_BuildDaemon_opts opt);
+
+struct VL_DaemonBuild_opts {
+    const char *socketPath; /* NULL means VL_DAEMON_SOCKET */
+    /* The graph the daemon should have (not run here), a daemon started with another one (by an older build
+       of the driver or with other targets) exits and -1 is returned. NULL doesn't check it */
+    vl_build_graph *graph;
+    size_t maxJobs; /* passed to VL_GraphRun */
+    bool keepGoing;
+    bool orderedOutput;
+};
+/* Client of VL_BuildDaemon: gets the commands of the targets that are out of date, runs them with
+ * VL_GraphRun and tells the daemon which ones were built.
+ * Returns -1 if no daemon is listening, 0 if the build failed and 1 if it succeeded */
+#define VL_DaemonBuild(SocketPath, ...) VL_DaemonBuild_Opt((struct VL_DaemonBuild_opts){.socketPath = (SocketPath), __VA_ARGS__})
+VLIBPROC int VL_DaemonBuild_Opt(struct VL_DaemonBuild_opts opt);
+VLIBPROC bool VL_DaemonStop(const char *socketPath);
 
 typedef enum {
     VL_INSTALL_MODE_RELEASE,
@@ -476,6 +1226,7 @@ typedef struct {
     vl_c_compiler cc;
     vl_install_mode mode;
     const char *installDir; // if not specified, won't do `cmake --install`
+    vl_file_paths cmakeFlags; // extra arguments for the cmake configure ("-DSDL_TESTS=ON")
     vl_file_paths libs;
     vl_file_paths extraCompilerFlags;
 } vl_install_info;
@@ -504,6 +1255,11 @@ typedef struct {
 #endif
 #endif
 
+// Use Ninja for gcc and clang when it's in PATH
+#ifndef VL_CMAKE_USE_NINJA
+#define VL_CMAKE_USE_NINJA 1
+#endif
+
 #ifndef VL_CMAKE_CLANG_GENERATOR
 #if OS_WINDOWS
 #define VL_CMAKE_CLANG_GENERATOR VL_CMAKE_MINGW_GENERATOR
@@ -524,10 +1280,15 @@ typedef struct {
  lib
  vendor
  ├───SDL
- ├───SDL-build-clang
- ├───SDL-build-gcc
- └───SDL-build-msvc
- *depending on what compiler was chosen it will use vendor/SDL-build-[clang|gcc|msvc]
+ ├───SDL-build-clang-Release
+ ├───SDL-build-gcc-Debug
+ └───SDL-build-msvc-RelWithDebInfo
+ *depending on what compiler and mode were chosen it will use vendor/SDL-build-[clang|gcc|msvc]-[mode]
+
+Each build directory has a "vl-install.stamp" with the SDL commit, mode, compiler and a hash of the
+cmake configure it was built with, when it's the same nothing is run. The build uses every core
+(cmake --build -j) and Ninja when it's installed (see VL_CMAKE_USE_NINJA).
+Install_SDL3Variants builds several at once (debug and release) and installs the first one.
 
 Usage:
 ```c
@@ -561,6 +1322,7 @@ VL_InstallInfoFree(sdlInfo); // remember to free!
 ```
 **/
 bool Install_SDL3(vl_cmd *cmd, vl_install_info *info);
+bool Install_SDL3Variants(vl_cmd *cmd, vl_install_info *infos, size_t count);
 
 #define VL_InstallInfoFree(info) DaFree(info.libs); DaFree(info.extraCompilerFlags)
 
@@ -605,7 +1367,13 @@ bool Install_SDL3(vl_cmd *cmd, vl_install_info *info);
 # define VL_REBUILD_URSELF(bin_path, src_path) VL_DEFAULT_REBUILD_URSELF(bin_path, src_path)
 #endif
 
-// stolen from nob.h, made it better (imo)
+/* stolen from nob.h, made it better (imo)
+ * A rebuild writes "<binary>.deps" with every file it was built from (the listed ones and the headers they
+ * include, from the compiler's depfile or VL_ScanIncludes) and the id of the build, which is compiled in as
+ * VL_REBUILD_URSELF_ID. While the id matches, startup only stats those files and compares them with the
+ * recorded times and sizes. A binary built some other way scans the includes once and writes the manifest
+ * for its own time and size. The new binary replaces this process with execv (run as a child on windows), with VL_REBUILT_URSELF
+ * set in its environment so it doesn't check again */
 VLIBPROC void VL__GoRebuildUrself(int argc, char **argv, const char **src_paths, size_t path_count);
 #define VL_GO_REBUILD_URSELF(argc, argv, ...) VL__GoRebuildUrself(argc, argv, ((const char*[]){__FILE__, __VA_ARGS__}), sizeof((const char*[]){__FILE__, __VA_ARGS__})/sizeof(const char*))
 
@@ -616,9 +1384,23 @@ VLIBPROC char *Win32_ErrorMessage(DWORD err);
 #ifdef VL_BUILD_IMPLEMENTATION
 
 vl_log_level VL_MinimalLogLevel = VL_ECHO;
+vl_needrebuild_context VL_needsRebuildContext = {0};
+vl_compile_cache VL_compileCache = {0};
+vl_toolchains VL_toolchains = {0};
+vl_trace VL_trace = {0};
 
 #if !OS_WINDOWS
 #include <dirent.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+extern char **environ;
+#endif
+#if OS_LINUX
+#include <sys/syscall.h>
+#include <sys/inotify.h>
 #endif
 
 #if OS_WINDOWS
@@ -643,7 +1425,8 @@ static int closedir(DIR *dirp);
 
 VLIBPROC char *Win32_ErrorMessage(DWORD err)
 {
-    static char win32ErrMsg[VL_WIN32_ERR_MSG_SIZE] = {0};
+    // NOTE: Per thread, the walker threads log errors too
+    static thread_local char win32ErrMsg[VL_WIN32_ERR_MSG_SIZE] = {0};
     DWORD errMsgSize = FormatMessageA(FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, NULL, err, LANG_USER_DEFAULT, win32ErrMsg,
                                       VL_WIN32_ERR_MSG_SIZE, NULL);
 
@@ -675,26 +1458,42 @@ VLIBPROC void VL_Log(vl_log_level lvl, const char *fmt, ...)
 {
     if(lvl < VL_MinimalLogLevel) return;
 
+    const char *prefix = "";
     switch(lvl) {
         case VL_ECHO:
         case VL_INFO: {
-            fprintf(stderr, "[INFO] ");
+            prefix = "[INFO] ";
         } break;
         case VL_WARNING: {
-            fprintf(stderr, "[WARNING] ");
+            prefix = "[WARNING] ";
         } break;
         case VL_ERROR: {
-            fprintf(stderr, "[ERROR] ");
+            prefix = "[ERROR] ";
         } break;
         case VL_QUIET: return;
         default: Assert(!"Unreachable");
     }
 
+    // NOTE: The line is written at once, so the ones from other threads don't end up in the middle of it
+    char stackBuf[1024];
+    char *buf = stackBuf;
+    size_t prefixLen = strlen(prefix);
     va_list args;
     va_start(args, fmt);
-    vfprintf(stderr, fmt, args);
+    int len = vsnprintf(buf + prefixLen, sizeof(stackBuf) - prefixLen, fmt, args);
     va_end(args);
-    fprintf(stderr, "\n");
+    if(len < 0) return;
+    if((size_t)len >= sizeof(stackBuf) - prefixLen) {
+        buf = (char*)VL_REALLOC(NULL, prefixLen + (size_t)len + 1);
+        Assert(buf != NULL && "Buy more RAM lol");
+        va_start(args, fmt);
+        vsnprintf(buf + prefixLen, (size_t)len + 1, fmt, args);
+        va_end(args);
+    }
+    memcpy(buf, prefix, prefixLen);
+    buf[prefixLen + (size_t)len] = '\n';
+    fwrite(buf, 1, prefixLen + (size_t)len + 1, stderr);
+    if(buf != stackBuf) VL_FREE(buf);
 }
 
 VLIBPROC bool MkdirIfNotExist(const char *path)
@@ -717,48 +1516,189 @@ VLIBPROC bool MkdirIfNotExist(const char *path)
     return true;
 }
 
-VLIBPROC bool VL_CopyFile(const char *src, const char *dst)
+struct vl__thread_start {
+    vl_thread_proc proc;
+    void *arg;
+};
+
+#if OS_WINDOWS
+static DWORD WINAPI VL__ThreadTrampoline(LPVOID param)
+#else
+static void *VL__ThreadTrampoline(void *param)
+#endif
 {
-    VL_Log(VL_ECHO, "copying %s -> %s", src, dst);
+    struct vl__thread_start start = *(struct vl__thread_start*)param;
+    VL_FREE(param);
+    start.proc(start.arg);
+    return 0;
+}
+
+VLIBPROC bool VL_ThreadStart(vl_thread *thread, vl_thread_proc proc, void *arg)
+{
+    struct vl__thread_start *start = (struct vl__thread_start*)VL_REALLOC(NULL, sizeof(*start));
+    Assert(start != NULL && "Buy more RAM lol");
+    start->proc = proc;
+    start->arg = arg;
 #if OS_WINDOWS
-    if(!CopyFile(src, dst, false)) {
-        VL_Log(VL_ERROR, "Could not copy file: %s", Win32_ErrorMessage(GetLastError()));
+    *thread = CreateThread(NULL, 0, VL__ThreadTrampoline, start, 0, NULL);
+    if(*thread == NULL) {
+        VL_Log(VL_ERROR, "Could not create thread: %s", Win32_ErrorMessage(GetLastError()));
+        VL_FREE(start);
+        return false;
+    }
+#else
+    int err = pthread_create(thread, NULL, VL__ThreadTrampoline, start);
+    if(err != 0) {
+        VL_Log(VL_ERROR, "Could not create thread: %s", strerror(err));
+        VL_FREE(start);
         return false;
     }
+#endif
     return true;
+}
+
+VLIBPROC void VL_ThreadJoin(vl_thread thread)
+{
+#if OS_WINDOWS
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
 #else
-    int src_fd = -1;
-    int dst_fd = -1;
-    size_t bufSize = 32*1024;
-    size_t tempMark = temp_save();
-    char *buf = (char*)temp_alloc(bufSize, .Alignment = 1);
+    pthread_join(thread, NULL);
+#endif
+}
+
+VLIBPROC void VL_MutexInit(vl_mutex *mutex)
+{
+#if OS_WINDOWS
+    InitializeSRWLock(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+VLIBPROC void VL_MutexLock(vl_mutex *mutex)
+{
+#if OS_WINDOWS
+    AcquireSRWLockExclusive(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+VLIBPROC void VL_MutexUnlock(vl_mutex *mutex)
+{
+#if OS_WINDOWS
+    ReleaseSRWLockExclusive(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+VLIBPROC void VL_MutexDestroy(vl_mutex *mutex)
+{
+#if OS_WINDOWS
+    (void)mutex; // SRW locks don't need to be destroyed
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+VLIBPROC void VL_CondInit(vl_cond *cond)
+{
+#if OS_WINDOWS
+    InitializeConditionVariable(cond);
+#else
+    pthread_cond_init(cond, NULL);
+#endif
+}
+
+VLIBPROC void VL_CondWait(vl_cond *cond, vl_mutex *mutex)
+{
+#if OS_WINDOWS
+    SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
+#else
+    pthread_cond_wait(cond, mutex);
+#endif
+}
+
+VLIBPROC void VL_CondBroadcast(vl_cond *cond)
+{
+#if OS_WINDOWS
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+VLIBPROC void VL_CondDestroy(vl_cond *cond)
+{
+#if OS_WINDOWS
+    (void)cond;
+#else
+    pthread_cond_destroy(cond);
+#endif
+}
+
+// strdup that doesn't use the temporary arena, since that one is not thread safe
+static char *VL__HeapStrndup(const char *s, size_t n)
+{
+    char *result = (char*)VL_REALLOC(NULL, n + 1);
+    Assert(result != NULL && "Buy more RAM lol");
+    mem_copy_non_overlapping(result, s, n);
+    result[n] = '\0';
+    return result;
+}
+
+#if !OS_WINDOWS
+/* Copies dirFd/name (or path if dirFd < 0) to dst using buf as the intermediate buffer */
+static bool VL__CopyFileAt(int dirFd, const char *name, const char *path, const char *dst, char *buf, size_t bufSize)
+{
+    VL_Log(VL_ECHO, "copying %s -> %s", path, dst);
+    size_t traceEvent = VL_TraceBegin("copy", dst);
 
-    Assert(buf != NULL && "Buy more RAM lol!!");
     bool result = true;
+    int src_fd = -1;
+    int dst_fd = -1;
 
-    src_fd = open(src, O_RDONLY);
+    src_fd = (dirFd < 0) ? open(path, O_RDONLY | O_CLOEXEC) : openat(dirFd, name, O_RDONLY | O_CLOEXEC);
     if(src_fd < 0) {
-        VL_Log(VL_ERROR, "Could not open file %s: %s", src, strerror(errno));
+        VL_Log(VL_ERROR, "Could not open file %s: %s", path, strerror(errno));
         VL_ReturnDefer(false);
     }
 
     struct stat src_stat;
     if(fstat(src_fd, &src_stat) < 0) {
-        VL_Log(VL_ERROR, "Could not get mode of file %s: %s", src, strerror(errno));
+        VL_Log(VL_ERROR, "Could not get mode of file %s: %s", path, strerror(errno));
         VL_ReturnDefer(false);
     }
 
-    dst_fd = open(dst, O_CREAT | O_TRUNC | O_WRONLY, src_stat.st_mode);
+    dst_fd = open(dst, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, src_stat.st_mode);
     if(dst_fd < 0) {
         VL_Log(VL_ERROR, "Could not create file %s: %s", dst, strerror(errno));
         VL_ReturnDefer(false);
     }
 
+#if OS_LINUX
+    // NOTE: Lets the kernel copy (or reflink) without going through userspace.
+    // Not every filesystem supports it, so fall back to read/write if the first call fails
+    for(bool copiedAny = false;;) {
+        ssize_t n = copy_file_range(src_fd, NULL, dst_fd, NULL, 1 << 30, 0);
+        if(n == 0) VL_ReturnDefer(true);
+        if(n < 0) {
+            if(!copiedAny && (errno == EXDEV || errno == ENOSYS || errno == EINVAL ||
+                              errno == EOPNOTSUPP || errno == EBADF)) break;
+            VL_Log(VL_ERROR, "Could not copy %s to %s: %s", path, dst, strerror(errno));
+            VL_ReturnDefer(false);
+        }
+        copiedAny = true;
+    }
+#endif
+
     for(;;) {
         ssize_t n = read(src_fd, buf, bufSize);
         if(n == 0) break;
         if(n < 0) {
-            VL_Log(VL_ERROR, "Could not read from file %s: %s", src, strerror(errno));
+            VL_Log(VL_ERROR, "Could not read from file %s: %s", path, strerror(errno));
             VL_ReturnDefer(false);
         }
         char *buf2 = buf;
@@ -774,55 +1714,297 @@ VLIBPROC bool VL_CopyFile(const char *src, const char *dst)
     }
 
 defer:
-    temp_rewind(tempMark);
-    close(src_fd);
-    close(dst_fd);
+    if(src_fd >= 0) close(src_fd);
+    if(dst_fd >= 0) close(dst_fd);
+    VL_TraceEnd(traceEvent);
     return result;
-#endif
 }
+#endif
 
-VLIBPROC bool VL_CopyDirectoryRecursively_Impl(const char *src, const char *dst, const char *ext)
+#ifndef VL_COPY_BUFFER_SIZE
+# define VL_COPY_BUFFER_SIZE (32*1024)
+#endif
+
+VLIBPROC bool VL_CopyFile(const char *src, const char *dst)
 {
-    bool result = true;
-    vl_file_paths children = {0};
-    string_builder srcSb = {0};
-    string_builder dstSb = {0};
-    size_t tempCheckpoint = temp_save();
+#if OS_WINDOWS
+    VL_Log(VL_ECHO, "copying %s -> %s", src, dst);
+    size_t traceEvent = VL_TraceBegin("copy", dst);
+    bool result = CopyFile(src, dst, false);
+    if(!result) {
+        VL_Log(VL_ERROR, "Could not copy file: %s", Win32_ErrorMessage(GetLastError()));
+    }
+    VL_TraceEnd(traceEvent);
+#else
+    size_t tempMark = temp_save();
+    char *buf = (char*)temp_alloc(VL_COPY_BUFFER_SIZE, .Alignment = 1);
+    Assert(buf != NULL && "Buy more RAM lol!!");
 
-    file_type type = VL_GetFileType(src);
-    if(type < 0) return false;
+    bool result = VL__CopyFileAt(-1, src, src, dst, buf, VL_COPY_BUFFER_SIZE);
 
-    switch(type) {
+    temp_rewind(tempMark);
+#endif
+    return result;
+}
+
+typedef struct {
+    vl_mutex lock;
+    char **items; // heap allocated paths of directories that have not been read yet
+    size_t count;
+    size_t capacity;
+    size_t head; // thieves take from the head, the owner pops from the end
+} vl__walk_queue;
+
+typedef struct {
+    struct VL_WalkDirectory_opts opt;
+    size_t rootLength;
+    vl__walk_queue *queues; // one per thread
+
+    vl_mutex idleLock;
+    vl_cond idleCond;
+    // everything below is protected by idleLock
+    size_t pending; // directories queued or being read
+    size_t generation; // incremented every time a directory is queued
+    bool failed;
+} vl__walk_state;
+
+typedef struct {
+    vl__walk_state *state;
+    int index;
+} vl__walk_worker;
+
+static void VL__WalkPush(vl__walk_state *state, int worker, char *dirPath)
+{
+    vl__walk_queue *queue = &state->queues[worker];
+    VL_MutexLock(&queue->lock);
+    DaAppend(queue, dirPath);
+    VL_MutexUnlock(&queue->lock);
+
+    VL_MutexLock(&state->idleLock);
+    state->pending++;
+    state->generation++;
+    VL_MutexUnlock(&state->idleLock);
+    VL_CondBroadcast(&state->idleCond);
+}
+
+static char *VL__WalkPop(vl__walk_state *state, int worker)
+{
+    char *result = NULL;
+    size_t threads = state->opt.threads;
+
+    // LIFO on our own queue keeps the walk depth first and the queues small
+    vl__walk_queue *queue = &state->queues[worker];
+    VL_MutexLock(&queue->lock);
+    if(queue->count > queue->head) {
+        result = queue->items[--queue->count];
+        if(queue->count == queue->head) queue->count = queue->head = 0;
+    }
+    VL_MutexUnlock(&queue->lock);
+
+    // steal the oldest (closest to the root, so usually the biggest) directory from someone else
+    for(size_t i = 1; !result && i < threads; i++) {
+        queue = &state->queues[(worker + i) % threads];
+        VL_MutexLock(&queue->lock);
+        if(queue->count > queue->head) {
+            result = queue->items[queue->head++];
+            if(queue->count == queue->head) queue->count = queue->head = 0;
+        }
+        VL_MutexUnlock(&queue->lock);
+    }
+
+    return result;
+}
+
+static bool VL__WalkReadDir(vl__walk_state *state, int worker, const char *dirPath)
+{
+    bool result = true;
+    string_builder sb = {0};
+    size_t dirLength = strlen(dirPath);
+
+    vl_dir_iter it;
+    if(!VL_DirIterOpen(&it, dirPath)) return false;
+
+    while(VL_DirIterNext(&it)) {
+        sb.count = 0;
+        SbAppendBuf(&sb, dirPath, dirLength);
+        DaAppend(&sb, '/');
+        SbAppendBuf(&sb, it.entry.name.items, it.entry.name.count);
+        SbAppendNull(&sb);
+
+        vl_walk_entry entry = {
+            .path = sb.items,
+            .relPath = sb.items + state->rootLength + 1,
+            .name = it.entry.name.items,
+            .type = it.entry.type,
+            .worker = worker,
+#if !OS_WINDOWS
+            .dirFd = it.fd,
+#endif
+        };
+        if(!state->opt.visit(&entry, state->opt.userData)) VL_ReturnDefer(false);
+
+        if(it.entry.type == VL_FILE_DIRECTORY) {
+            VL__WalkPush(state, worker, VL__HeapStrndup(sb.items, sb.count - 1));
+        }
+    }
+    if(it.failed) result = false;
+
+defer:
+    VL_DirIterClose(&it);
+    SbFree(sb);
+    return result;
+}
+
+static void VL__WalkWorker(void *arg)
+{
+    vl__walk_worker *worker = (vl__walk_worker*)arg;
+    vl__walk_state *state = worker->state;
+
+    for(;;) {
+        VL_MutexLock(&state->idleLock);
+        size_t generation = state->generation;
+        bool failed = state->failed;
+        VL_MutexUnlock(&state->idleLock);
+
+        char *dirPath = VL__WalkPop(state, worker->index);
+        if(dirPath) {
+            // NOTE: After a failure the queues are just drained
+            bool ok = failed || VL__WalkReadDir(state, worker->index, dirPath);
+            VL_FREE(dirPath);
+
+            VL_MutexLock(&state->idleLock);
+            if(!ok) state->failed = true;
+            bool done = --state->pending == 0;
+            VL_MutexUnlock(&state->idleLock);
+            if(done) VL_CondBroadcast(&state->idleCond);
+            continue;
+        }
+
+        // Nothing to steal, sleep until someone queues a directory or everyone is done
+        VL_MutexLock(&state->idleLock);
+        while(state->pending > 0 && state->generation == generation) {
+            VL_CondWait(&state->idleCond, &state->idleLock);
+        }
+        bool done = state->pending == 0;
+        VL_MutexUnlock(&state->idleLock);
+        if(done) break;
+    }
+}
+
+VLIBPROC bool VL_WalkDirectory_Opt(struct VL_WalkDirectory_opts opt)
+{
+    AssertMsg(opt.root != 0, "Invalid parameter: root directory is null");
+    AssertMsg(opt.visit != 0, "Invalid parameter: visit procedure is null");
+    if(opt.threads == 0) opt.threads = (size_t)VL_GetCountProcs();
+    if(opt.threads == 0) opt.threads = 1;
+
+    size_t rootLength = strlen(opt.root);
+    while(rootLength > 1 && (opt.root[rootLength - 1] == '/' || opt.root[rootLength - 1] == '\\')) {
+        rootLength--;
+    }
+    char *root = VL__HeapStrndup(opt.root, rootLength);
+
+    file_type type = VL_GetFileType(root);
+    if(type == VL_FILE_INVALID) {
+        VL_Log(VL_ERROR, "Could not get type of %s", root);
+        VL_FREE(root);
+        return false;
+    }
+
+    vl_walk_entry rootEntry = {
+        .path = root,
+        .relPath = root + rootLength,
+        .name = VL_PathName(root),
+        .type = type,
+        .worker = 0,
+#if !OS_WINDOWS
+        .dirFd = -1,
+#endif
+    };
+    bool visited = opt.visit(&rootEntry, opt.userData);
+    if(!visited || (type != VL_FILE_DIRECTORY)) {
+        VL_FREE(root);
+        return visited;
+    }
+
+    vl__walk_state state = {
+        .opt = opt,
+        .rootLength = rootLength,
+    };
+    state.queues = (vl__walk_queue*)VL_REALLOC(NULL, opt.threads*sizeof(vl__walk_queue));
+    vl__walk_worker *workers = (vl__walk_worker*)VL_REALLOC(NULL, opt.threads*sizeof(vl__walk_worker));
+    vl_thread *threads = (vl_thread*)VL_REALLOC(NULL, opt.threads*sizeof(vl_thread));
+    Assert(state.queues && workers && threads && "Buy more RAM lol");
+    memset(state.queues, 0, opt.threads*sizeof(vl__walk_queue));
+    VL_MutexInit(&state.idleLock);
+    VL_CondInit(&state.idleCond);
+    for(size_t i = 0; i < opt.threads; i++) {
+        VL_MutexInit(&state.queues[i].lock);
+        workers[i].state = &state;
+        workers[i].index = (int)i;
+    }
+
+    VL__WalkPush(&state, 0, root);
+
+    size_t started = 1;
+    for(; started < opt.threads; started++) {
+        if(!VL_ThreadStart(&threads[started], VL__WalkWorker, &workers[started])) break;
+    }
+    // if a thread couldn't be started, the others steal its (empty) queue anyway
+    VL__WalkWorker(&workers[0]);
+    for(size_t i = 1; i < started; i++) {
+        VL_ThreadJoin(threads[i]);
+    }
+
+    for(size_t i = 0; i < opt.threads; i++) {
+        VL_MutexDestroy(&state.queues[i].lock);
+        DaFree(state.queues[i]);
+    }
+    VL_CondDestroy(&state.idleCond);
+    VL_MutexDestroy(&state.idleLock);
+    VL_FREE(threads);
+    VL_FREE(workers);
+    VL_FREE(state.queues);
+    return !state.failed;
+}
+
+typedef struct {
+    const char *dst;
+    view ext;
+    string_builder *dstPaths; // one per worker
+    char **buffers; // one per worker
+} vl__copy_dir_state;
+
+static bool VL__CopyDirectoryVisit(vl_walk_entry *entry, void *userData)
+{
+    vl__copy_dir_state *state = (vl__copy_dir_state*)userData;
+
+    string_builder *dstPath = &state->dstPaths[entry->worker];
+    dstPath->count = 0;
+    SbAppendCstr(dstPath, state->dst);
+    if(entry->relPath[0]) {
+        DaAppend(dstPath, '/');
+        SbAppendCstr(dstPath, entry->relPath);
+    }
+    SbAppendNull(dstPath);
+
+    switch(entry->type) {
         case VL_FILE_DIRECTORY: {
-            if(!MkdirIfNotExist(dst)) VL_ReturnDefer(false);
-            if(!VL_ReadEntireDir(src, &children)) VL_ReturnDefer(false);
-
-            for(size_t i = 0; i < children.count; i++) {
-                if(!strcmp(children.items[i], ".")) continue;
-                if(!strcmp(children.items[i], "..")) continue;
-
-                srcSb.count = 0;
-                SbAppendCstr(&srcSb, src);
-                SbAppendCstr(&srcSb, "/");
-                SbAppendCstr(&srcSb, children.items[i]);
-                SbAppendNull(&srcSb);
-
-                dstSb.count = 0;
-                SbAppendCstr(&dstSb, dst);
-                SbAppendCstr(&dstSb, "/");
-                SbAppendCstr(&dstSb, children.items[i]);
-                SbAppendNull(&dstSb);
-
-                if(!VL_CopyDirectoryRecursively_Impl(srcSb.items, dstSb.items, ext)) {
-                    VL_ReturnDefer(false);
-                }
-            }
+            return MkdirIfNotExist(dstPath->items);
         } break;
 
         case VL_FILE_REGULAR: {
-            if(ViewEndsWith(ViewFromCstr(src), ViewFromCstr(ext)) && !VL_CopyFile(src, dst)) {
-                VL_ReturnDefer(false);
+            if(!ViewEndsWith(ViewFromCstr(entry->name), state->ext)) return true;
+#if OS_WINDOWS
+            return VL_CopyFile(entry->path, dstPath->items);
+#else
+            char **buf = &state->buffers[entry->worker];
+            if(!*buf) {
+                *buf = (char*)VL_REALLOC(NULL, VL_COPY_BUFFER_SIZE);
+                Assert(*buf != NULL && "Buy more RAM lol!!");
             }
+            return VL__CopyFileAt(entry->dirFd, entry->name, entry->path, dstPath->items, *buf, VL_COPY_BUFFER_SIZE);
+#endif
         } break;
 
         case VL_FILE_SYMLINK: {
@@ -830,19 +2012,44 @@ VLIBPROC bool VL_CopyDirectoryRecursively_Impl(const char *src, const char *dst,
         } break;
 
         case VL_FILE_OTHER: {
-            VL_Log(VL_ERROR, "Unsupported type of file %s", src);
-            VL_ReturnDefer(false);
+            VL_Log(VL_ERROR, "Unsupported type of file %s", entry->path);
+            return false;
         } break;
 
         default: Assert(!"Unreachable");
     }
+    return true;
+}
 
-defer:
-    temp_rewind(tempCheckpoint);
-    DaFree(srcSb);
-    DaFree(dstSb);
-    DaFree(children);
-    return result;
+static bool VL__CopyDirectory(const char *src, const char *dst, const char *ext, size_t threads)
+{
+    if(threads == 0) threads = (size_t)VL_GetCountProcs();
+    if(threads == 0) threads = 1;
+
+    vl__copy_dir_state state = {
+        .dst = dst,
+        .ext = ViewFromCstr(ext),
+    };
+    state.dstPaths = (string_builder*)VL_REALLOC(NULL, threads*sizeof(string_builder));
+    state.buffers = (char**)VL_REALLOC(NULL, threads*sizeof(char*));
+    Assert(state.dstPaths && state.buffers && "Buy more RAM lol");
+    memset(state.dstPaths, 0, threads*sizeof(string_builder));
+    memset(state.buffers, 0, threads*sizeof(char*));
+
+    bool ok = VL_WalkDirectory(src, VL__CopyDirectoryVisit, .userData = &state, .threads = threads);
+
+    for(size_t i = 0; i < threads; i++) {
+        SbFree(state.dstPaths[i]);
+        VL_FREE(state.buffers[i]);
+    }
+    VL_FREE(state.dstPaths);
+    VL_FREE(state.buffers);
+    return ok;
+}
+
+VLIBPROC bool VL_CopyDirectoryRecursively_Impl(const char *src, const char *dst, const char *ext)
+{
+    return VL__CopyDirectory(src, dst, ext ? ext : "", 0);
 }
 
 VLIBPROC bool VL_CopyDirectoryRecursively_Opt(struct VL_CopyDirectoryRecursively_opts opt)
@@ -855,59 +2062,324 @@ VLIBPROC bool VL_CopyDirectoryRecursively_Opt(struct VL_CopyDirectoryRecursively
 
     vl_log_level prevLogLevel = VL_MinimalLogLevel;
     VL_MinimalLogLevel = VL_INFO;
-    bool ok = VL_CopyDirectoryRecursively_Impl(opt.src, opt.dst, opt.ext);
+    bool ok = VL__CopyDirectory(opt.src, opt.dst, opt.ext, opt.threads);
     VL_MinimalLogLevel = prevLogLevel;
 
     return ok;
 }
 
-VLIBPROC bool VL_ReadDirectoryFilesRecursively(const char *parent, vl_file_paths *children)
+typedef struct {
+    vl_mutex lock;
+    vl_file_paths *children;
+} vl__read_dir_state;
+
+static bool VL__ReadDirectoryVisit(vl_walk_entry *entry, void *userData)
 {
-    bool result = true;
+    vl__read_dir_state *state = (vl__read_dir_state*)userData;
+    switch(entry->type) {
+        case VL_FILE_DIRECTORY: break;
+
+        case VL_FILE_REGULAR:
+        case VL_FILE_SYMLINK: {
+            // NOTE: the temporary arena is only touched while holding the lock
+            VL_MutexLock(&state->lock);
+            DaAppend(state->children, temp_strdup(entry->path));
+            VL_MutexUnlock(&state->lock);
+        } break;
+
+        case VL_FILE_OTHER: {
+            VL_Log(VL_ERROR, "Unsupported type of file %s", entry->path);
+            return false;
+        } break;
 
-    vl_file_paths children_tmp = {0};
-    string_builder src_sb = {0};
+        default: Assert(!"unreachable");
+    }
+    return true;
+}
 
-    file_type type = VL_GetFileType(parent);
-    if(type < 0) return false;
+VLIBPROC bool VL_ReadDirectoryFilesRecursively(const char *parent, vl_file_paths *children)
+{
+    vl__read_dir_state state = {.children = children};
+    VL_MutexInit(&state.lock);
+    bool ok = VL_WalkDirectory(parent, VL__ReadDirectoryVisit, .userData = &state);
+    VL_MutexDestroy(&state.lock);
+    return ok;
+}
 
-    switch(type) {
-        case VL_FILE_DIRECTORY: {
-            if(!VL_ReadEntireDir(parent, &children_tmp)) VL_ReturnDefer(false);
+#if !OS_WINDOWS
+static void VL__FileStatFromStat(struct stat *statbuf, vl_file_stat *fileStat)
+{
+#if OS_MAC
+    fileStat->mtime = (u64)statbuf->st_mtimespec.tv_sec*VL_NANOS_PER_SEC + (u64)statbuf->st_mtimespec.tv_nsec;
+#else
+    fileStat->mtime = (u64)statbuf->st_mtim.tv_sec*VL_NANOS_PER_SEC + (u64)statbuf->st_mtim.tv_nsec;
+#endif
+    fileStat->size = (u64)statbuf->st_size;
+    fileStat->inode = (u64)statbuf->st_ino;
+    if(S_ISREG(statbuf->st_mode)) fileStat->type = VL_FILE_REGULAR;
+    else if(S_ISDIR(statbuf->st_mode)) fileStat->type = VL_FILE_DIRECTORY;
+    else if(S_ISLNK(statbuf->st_mode)) fileStat->type = VL_FILE_SYMLINK;
+    else fileStat->type = VL_FILE_OTHER;
+}
+#endif
 
-            for(size_t i = 0; i < children_tmp.count; ++i) {
-                if(strcmp(children_tmp.items[i], ".") == 0) continue;
-                if(strcmp(children_tmp.items[i], "..") == 0) continue;
+VLIBPROC bool VL_GetFileStat(const char *path, vl_file_stat *fileStat)
+{
+#if OS_WINDOWS
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if(!GetFileAttributesEx(path, GetFileExInfoStandard, &data)) return false;
+    fileStat->mtime = ((u64)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+    fileStat->size = ((u64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    fileStat->inode = 0;
+    fileStat->type = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? VL_FILE_DIRECTORY : VL_FILE_REGULAR;
+    return true;
+#else
+    struct stat statbuf;
+    if(stat(path, &statbuf) < 0) return false;
+    VL__FileStatFromStat(&statbuf, fileStat);
+    return true;
+#endif
+}
 
-                src_sb.count = 0;
-                SbAppendCstr(&src_sb, parent);
-                SbAppendCstr(&src_sb, "/");
-                SbAppendCstr(&src_sb, children_tmp.items[i]);
-                SbAppendNull(&src_sb);
+VLIBPROC bool VL_GlobMatch(const char *pattern, view name)
+{
+    size_t n = 0;
+    // position to go back to when a match after a '*' fails
+    const char *starPattern = NULL;
+    size_t starName = 0;
+
+    while(n < name.count) {
+        char p = *pattern;
+        if(p == '*') {
+            starPattern = ++pattern;
+            starName = n;
+            continue;
+        }
 
-                if(!VL_ReadDirectoryFilesRecursively(src_sb.items, children)) {
-                    VL_ReturnDefer(false);
+        bool matched = false;
+        const char *next = pattern + 1;
+        if(p == '?') {
+            matched = true;
+        } else if(p == '[') {
+            const char *c = pattern + 1;
+            bool negate = (*c == '!' || *c == '^');
+            if(negate) c++;
+            bool inClass = false;
+            // ']' right after the '[' is a literal
+            for(bool first = true; *c && (first || *c != ']'); first = false, c++) {
+                if(c[1] == '-' && c[2] && c[2] != ']') {
+                    if(c[0] <= name.items[n] && name.items[n] <= c[2]) inClass = true;
+                    c += 2;
+                } else if(*c == name.items[n]) {
+                    inClass = true;
                 }
             }
-        } break;
+            if(*c == ']') {
+                matched = inClass != negate;
+                next = c + 1;
+            } else {
+                matched = (name.items[n] == '['); // unterminated class, treat '[' literally
+            }
+        } else if(p != '\0') {
+            matched = (p == name.items[n]);
+        }
 
-        case VL_FILE_REGULAR:
-        case VL_FILE_SYMLINK: {
-            DaAppend(children, temp_strdup(parent));
-        } break;
+        if(matched) {
+            pattern = next;
+            n++;
+        } else if(starPattern) {
+            pattern = starPattern;
+            n = ++starName;
+        } else {
+            return false;
+        }
+    }
 
-        case VL_FILE_OTHER: {
-            VL_Log(VL_ERROR, "Unsupported type of file %s", parent);
-            VL_ReturnDefer(false);
-        } break;
+    while(*pattern == '*') pattern++;
+    return *pattern == '\0';
+}
 
-        default: Assert(!"unreachable");
+#if OS_LINUX
+struct vl__linux_dirent64 {
+    u64 d_ino;
+    s64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+#if !OS_WINDOWS && defined(DT_UNKNOWN)
+static file_type VL__FileTypeFromDirent(unsigned char type)
+{
+    switch(type) {
+        case DT_REG: return VL_FILE_REGULAR;
+        case DT_DIR: return VL_FILE_DIRECTORY;
+        case DT_LNK: return VL_FILE_SYMLINK;
+        case DT_UNKNOWN: return VL_FILE_INVALID;
+        default: return VL_FILE_OTHER;
     }
+}
+#endif
 
-defer:
-    DaFree(children_tmp);
-    DaFree(src_sb);
-    return result;
+VLIBPROC bool VL_DirIterOpen_Opt(vl_dir_iter *it, struct VL_DirIterOpen_opts opt)
+{
+    AssertMsg(opt.path != 0, "Invalid parameter: directory path is null");
+    it->path = opt.path;
+    it->failed = false;
+    it->hasStat = false;
+    it->entry.name = ViewFromParts("", 0);
+    it->entry.type = VL_FILE_INVALID;
+    it->ext = ViewFromCstr(opt.ext ? opt.ext : "");
+    it->glob = opt.glob;
+
+#if OS_WINDOWS
+    char buffer[MAX_PATH];
+    snprintf(buffer, MAX_PATH, "%s\\*", opt.path);
+    it->hFind = FindFirstFileA(buffer, &it->data);
+    if(it->hFind == INVALID_HANDLE_VALUE) {
+        DWORD error = GetLastError();
+        if(!opt.quietMissing || (error != ERROR_FILE_NOT_FOUND && error != ERROR_PATH_NOT_FOUND)) {
+            VL_Log(VL_ERROR, "Could not open directory %s: %s", opt.path, Win32_ErrorMessage(error));
+        }
+        return false;
+    }
+    it->pendingFirst = true;
+#else
+    it->fd = open(opt.path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(it->fd < 0) {
+        if(!opt.quietMissing || (errno != ENOENT && errno != ENOTDIR)) {
+            VL_Log(VL_ERROR, "Could not open directory %s: %s", opt.path, strerror(errno));
+        }
+        return false;
+    }
+# if OS_LINUX
+    it->bufferCount = 0;
+    it->bufferPos = 0;
+# else
+    it->dir = fdopendir(it->fd);
+    if(it->dir == NULL) {
+        VL_Log(VL_ERROR, "Could not open directory %s: %s", opt.path, strerror(errno));
+        close(it->fd);
+        return false;
+    }
+# endif
+#endif
+    return true;
+}
+
+VLIBPROC bool VL_DirIterNext(vl_dir_iter *it)
+{
+    for(;;) {
+        const char *name;
+        file_type type;
+#if OS_WINDOWS
+        if(it->pendingFirst) {
+            it->pendingFirst = false;
+        } else if(!FindNextFileA(it->hFind, &it->data)) {
+            if(GetLastError() != ERROR_NO_MORE_FILES) {
+                VL_Log(VL_ERROR, "Could not read directory %s: %s", it->path, Win32_ErrorMessage(GetLastError()));
+                it->failed = true;
+            }
+            return false;
+        }
+        name = it->data.cFileName;
+        if(it->data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) type = VL_FILE_DIRECTORY;
+        else if(it->data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) type = VL_FILE_SYMLINK;
+        else type = VL_FILE_REGULAR;
+#elif OS_LINUX
+        if(it->bufferPos >= it->bufferCount) {
+            long n = syscall(SYS_getdents64, it->fd, it->buffer, sizeof(it->buffer));
+            if(n < 0) {
+                VL_Log(VL_ERROR, "Could not read directory %s: %s", it->path, strerror(errno));
+                it->failed = true;
+                return false;
+            }
+            if(n == 0) return false;
+            it->bufferCount = (size_t)n;
+            it->bufferPos = 0;
+        }
+        struct vl__linux_dirent64 *ent = (struct vl__linux_dirent64*)((u8*)it->buffer + it->bufferPos);
+        it->bufferPos += ent->d_reclen;
+        name = ent->d_name;
+        type = VL__FileTypeFromDirent(ent->d_type);
+#else
+        errno = 0;
+        struct dirent *ent = readdir((DIR*)it->dir);
+        if(ent == NULL) {
+            if(errno != 0) {
+                VL_Log(VL_ERROR, "Could not read directory %s: %s", it->path, strerror(errno));
+                it->failed = true;
+            }
+            return false;
+        }
+        name = ent->d_name;
+# if defined(DT_UNKNOWN)
+        type = VL__FileTypeFromDirent(ent->d_type);
+# else
+        type = VL_FILE_INVALID;
+# endif
+#endif
+        if(name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+
+        it->entry.name = ViewFromCstr(name);
+        it->hasStat = false;
+        if(type == VL_FILE_INVALID) {
+            // NOTE: Some filesystems don't fill in d_type
+            vl_file_stat fileStat;
+            if(!VL_DirIterStat(it, &fileStat)) {
+                it->failed = true;
+                return false;
+            }
+            type = fileStat.type;
+        }
+        it->entry.type = type;
+
+        if(type != VL_FILE_DIRECTORY) {
+            if(!ViewEndsWith(it->entry.name, it->ext)) continue;
+            if(it->glob && !VL_GlobMatch(it->glob, it->entry.name)) continue;
+        }
+        return true;
+    }
+}
+
+VLIBPROC bool VL_DirIterStat(vl_dir_iter *it, vl_file_stat *fileStat)
+{
+    if(!it->hasStat) {
+#if OS_WINDOWS
+        it->stat.mtime = ((u64)it->data.ftLastWriteTime.dwHighDateTime << 32) | it->data.ftLastWriteTime.dwLowDateTime;
+        it->stat.size = ((u64)it->data.nFileSizeHigh << 32) | it->data.nFileSizeLow;
+        it->stat.inode = 0;
+        if(it->data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) it->stat.type = VL_FILE_DIRECTORY;
+        else if(it->data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) it->stat.type = VL_FILE_SYMLINK;
+        else it->stat.type = VL_FILE_REGULAR;
+#else
+        struct stat statbuf;
+        if(fstatat(it->fd, it->entry.name.items, &statbuf, AT_SYMLINK_NOFOLLOW) < 0) {
+            VL_Log(VL_ERROR, "Could not stat %s/%s: %s", it->path, it->entry.name.items, strerror(errno));
+            return false;
+        }
+        VL__FileStatFromStat(&statbuf, &it->stat);
+#endif
+        it->hasStat = true;
+    }
+    *fileStat = it->stat;
+    return true;
+}
+
+VLIBPROC void VL_DirIterClose(vl_dir_iter *it)
+{
+#if OS_WINDOWS
+    if(it->hFind != INVALID_HANDLE_VALUE) FindClose(it->hFind);
+    it->hFind = INVALID_HANDLE_VALUE;
+#elif OS_LINUX
+    if(it->fd >= 0) close(it->fd);
+    it->fd = -1;
+#else
+    if(it->dir) closedir((DIR*)it->dir);
+    it->dir = NULL;
+    it->fd = -1;
+#endif
 }
 
 VLIBPROC bool VL_ReadEntireDir(const char *parent, vl_file_paths *children)
@@ -1035,42 +2507,545 @@ VLIBPROC bool SbPadAlign(string_builder *sb, size_t size)
     return true;
 }
 
-VLIBPROC bool VL_ProcWait(vl_proc proc)
+#define VL__TRACE_NONE ((size_t)-1)
+
+static u64 VL__ThreadId(void)
 {
-    if(proc == VL_INVALID_PROC) return false;
+#if OS_WINDOWS
+    return (u64)GetCurrentThreadId();
+#else
+    return (u64)(uintptr_t)pthread_self();
+#endif
+}
 
-#ifdef _WIN32
-    DWORD result = WaitForSingleObject(
-                       proc,    // HANDLE hHandle,
-                       INFINITE // DWORD  dwMilliseconds
-                   );
+VLIBPROC void VL_TraceEnable(void)
+{
+    if(VL_trace.enabled) return;
+    VL_MutexInit(&VL_trace.lock);
+    VL_trace.origin = VL_GetNanos();
+    VL_trace.mainThread = VL__ThreadId();
+    VL_trace.enabled = true;
+}
 
-    if(result == WAIT_FAILED) {
-        VL_Log(VL_ERROR, "could not wait on child process: %s", Win32_ErrorMessage(GetLastError()));
-        return false;
-    }
+static size_t VL__TraceAdd(const char *category, const char *name, u32 slot)
+{
+    size_t nameLength = strlen(name);
+    vl_trace_event event = {0};
+    event.name = (char*)VL_REALLOC(NULL, nameLength + 1);
+    Assert(event.name != NULL && "Buy more RAM lool!!");
+    memcpy(event.name, name, nameLength + 1);
+    event.category = category;
+    event.thread = VL__ThreadId();
+    event.slot = slot;
+    event.start = VL_GetNanos();
+
+    VL_MutexLock(&VL_trace.lock);
+    DaAppend(&VL_trace.events, event);
+    size_t index = VL_trace.events.count - 1;
+    VL_MutexUnlock(&VL_trace.lock);
+    return index;
+}
 
-    DWORD exit_status;
-    if(!GetExitCodeProcess(proc, &exit_status)) {
-        VL_Log(VL_ERROR, "could not get process exit code: %s", Win32_ErrorMessage(GetLastError()));
-        return false;
-    }
+VLIBPROC size_t VL_TraceBegin(const char *category, const char *name)
+{
+    if(!VL_trace.enabled) return VL__TRACE_NONE;
+    return VL__TraceAdd(category, name, 0);
+}
 
-    if(exit_status != 0) {
-        VL_Log(VL_ERROR, "command exited with exit code %lu", exit_status);
-        return false;
-    }
+VLIBPROC void VL_TraceEnd(size_t event)
+{
+    if(event == VL__TRACE_NONE || !VL_trace.enabled) return;
+    u64 now = VL_GetNanos();
+    VL_MutexLock(&VL_trace.lock);
+    VL_trace.events.items[event].end = now;
+    VL_MutexUnlock(&VL_trace.lock);
+}
+
+// The process takes the lowest free job slot until it's waited
+static void VL__TraceProcStart(vl_proc proc, vl_cmd cmd)
+{
+    if(!VL_trace.enabled) return;
+    string_builder rendered = {0};
+    VL_CmdRender(cmd, &rendered);
+    SbAppendNull(&rendered);
+
+    VL_MutexLock(&VL_trace.lock);
+    if(VL_trace.slots.count == 0) DaAppend(&VL_trace.slots, true);
+    u32 slot = 1;
+    while(slot < VL_trace.slots.count && VL_trace.slots.items[slot]) slot++;
+    if(slot == VL_trace.slots.count) DaAppend(&VL_trace.slots, true);
+    VL_trace.slots.items[slot] = true;
+    VL_MutexUnlock(&VL_trace.lock);
+
+    vl__trace_proc running = { .proc = proc, .event = VL__TraceAdd("cmd", rendered.items, slot) };
+    VL_MutexLock(&VL_trace.lock);
+    DaAppend(&VL_trace.running, running);
+    VL_MutexUnlock(&VL_trace.lock);
+    SbFree(rendered);
+}
+
+static void VL__TraceProcEnd(vl_proc proc)
+{
+    if(!VL_trace.enabled) return;
+    u64 now = VL_GetNanos();
+    VL_MutexLock(&VL_trace.lock);
+    for(size_t i = 0; i < VL_trace.running.count; i++) {
+        if(VL_trace.running.items[i].proc != proc) continue;
+        vl_trace_event *event = &VL_trace.events.items[VL_trace.running.items[i].event];
+        event->end = now;
+        VL_trace.slots.items[event->slot] = false;
+        DaRemoveUnordered(&VL_trace.running, i);
+        break;
+    }
+    VL_MutexUnlock(&VL_trace.lock);
+}
+
+VLIBPROC void VL_TraceFree(void)
+{
+    if(!VL_trace.enabled) return;
+    for(size_t i = 0; i < VL_trace.events.count; i++) VL_FREE(VL_trace.events.items[i].name);
+    DaFree(VL_trace.events);
+    DaFree(VL_trace.running);
+    DaFree(VL_trace.slots);
+    VL_MutexDestroy(&VL_trace.lock);
+    memset(&VL_trace, 0, sizeof(VL_trace));
+}
+
+typedef struct {
+    vl_proc proc;
+    // Read end of the pipe on posix, temporary file on windows. VL_INVALID_FD once it's read entirely
+    vl_fd fd;
+    string_builder output;
+    // Submission number if the output is ordered, 0 if it's printed as soon as the command ends
+    u64 order;
+    bool ended;
+} vl__capture;
+
+typedef struct {
+    // NOTE: Pointers so the captures don't move while they're being read
+    vl__capture **items;
+    size_t count;
+    size_t capacity;
+    u64 submitted;
+    u64 flushed;
+} vl__captures;
+
+// NOTE: Like ArenaTemp, captured commands should be started and waited from a single thread
+static vl__captures VL__captures = {0};
+
+// Gives the fd the child should write its output to
+static bool VL__CaptureStart(vl_fd *childFd, vl_fd *parentFd)
+{
+#if OS_WINDOWS
+    // NOTE: A file instead of a pipe: every inheritable handle goes to every child, a pipe would
+    // only reach EOF once all the commands started after this one ended too
+    char dir[MAX_PATH], path[MAX_PATH];
+    if(!GetTempPathA(sizeof(dir), dir) || !GetTempFileNameA(dir, "vl", 0, path)) {
+        VL_Log(VL_ERROR, "Could not get a temporary file to capture output: %s", Win32_ErrorMessage(GetLastError()));
+        return false;
+    }
+    SECURITY_ATTRIBUTES securityAttrs = {
+        .nLength = sizeof(SECURITY_ATTRIBUTES),
+        .bInheritHandle = true,
+    };
+    HANDLE file = CreateFileA(path, GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                              &securityAttrs, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY|FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    if(file == INVALID_HANDLE_VALUE) {
+        VL_Log(VL_ERROR, "Could not open temporary file '%s' to capture output: %s", path, Win32_ErrorMessage(GetLastError()));
+        return false;
+    }
+    *childFd = file;
+    *parentFd = file;
+#else
+    int fds[2];
+    if(pipe(fds) < 0) {
+        VL_Log(VL_ERROR, "Could not create pipe to capture output: %s", strerror(errno));
+        return false;
+    }
+    // NOTE: Other children must not keep the write end open, the read end never blocks the build
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    *parentFd = fds[0];
+    *childFd = fds[1];
+#endif
+    return true;
+}
+
+static void VL__CaptureAdd(vl_proc proc, vl_fd fd, bool ordered)
+{
+    vl__capture *capture = (vl__capture*)VL_REALLOC(NULL, sizeof(vl__capture));
+    Assert(capture != NULL && "Buy more RAM lool!!");
+    memset(capture, 0, sizeof(*capture));
+    capture->proc = proc;
+    capture->fd = fd;
+    if(ordered) capture->order = ++VL__captures.submitted;
+    DaAppend(&VL__captures, capture);
+}
+
+static vl__capture *VL__CaptureFind(vl_proc proc)
+{
+    for(size_t i = 0; i < VL__captures.count; i++) {
+        if(VL__captures.items[i]->proc == proc && !VL__captures.items[i]->ended) return VL__captures.items[i];
+    }
+    return NULL;
+}
+
+// Reads what's available, waiting for the writers to close it if block is set
+static void VL__CaptureRead(vl__capture *capture, bool block)
+{
+    if(capture->fd == VL_INVALID_FD) return;
+    char buf[4096];
+#if OS_WINDOWS
+    // NOTE: The file is only read once the command has ended
+    if(!block) return;
+    SetFilePointer(capture->fd, 0, NULL, FILE_BEGIN);
+    uint32_t bytesRead;
+    while(VL_FileRead(capture->fd, buf, sizeof(buf), &bytesRead)) {
+        SbAppendBuf(&capture->output, buf, bytesRead);
+    }
+#else
+    for(;;) {
+        ssize_t bytesRead = read(capture->fd, buf, sizeof(buf));
+        if(bytesRead > 0) {
+            SbAppendBuf(&capture->output, buf, (size_t)bytesRead);
+            continue;
+        }
+        if(bytesRead < 0 && errno == EINTR) continue;
+        if(bytesRead < 0 && errno == EAGAIN && block) {
+            struct pollfd pfd = { .fd = capture->fd, .events = POLLIN };
+            poll(&pfd, 1, -1);
+            continue;
+        }
+        if(bytesRead < 0 && errno == EAGAIN) return;
+        break;
+    }
+#endif
+    VL_FileClose(capture->fd);
+    capture->fd = VL_INVALID_FD;
+}
+
+// Prints the output of the captures that ended, ordered ones only once the earlier ones were printed
+static void VL__CaptureFlush(void)
+{
+    for(size_t i = 0; i < VL__captures.count;) {
+        vl__capture *capture = VL__captures.items[i];
+        if(!capture->ended || (capture->order && capture->order != VL__captures.flushed + 1)) {
+            i++;
+            continue;
+        }
+        if(capture->output.count > 0) {
+            // NOTE: Written all at once so nothing else can get in the middle
+            fflush(stdout);
+            fwrite(capture->output.items, 1, capture->output.count, stderr);
+            fflush(stderr);
+        }
+        if(capture->order) VL__captures.flushed++;
+        SbFree(capture->output);
+        VL_FREE(capture);
+        DaRemoveUnordered(&VL__captures, i);
+        // NOTE: An ordered capture may have been waiting on this one
+        i = 0;
+    }
+}
+
+static void VL__CaptureEnd(vl_proc proc)
+{
+    vl__capture *capture = VL__CaptureFind(proc);
+    if(!capture) return;
+    VL__CaptureRead(capture, true);
+    capture->ended = true;
+    VL__CaptureFlush();
+}
+
+vl_jobserver VL_jobserver = {0};
+
+static void VL__JobserverWrite(char token)
+{
+#if OS_WINDOWS
+    (void)token;
+    ReleaseSemaphore(VL_jobserver.semaphore, 1, NULL);
+#else
+    while(write(VL_jobserver.writeFd, &token, 1) < 0 && errno == EINTR) {}
+#endif
+}
+
+// Reads a token if there's one
+static bool VL__JobserverTryRead(char *token)
+{
+#if OS_WINDOWS
+    if(WaitForSingleObject(VL_jobserver.semaphore, 0) != WAIT_OBJECT_0) return false;
+    *token = '+';
+    return true;
+#else
+    if(VL_jobserver.pollRead) {
+        // NOTE: Another process can take it in between, then read blocks until there's another
+        struct pollfd fd = { .fd = VL_jobserver.readFd, .events = POLLIN };
+        if(poll(&fd, 1, 0) <= 0) return false;
+    }
+    return read(VL_jobserver.readFd, token, 1) == 1;
+#endif
+}
+
+// The token of proc goes back to the jobserver, if it had one
+static void VL__JobserverRelease(vl_proc proc)
+{
+    for(size_t i = 0; i < VL_jobserver.held.count; i++) {
+        if(VL_jobserver.held.items[i].proc != proc) continue;
+        if(!VL_jobserver.held.items[i].implicit) VL__JobserverWrite(VL_jobserver.held.items[i].token);
+        DaRemoveUnordered(&VL_jobserver.held, i);
+        return;
+    }
+}
+
+#if !OS_WINDOWS
+// A read end of its own for a pipe of make, so it can be nonblocking without changing make's
+static int VL__JobserverReopen(int fd)
+{
+#if OS_LINUX
+    return open(temp_sprintf("/proc/self/fd/%d", fd), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+#else
+    (void)fd;
+    return -1;
+#endif
+}
+#endif
+
+static void VL__JobserverInit(void)
+{
+    if(VL_jobserver.initialized) return;
+    VL_jobserver.initialized = true;
+    const char *flags = getenv("MAKEFLAGS");
+    if(VL_jobserver.disabled || !flags) return;
+
+    // NOTE: make 4.2+ writes --jobserver-auth, older ones --jobserver-fds. The last one is the one to use
+    const char *auth = NULL;
+    for(const char *p = flags; (p = strstr(p, "--jobserver-")) != NULL; p++) {
+        if(strncmp(p, "--jobserver-auth=", 17) == 0) auth = p + 17;
+        else if(strncmp(p, "--jobserver-fds=", 16) == 0) auth = p + 16;
+    }
+    if(!auth) return;
+    const char *value = temp_sprintf("%.*s", (int)strcspn(auth, " "), auth);
+
+#if OS_WINDOWS
+    VL_jobserver.semaphore = OpenSemaphoreA(SEMAPHORE_ALL_ACCESS, FALSE, value);
+    if(!VL_jobserver.semaphore) {
+        VL_Log(VL_WARNING, "Could not open the jobserver semaphore %s: %s", value, Win32_ErrorMessage(GetLastError()));
+        return;
+    }
+#else
+    int readFd = -1, writeFd = -1;
+    if(strncmp(value, "fifo:", 5) == 0) {
+        readFd = writeFd = open(value + 5, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    } else {
+        int r, w;
+        // NOTE: make only passes the pipe to rules marked with '+' or running $(MAKE)
+        if(sscanf(value, "%d,%d", &r, &w) == 2 && fcntl(r, F_GETFD) >= 0 && fcntl(w, F_GETFD) >= 0) {
+            writeFd = w;
+            readFd = VL__JobserverReopen(r);
+            if(readFd < 0) {
+                readFd = r;
+                VL_jobserver.pollRead = true;
+            }
+        }
+    }
+    if(readFd < 0) {
+        VL_Log(VL_WARNING, "Could not use the jobserver of make (%s), is the rule marked with '+'?", value);
+        return;
+    }
+    VL_jobserver.readFd = readFd;
+    VL_jobserver.writeFd = writeFd;
+#endif
+    VL_Log(VL_INFO, "Using the jobserver of make: %s", value);
+    VL_jobserver.client = true;
+}
+
+VLIBPROC bool VL_JobserverActive(void)
+{
+    VL__JobserverInit();
+    return VL_jobserver.client;
+}
+
+VLIBPROC bool VL_JobserverServe_Opt(struct VL_JobserverServe_opts opt)
+{
+    if(VL_JobserverActive()) return true;
+    size_t jobs = opt.jobs > 0 ? opt.jobs : (size_t)VL_GetCountProcs();
+    const char *auth;
+#if OS_WINDOWS
+    auth = temp_sprintf("vl_jobserver_%lu", (unsigned long)GetCurrentProcessId());
+    VL_jobserver.semaphore = CreateSemaphoreA(NULL, (LONG)(jobs - 1), (LONG)jobs, auth);
+    if(!VL_jobserver.semaphore) {
+        VL_Log(VL_ERROR, "Could not create the jobserver semaphore: %s", Win32_ErrorMessage(GetLastError()));
+        return false;
+    }
+#else
+    if(opt.pipeFds) {
+        int fds[2];
+        if(pipe(fds) < 0) {
+            VL_Log(VL_ERROR, "Could not create the jobserver pipe: %s", strerror(errno));
+            return false;
+        }
+        // NOTE: The children get fds (not cloexec), this process reads from its own nonblocking end
+        VL_jobserver.writeFd = fds[1];
+        VL_jobserver.readFd = VL__JobserverReopen(fds[0]);
+        if(VL_jobserver.readFd < 0) {
+            VL_jobserver.readFd = fds[0];
+            VL_jobserver.pollRead = true;
+        }
+        auth = temp_sprintf("%d,%d", fds[0], fds[1]);
+    } else {
+        const char *dir = getenv("TMPDIR");
+        const char *fifoPath = temp_sprintf("%s/vl-jobserver-%d", dir ? dir : "/tmp", (int)getpid());
+        VL_jobserver.fifoPath = VL__HeapStrndup(fifoPath, strlen(fifoPath));
+        unlink(VL_jobserver.fifoPath);
+        if(mkfifo(VL_jobserver.fifoPath, 0600) < 0) {
+            VL_Log(VL_ERROR, "Could not create the jobserver fifo %s: %s", VL_jobserver.fifoPath, strerror(errno));
+            VL_FREE(VL_jobserver.fifoPath);
+            VL_jobserver.fifoPath = NULL;
+            return false;
+        }
+        VL_jobserver.readFd = VL_jobserver.writeFd = open(VL_jobserver.fifoPath, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        auth = temp_sprintf("fifo:%s", VL_jobserver.fifoPath);
+    }
+    for(size_t i = 1; i < jobs; i++) VL__JobserverWrite('+');
+#endif
+
+    const char *previous = getenv("MAKEFLAGS");
+    if(previous) VL_jobserver.previousMakeflags = VL__HeapStrndup(previous, strlen(previous));
+    const char *makeflags = temp_sprintf("%s -j%zu --jobserver-auth=%s", previous ? previous : "", jobs, auth);
+#if OS_WINDOWS
+    SetEnvironmentVariableA("MAKEFLAGS", makeflags);
+#else
+    setenv("MAKEFLAGS", makeflags, 1);
+#endif
+    VL_Log(VL_INFO, "Serving %zu jobs: %s", jobs, auth);
+    VL_jobserver.client = true;
+    VL_jobserver.server = true;
+    return true;
+}
+
+VLIBPROC void VL_JobserverFree(void)
+{
+    if(VL_jobserver.client) {
+#if OS_WINDOWS
+        CloseHandle(VL_jobserver.semaphore);
+#else
+        close(VL_jobserver.readFd);
+        if(VL_jobserver.server && VL_jobserver.writeFd != VL_jobserver.readFd) close(VL_jobserver.writeFd);
+#endif
+    }
+    if(VL_jobserver.server) {
+#if OS_WINDOWS
+        SetEnvironmentVariableA("MAKEFLAGS", VL_jobserver.previousMakeflags);
+#else
+        if(VL_jobserver.previousMakeflags) setenv("MAKEFLAGS", VL_jobserver.previousMakeflags, 1);
+        else unsetenv("MAKEFLAGS");
+        if(VL_jobserver.fifoPath) unlink(VL_jobserver.fifoPath);
+#endif
+    }
+    VL_FREE(VL_jobserver.fifoPath);
+    VL_FREE(VL_jobserver.previousMakeflags);
+    DaFree(VL_jobserver.held);
+    memset(&VL_jobserver, 0, sizeof(VL_jobserver));
+}
+
+#if OS_LINUX && defined(SYS_pidfd_open)
+typedef struct {
+    vl_proc proc;
+    int fd;
+} vl__pidfd;
+
+typedef struct {
+    vl__pidfd *items;
+    size_t count;
+    size_t capacity;
+} vl__pidfds;
+
+// NOTE: Opened the first time a process is waited for along with others, closed once it's reaped
+static vl__pidfds VL__pidfds = {0};
+static bool VL__pidfdsUnsupported = false;
+
+// -1 if the kernel doesn't have pidfds
+static int VL__PidfdGet(vl_proc proc)
+{
+    for(size_t i = 0; i < VL__pidfds.count; i++) {
+        if(VL__pidfds.items[i].proc == proc) return VL__pidfds.items[i].fd;
+    }
+    if(VL__pidfdsUnsupported) return -1;
+    int fd = (int)syscall(SYS_pidfd_open, proc, 0);
+    if(fd < 0) {
+        if(errno == ENOSYS) VL__pidfdsUnsupported = true;
+        return -1;
+    }
+    vl__pidfd pidfd = { .proc = proc, .fd = fd };
+    DaAppend(&VL__pidfds, pidfd);
+    return fd;
+}
+
+static void VL__PidfdClose(vl_proc proc)
+{
+    for(size_t i = 0; i < VL__pidfds.count; i++) {
+        if(VL__pidfds.items[i].proc != proc) continue;
+        close(VL__pidfds.items[i].fd);
+        DaRemoveUnordered(&VL__pidfds, i);
+        return;
+    }
+}
+#endif
+
+// Called once the process has ended, before its exit status is reported
+static void VL__ProcEnded(vl_proc proc)
+{
+    VL__TraceProcEnd(proc);
+    VL__CaptureEnd(proc);
+    VL__JobserverRelease(proc);
+#if OS_LINUX && defined(SYS_pidfd_open)
+    VL__PidfdClose(proc);
+#endif
+}
+
+VLIBPROC bool VL_ProcWait(vl_proc proc)
+{
+    if(proc == VL_INVALID_PROC) return false;
+
+#ifdef _WIN32
+    DWORD result = WaitForSingleObject(
+                       proc,    // HANDLE hHandle,
+                       INFINITE // DWORD  dwMilliseconds
+                   );
+
+    if(result == WAIT_FAILED) {
+        VL_Log(VL_ERROR, "could not wait on child process: %s", Win32_ErrorMessage(GetLastError()));
+        return false;
+    }
+    VL__ProcEnded(proc);
+
+    DWORD exit_status;
+    if(!GetExitCodeProcess(proc, &exit_status)) {
+        VL_Log(VL_ERROR, "could not get process exit code: %s", Win32_ErrorMessage(GetLastError()));
+        return false;
+    }
+
+    if(exit_status != 0) {
+        VL_Log(VL_ERROR, "command exited with exit code %lu", exit_status);
+        return false;
+    }
 
     CloseHandle(proc);
 
     return true;
 #else
+    // NOTE: Read captured output first, the child could be waiting for space in the pipe
+    vl__capture *capture = VL__CaptureFind(proc);
+    if(capture) VL__CaptureRead(capture, true);
+
     for(;;) {
         int wstatus = 0;
         if(waitpid(proc, &wstatus, 0) < 0) {
             VL_Log(VL_ERROR, "could not wait on command (pid %d): %s", proc, strerror(errno));
             return false;
         }
+        VL__ProcEnded(proc);
 
         if(WIFEXITED(wstatus)) {
             int exit_status = WEXITSTATUS(wstatus);
@@ -1110,6 +3085,7 @@ VLIBPROC int VL__ProcWaitAsync(vl_proc proc, int ms)
         VL_Log(VL_ERROR, "could not wait on child process: %s", Win32_ErrorMessage(GetLastError()));
         return -1;
     }
+    VL__ProcEnded(proc);
 
     DWORD exit_status;
     if(!GetExitCodeProcess(proc, &exit_status)) {
@@ -1132,6 +3108,9 @@ VLIBPROC int VL__ProcWaitAsync(vl_proc proc, int ms)
         .tv_nsec = ns%(1000*1000*1000),
     };
 
+    vl__capture *capture = VL__CaptureFind(proc);
+    if(capture) VL__CaptureRead(capture, false);
+
     int wstatus = 0;
     pid_t pid = waitpid(proc, &wstatus, WNOHANG);
     if(pid < 0) {
@@ -1140,9 +3119,10 @@ VLIBPROC int VL__ProcWaitAsync(vl_proc proc, int ms)
     }
 
     if(pid == 0) {
-        nanosleep(&duration, NULL);
+        if(ms > 0) nanosleep(&duration, NULL);
         return 0;
     }
+    VL__ProcEnded(proc);
 
     if(WIFEXITED(wstatus)) {
         int exit_status = WEXITSTATUS(wstatus);
@@ -1159,79 +3139,383 @@ VLIBPROC int VL__ProcWaitAsync(vl_proc proc, int ms)
         return -1;
     }
 
-    nanosleep(&duration, NULL);
+    if(ms > 0) nanosleep(&duration, NULL);
     return 0;
 #endif
 }
 
-// Wait until all the processes have finished
-VLIBPROC bool VL_ProcsWait(vl_procs procs)
+#if !OS_WINDOWS
+static int VL__sigchldPipe[2] = {-1, -1};
+static struct sigaction VL__sigchldPrevious;
+
+static void VL__SigchldHandler(int sig, siginfo_t *info, void *ucontext)
 {
-    bool ok = true;
-    for(size_t i = 0; i < procs.count; ++i) {
-        ok = VL_ProcWait(procs.items[i]) && ok;
+    int savedErrno = errno;
+    // NOTE: The pipe is nonblocking, if it's full the waiter wakes up anyway
+    ssize_t written = write(VL__sigchldPipe[1], "", 1);
+    (void)written;
+    errno = savedErrno;
+
+    if(VL__sigchldPrevious.sa_flags & SA_SIGINFO) {
+        if(VL__sigchldPrevious.sa_sigaction) VL__sigchldPrevious.sa_sigaction(sig, info, ucontext);
+    } else if(VL__sigchldPrevious.sa_handler != SIG_DFL && VL__sigchldPrevious.sa_handler != SIG_IGN) {
+        VL__sigchldPrevious.sa_handler(sig);
     }
-    return ok;
 }
 
-// Wait until all the processes have finished and empty the procs array.
-VLIBPROC bool VL_ProcsFlush(vl_procs *procs)
+// Self-pipe written by a SIGCHLD handler, the previous handler is still called
+static bool VL__SigchldPipeInit(void)
 {
-    bool ok = VL_ProcsWait(*procs);
-    procs->count = 0;
-    return ok;
+    if(VL__sigchldPipe[0] >= 0) return true;
+    if(pipe(VL__sigchldPipe) < 0) {
+        VL_Log(VL_ERROR, "Could not create the SIGCHLD pipe: %s", strerror(errno));
+        return false;
+    }
+    for(int i = 0; i < 2; i++) {
+        fcntl(VL__sigchldPipe[i], F_SETFL, fcntl(VL__sigchldPipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(VL__sigchldPipe[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    struct sigaction action = {0};
+    action.sa_sigaction = VL__SigchldHandler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&action.sa_mask);
+    if(sigaction(SIGCHLD, &action, &VL__sigchldPrevious) < 0) {
+        VL_Log(VL_ERROR, "Could not set the SIGCHLD handler: %s", strerror(errno));
+        close(VL__sigchldPipe[0]);
+        close(VL__sigchldPipe[1]);
+        VL__sigchldPipe[0] = VL__sigchldPipe[1] = -1;
+        return false;
+    }
+    return true;
 }
+#endif
 
-VLIBPROC void VL_CmdRender(vl_cmd cmd, string_builder *render)
+// Whether proc ended, without waiting for it (its exit status is still there for VL_ProcWait)
+static bool VL__ProcHasEnded(vl_proc proc)
 {
-    for(size_t i = 0; i < cmd.count; ++i) {
-        const char *arg = cmd.items[i];
-        if(arg == NULL) break;
-        if(i > 0) SbAppendCstr(render, " ");
-        if(!strchr(arg, ' ')) {
-            SbAppendCstr(render, arg);
-        } else {
-            DaAppend(render, '\'');
-            SbAppendCstr(render, arg);
-            DaAppend(render, '\'');
-        }
-    }
+#if OS_WINDOWS
+    return WaitForSingleObject(proc, 0) == WAIT_OBJECT_0;
+#else
+    siginfo_t info = {0};
+    return waitid(P_PID, (id_t)proc, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid != 0;
+#endif
 }
 
-VLIBPROC bool CmdRun_Opt(vl_cmd_opts opt)
+#if !OS_WINDOWS
+// Blocks until a process ended or has captured output to read, ended is its index or procs.count
+// if it only read output. False if it can't wait
+static bool VL__ProcsPoll(vl_procs procs, size_t *ended)
 {
+    *ended = procs.count;
     bool result = true;
-    vl_fd fdin = VL_INVALID_FD;
-    vl_fd fdout = VL_INVALID_FD;
-    vl_fd fderr = VL_INVALID_FD;
-    vl_proc proc = VL_INVALID_PROC;
-    vl_fd *optFdin = 0;
-    vl_fd *optFdout = 0;
-    vl_fd *optFderr = 0;
-
-    size_t max_procs = opt.maxProcs > 0 ? opt.maxProcs : (size_t) VL_GetCountProcs() + 1;
-
-    if(opt.async && max_procs > 0) {
-        while(opt.async->count >= max_procs) {
-            for(size_t i = 0; i < opt.async->count; ++i) {
-                int ret = VL__ProcWaitAsync(opt.async->items[i], 1);
-                if(ret < 0) VL_ReturnDefer(false);
-                if(ret) {
-                    DaRemoveUnordered(opt.async, i);
-                    break;
-                }
+    struct pollfd *fds = (struct pollfd*)VL_REALLOC(NULL, (2*procs.count + 1)*sizeof(struct pollfd));
+    vl__capture **captures = (vl__capture**)VL_REALLOC(NULL, procs.count*sizeof(vl__capture*));
+    Assert(fds != NULL && captures != NULL && "Buy more RAM lool!!");
+    size_t count = 0;
+    for(size_t i = 0; i < procs.count; i++) {
+        vl__capture *capture = VL__CaptureFind(procs.items[i]);
+        if(capture && capture->fd != VL_INVALID_FD) {
+            captures[count] = capture;
+            fds[count++] = (struct pollfd){ .fd = capture->fd, .events = POLLIN };
+        }
+    }
+    size_t waitStart = count;
+
+    bool pidfds = false;
+#if OS_LINUX && defined(SYS_pidfd_open)
+    // NOTE: A pidfd is readable once its process ended, even if that was before the poll
+    pidfds = true;
+    for(size_t i = 0; i < procs.count; i++) {
+        int fd = VL__PidfdGet(procs.items[i]);
+        if(fd < 0) {
+            pidfds = false;
+            break;
+        }
+        fds[count++] = (struct pollfd){ .fd = fd, .events = POLLIN };
+    }
+    if(!pidfds) count = waitStart;
+#endif
+    if(!pidfds) {
+        if(VL__sigchldPipe[0] < 0 && !VL__SigchldPipeInit()) VL_ReturnDefer(false);
+        // NOTE: A wake could have been drained while waiting for another process, so they're checked first
+        for(size_t i = 0; i < procs.count; i++) {
+            if(VL__ProcHasEnded(procs.items[i])) {
+                *ended = i;
+                VL_ReturnDefer(true);
             }
         }
+        fds[count++] = (struct pollfd){ .fd = VL__sigchldPipe[0], .events = POLLIN };
     }
 
-    if(opt.stdinPath) {
-        fdin = VL_FopenForRead(opt.stdinPath);
-        if(fdin == VL_INVALID_FD) VL_ReturnDefer(false);
-        optFdin = &fdin;
+    if(poll(fds, (nfds_t)count, -1) < 0) {
+        if(errno != EINTR) {
+            VL_Log(VL_ERROR, "could not wait on child processes: %s", strerror(errno));
+            result = false;
+        }
+        VL_ReturnDefer(result);
     }
-    if(opt.stdoutPath) {
-        fdout = VL_FopenForWrite(opt.stdoutPath);
-        if(fdout == VL_INVALID_FD) VL_ReturnDefer(false);
+    for(size_t i = 0; i < waitStart; i++) {
+        if(fds[i].revents) VL__CaptureRead(captures[i], false);
+    }
+    if(pidfds) {
+        for(size_t i = waitStart; i < count; i++) {
+            if(fds[i].revents) {
+                *ended = i - waitStart;
+                break;
+            }
+        }
+    } else {
+        char drain[64];
+        while(read(VL__sigchldPipe[0], drain, sizeof(drain)) > 0) {}
+    }
+
+defer:
+    VL_FREE(captures);
+    VL_FREE(fds);
+    return result;
+}
+#endif
+
+#if OS_WINDOWS
+typedef struct {
+    // NOTE: The first handle is the event that stops the wait
+    HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+    DWORD count;
+    size_t start;
+    HANDLE done;
+    volatile LONG *ended;
+} vl__wait_batch;
+
+static void VL__WaitBatch(void *arg)
+{
+    vl__wait_batch *batch = (vl__wait_batch*)arg;
+    DWORD ret = WaitForMultipleObjects(batch->count, batch->handles, FALSE, INFINITE);
+    if(ret > WAIT_OBJECT_0 && ret < WAIT_OBJECT_0 + batch->count) {
+        InterlockedCompareExchange(batch->ended, (LONG)(batch->start + (ret - WAIT_OBJECT_0) - 1), -1);
+    }
+    SetEvent(batch->done);
+}
+
+// Index of a process that ended, -1 if it couldn't wait
+static LONG VL__ProcsWaitBatches(vl_procs procs)
+{
+    size_t perBatch = MAXIMUM_WAIT_OBJECTS - 1;
+    size_t batchCount = (procs.count + perBatch - 1)/perBatch;
+    vl__wait_batch *batches = (vl__wait_batch*)VL_REALLOC(NULL, batchCount*sizeof(vl__wait_batch));
+    vl_thread *threads = (vl_thread*)VL_REALLOC(NULL, batchCount*sizeof(vl_thread));
+    Assert(batches != NULL && threads != NULL && "Buy more RAM lool!!");
+    volatile LONG ended = -1;
+    HANDLE stop = CreateEventA(NULL, TRUE, FALSE, NULL);
+    HANDLE done = CreateEventA(NULL, TRUE, FALSE, NULL);
+    size_t started = 0;
+    if(stop != NULL && done != NULL) {
+        for(; started < batchCount; started++) {
+            vl__wait_batch *batch = &batches[started];
+            batch->start = started*perBatch;
+            size_t count = Min(procs.count - batch->start, perBatch);
+            batch->handles[0] = stop;
+            memcpy(batch->handles + 1, procs.items + batch->start, count*sizeof(HANDLE));
+            batch->count = (DWORD)count + 1;
+            batch->done = done;
+            batch->ended = &ended;
+            if(!VL_ThreadStart(&threads[started], VL__WaitBatch, batch)) break;
+        }
+    }
+    // NOTE: Every batch has to be waiting, otherwise a process in the missing ones could be the only one left
+    if(started == batchCount) WaitForSingleObject(done, INFINITE);
+    else if(stop == NULL || done == NULL) VL_Log(VL_ERROR, "could not wait on child processes: %s", Win32_ErrorMessage(GetLastError()));
+    if(stop != NULL) SetEvent(stop);
+    for(size_t i = 0; i < started; i++) VL_ThreadJoin(threads[i]);
+    if(stop != NULL) CloseHandle(stop);
+    if(done != NULL) CloseHandle(done);
+    VL_FREE(threads);
+    VL_FREE(batches);
+    return ended;
+}
+#endif
+
+// Blocks until there might be a token or one of the commands holding one ended
+static bool VL__JobserverWait(void)
+{
+#if OS_WINDOWS
+    HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+    DWORD count = 0;
+    handles[count++] = VL_jobserver.semaphore;
+    for(size_t i = 0; i < VL_jobserver.held.count && count < MAXIMUM_WAIT_OBJECTS; i++) {
+        handles[count++] = VL_jobserver.held.items[i].proc;
+    }
+    DWORD ret = WaitForMultipleObjects(count, handles, FALSE, INFINITE);
+    if(ret == WAIT_FAILED) {
+        VL_Log(VL_ERROR, "could not wait for a jobserver token: %s", Win32_ErrorMessage(GetLastError()));
+        return false;
+    }
+    // NOTE: Waiting took the token, it's given back to be read with the others
+    if(ret == WAIT_OBJECT_0) ReleaseSemaphore(VL_jobserver.semaphore, 1, NULL);
+    return true;
+#else
+    // NOTE: A command could have ended before the handler was set, it's checked again first
+    if(VL__sigchldPipe[0] < 0) return VL__SigchldPipeInit();
+
+    bool result = true;
+    struct pollfd *fds = (struct pollfd*)VL_REALLOC(NULL, (VL_jobserver.held.count + 2)*sizeof(struct pollfd));
+    Assert(fds != NULL && "Buy more RAM lool!!");
+    size_t count = 0;
+    fds[count++] = (struct pollfd){ .fd = VL_jobserver.readFd, .events = POLLIN };
+    fds[count++] = (struct pollfd){ .fd = VL__sigchldPipe[0], .events = POLLIN };
+    // NOTE: Their captured output has to be read or they could block writing it
+    for(size_t i = 0; i < VL_jobserver.held.count; i++) {
+        vl__capture *capture = VL__CaptureFind(VL_jobserver.held.items[i].proc);
+        if(capture && capture->fd != VL_INVALID_FD) fds[count++] = (struct pollfd){ .fd = capture->fd, .events = POLLIN };
+    }
+    if(poll(fds, (nfds_t)count, -1) < 0 && errno != EINTR) {
+        VL_Log(VL_ERROR, "could not wait for a jobserver token: %s", strerror(errno));
+        result = false;
+    }
+    char drain[64];
+    while(read(VL__sigchldPipe[0], drain, sizeof(drain)) > 0) {}
+    for(size_t i = 0; i < VL_jobserver.held.count; i++) {
+        vl__capture *capture = VL__CaptureFind(VL_jobserver.held.items[i].proc);
+        if(capture) VL__CaptureRead(capture, false);
+    }
+    VL_FREE(fds);
+    return result;
+#endif
+}
+
+// Takes a token for a command about to start, waits for one if there's none
+static bool VL__JobserverAcquire(vl__jobserver_token *token)
+{
+    *token = (vl__jobserver_token){0};
+    token->implicit = true;
+    for(size_t i = 0; i < VL_jobserver.held.count; i++) {
+        if(VL_jobserver.held.items[i].implicit) token->implicit = false;
+    }
+    if(token->implicit) return true;
+
+    size_t traceEvent = VL_TraceBegin("jobserver", "token");
+    bool result = true;
+    for(;;) {
+        if(VL__JobserverTryRead(&token->token)) break;
+        // NOTE: A command that ended but wasn't waited for yet gives its token to this one
+        bool found = false;
+        for(size_t i = 0; i < VL_jobserver.held.count; i++) {
+            if(!VL__ProcHasEnded(VL_jobserver.held.items[i].proc)) continue;
+            *token = VL_jobserver.held.items[i];
+            DaRemoveUnordered(&VL_jobserver.held, i);
+            found = true;
+            break;
+        }
+        if(found) break;
+        if(!VL__JobserverWait()) {
+            result = false;
+            break;
+        }
+    }
+    VL_TraceEnd(traceEvent);
+    return result;
+}
+
+VLIBPROC size_t VL_ProcsWaitAny(vl_procs procs, bool *ok)
+{
+    AssertMsg(procs.count > 0, "VL_ProcsWaitAny needs a process to wait for");
+#if OS_WINDOWS
+    size_t i = 0;
+    if(procs.count <= MAXIMUM_WAIT_OBJECTS) {
+        DWORD ret = WaitForMultipleObjects((DWORD)procs.count, procs.items, FALSE, INFINITE);
+        if(ret < WAIT_OBJECT_0 + procs.count) i = ret - WAIT_OBJECT_0;
+        else VL_Log(VL_ERROR, "could not wait on child processes: %s", Win32_ErrorMessage(GetLastError()));
+    } else {
+        // NOTE: WaitForMultipleObjects takes up to 64 handles, with more each batch waits on its own thread
+        LONG ended = VL__ProcsWaitBatches(procs);
+        if(ended >= 0) i = (size_t)ended;
+    }
+    *ok = VL_ProcWait(procs.items[i]);
+    return i;
+#else
+    for(;;) {
+        size_t i;
+        if(!VL__ProcsPoll(procs, &i)) {
+            *ok = VL_ProcWait(procs.items[0]);
+            return 0;
+        }
+        if(i == procs.count) continue;
+        // NOTE: Only the process that ended is reaped, this also reads the rest of its output
+        int ret = VL__ProcWaitAsync(procs.items[i], 0);
+        if(ret != 0) {
+            *ok = ret > 0;
+            return i;
+        }
+    }
+#endif
+}
+
+// Wait until all the processes have finished
+VLIBPROC bool VL_ProcsWait(vl_procs procs)
+{
+    bool ok = true;
+    for(size_t i = 0; i < procs.count; ++i) {
+        ok = VL_ProcWait(procs.items[i]) && ok;
+    }
+    return ok;
+}
+
+// Wait until all the processes have finished and empty the procs array.
+VLIBPROC bool VL_ProcsFlush(vl_procs *procs)
+{
+    bool ok = VL_ProcsWait(*procs);
+    procs->count = 0;
+    return ok;
+}
+
+VLIBPROC void VL_CmdRender(vl_cmd cmd, string_builder *render)
+{
+    for(size_t i = 0; i < cmd.count; ++i) {
+        const char *arg = cmd.items[i];
+        if(arg == NULL) break;
+        if(i > 0) SbAppendCstr(render, " ");
+        if(!strchr(arg, ' ')) {
+            SbAppendCstr(render, arg);
+        } else {
+            DaAppend(render, '\'');
+            SbAppendCstr(render, arg);
+            DaAppend(render, '\'');
+        }
+    }
+}
+
+VLIBPROC bool CmdRun_Opt(vl_cmd_opts opt)
+{
+    bool result = true;
+    vl_fd fdin = VL_INVALID_FD;
+    vl_fd fdout = VL_INVALID_FD;
+    vl_fd fderr = VL_INVALID_FD;
+    vl_proc proc = VL_INVALID_PROC;
+    vl_fd *optFdin = 0;
+    vl_fd *optFdout = 0;
+    vl_fd *optFderr = 0;
+    vl_fd captureChild = VL_INVALID_FD;
+    vl_fd captureParent = VL_INVALID_FD;
+
+    size_t max_procs = opt.maxProcs > 0 ? opt.maxProcs : (size_t) VL_GetCountProcs() + 1;
+
+    if(opt.async && max_procs > 0) {
+        while(opt.async->count >= max_procs) {
+            bool ok;
+            size_t i = VL_ProcsWaitAny(*opt.async, &ok);
+            DaRemoveUnordered(opt.async, i);
+            if(!ok) VL_ReturnDefer(false);
+        }
+    }
+
+    if(opt.stdinPath) {
+        fdin = VL_FopenForRead(opt.stdinPath);
+        if(fdin == VL_INVALID_FD) VL_ReturnDefer(false);
+        optFdin = &fdin;
+    }
+    if(opt.stdoutPath) {
+        fdout = VL_FopenForWrite(opt.stdoutPath);
+        if(fdout == VL_INVALID_FD) VL_ReturnDefer(false);
         optFdout = &fdout;
     }
     if(opt.stderrPath) {
@@ -1239,7 +3523,37 @@ VLIBPROC bool CmdRun_Opt(vl_cmd_opts opt)
         if(fderr == VL_INVALID_FD) VL_ReturnDefer(false);
         optFderr = &fderr;
     }
-    proc = VL_CmdStartProcess(*opt.cmd, optFdin, optFdout, optFderr, true);
+    if(opt.captureOutput && (!optFdout || !optFderr)) {
+        if(!VL__CaptureStart(&captureChild, &captureParent)) VL_ReturnDefer(false);
+    }
+    vl__jobserver_token token;
+    bool jobserver = VL_JobserverActive();
+    if(jobserver && !VL__JobserverAcquire(&token)) {
+        if(captureParent != VL_INVALID_FD) {
+#if !OS_WINDOWS
+            VL_FileClose(captureChild);
+#endif
+            VL_FileClose(captureParent);
+        }
+        VL_ReturnDefer(false);
+    }
+    proc = VL_CmdStartProcess(*opt.cmd, optFdin,
+                              optFdout ? optFdout : (captureChild != VL_INVALID_FD ? &captureChild : 0),
+                              optFderr ? optFderr : (captureChild != VL_INVALID_FD ? &captureChild : 0), true);
+    if(jobserver) {
+        token.proc = proc;
+        if(proc != VL_INVALID_PROC) DaAppend(&VL_jobserver.held, token);
+        else if(!token.implicit) VL__JobserverWrite(token.token);
+    }
+    if(captureParent != VL_INVALID_FD) {
+#if !OS_WINDOWS
+        // NOTE: Only the child may keep the write end open, the capture ends when it's closed.
+        // On windows the child writes to the same handle the parent reads
+        VL_FileClose(captureChild);
+#endif
+        if(proc != VL_INVALID_PROC) VL__CaptureAdd(proc, captureParent, opt.orderedOutput);
+        else VL_FileClose(captureParent);
+    }
 
     if(opt.async) {
         if(proc == VL_INVALID_PROC) VL_ReturnDefer(false);
@@ -1319,6 +3633,30 @@ VLIBPROC bool VL_Rename(const char *old_path, const char *new_path)
     return true;
 }
 
+static int VL__ProcessId(void)
+{
+#if OS_WINDOWS
+    return (int)GetCurrentProcessId();
+#else
+    return (int)getpid();
+#endif
+}
+
+/* Writes "<path>.<pid>.tmp" and renames it over path, so nothing reading path sees a half written file.
+   The caller logs the error, it's not renamed with VL_Rename so every save isn't logged */
+static bool VL__WriteFileAtomic(const char *path, const void *data, size_t size)
+{
+    const char *tmp = temp_sprintf("%s.%d.tmp", path, VL__ProcessId());
+    bool result = WriteEntireFile(tmp, data, size);
+#if OS_WINDOWS
+    if(result) result = MoveFileEx(tmp, path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    if(result) result = rename(tmp, path) == 0;
+#endif
+    if(!result && VL_FileExists(tmp)) VL_DeleteFile(tmp);
+    return result;
+}
+
 VLIBPROC bool VL_GetLastWriteTime(const char *file, u64 *writeTime)
 {
     bool result = true;
@@ -1333,650 +3671,5117 @@ VLIBPROC bool VL_GetLastWriteTime(const char *file, u64 *writeTime)
     return result;
 }
 
-VLIBPROC int VL_NeedsRebuild_Impl(const char *output_path, const char **input_paths, size_t input_paths_count)
+static bool VL__FileTimeInit(void)
 {
-    u64 outputFileTime;
-    if(!GetLastWriteTime(output_path, &outputFileTime)) return 1;
+    vl_needrebuild_context *ctx = &VL_needsRebuildContext;
+    if(ctx->table.nodes.items) return true;
+
+    if(!ctx->Arena) {
+        u8 *mem = (u8*)VL_REALLOC(NULL, sizeof(memory_arena) + VL_BUILD_FILETIME_ARENA_SIZE);
+        if(!mem) return false;
+        ctx->Arena = (memory_arena*)mem;
+        ArenaInit(ctx->Arena, VL_BUILD_FILETIME_ARENA_SIZE, mem + sizeof(memory_arena));
+    }
 
-    for(size_t i = 0; i < input_paths_count; ++i) {
-        const char *input_path = input_paths[i];
-        u64 inputFileTime;
-        if(!VL_GetLastWriteTime(input_path, &inputFileTime)) return -1;
+    size_t size = VL_BUILD_FILETIME_TABLE_SIZE*sizeof(vl_filetime_node);
+    if(ArenaGetRemaining(ctx->Arena, .Alignment = 8) < size) return false;
+    ctx->table.nodes.items = (vl_filetime_node*)ArenaPushSize(ctx->Arena, size, .Alignment = 8);
+    mem_zero(ctx->table.nodes.items, size);
+    ctx->table.nodes.count = 0;
+    ctx->table.nodes.capacity = VL_BUILD_FILETIME_TABLE_SIZE;
+    ctx->table.countTimes = 0;
+    return true;
+}
 
-        // NOTE: if even a single input_path is fresher than output_path that's 100% rebuild
-        if(inputFileTime > outputFileTime) return 1;
+static void VL__FileTimeArenaFull(void)
+{
+    static bool logged = false;
+    if(logged) return;
+    logged = true;
+    VL_Log(VL_ERROR, "The stat cache is full, new paths are not cached (VL_BUILD_FILETIME_ARENA_SIZE is %zu)",
+           (size_t)VL_BUILD_FILETIME_ARENA_SIZE);
+}
+
+// Returns NULL if the path isn't cached and create is false or the arena is full
+static vl_filetime_node *VL__FileTimeGetNode(view file, bool create)
+{
+    vl_needrebuild_context *ctx = &VL_needsRebuildContext;
+    if(!VL__FileTimeInit()) return NULL;
+
+    u64 hash;
+    VL_BUILD_FILENAME_HASH(file, hash);
+    vl_filetime_node *node = &ctx->table.nodes.items[hash % VL_BUILD_FILETIME_TABLE_SIZE];
+    if(node->file.items) {
+        for(;;) {
+            if(ViewEq(node->file, file)) return node;
+            if(!node->next) break;
+            node = node->next;
+        }
+        if(!create) return NULL;
+        if(ArenaGetRemaining(ctx->Arena, .Alignment = 8) < sizeof(vl_filetime_node) + file.count + 8) {
+            VL__FileTimeArenaFull();
+            return NULL;
+        }
+        node->next = (vl_filetime_node*)PushStruct(ctx->Arena, vl_filetime_node, .Alignment = 8);
+        node = node->next;
+    } else {
+        if(!create) return NULL;
+        if(ArenaGetRemaining(ctx->Arena) < file.count + 1) {
+            VL__FileTimeArenaFull();
+            return NULL;
+        }
+        ctx->table.nodes.count++;
     }
 
-    return 0;
+    mem_zero(node, sizeof(*node));
+    node->file = ViewFromParts(Arena_strndup(ctx->Arena, file.items, file.count), file.count);
+    ctx->table.countTimes++;
+    return node;
 }
 
-VLIBPROC char *VL_GetFilePathFromCompileCtx(vl_compile_ctx *ctx)
+VLIBPROC bool VL_GetFileStatCached(const char *path, vl_file_stat *fileStat)
 {
-    char *output = temp_sprintf("%s/%s", ctx->outputDir, ctx->output);
-    AssertMsg(output || (ctx->type == Compile_Object),
-        "Output path must be specified unless compiling for object file output");
-#if OS_WINDOWS
-    if(ctx->type == Compile_Executable) {
-        output = temp_sprintf("%s.exe", output);
+    vl_filetime_node *node = VL__FileTimeGetNode(ViewFromCstr(path), true);
+    if(node && node->checked) {
+        if(!node->exists) return false;
+        fileStat->mtime = node->time;
+        fileStat->size = node->size;
+        fileStat->inode = node->inode;
+        fileStat->type = node->type;
+        return true;
     }
-#else
-    if(ctx->type == Compile_Executable) {}
-#endif
-    else if(ctx->type == Compile_Object) {
-        if(output) {
-            if(ctx->cc == CCompiler_MSVC) {
-                output = temp_sprintf("%s.obj", output);
-            } else {
-                output = temp_sprintf("%s.o", output);
-            }
+
+    bool exists = VL_GetFileStat(path, fileStat);
+    if(node) {
+        // NOTE: The content hash stays valid as long as the file looks the same
+        if(!exists || !node->exists || node->time != fileStat->mtime ||
+           node->size != fileStat->size || node->inode != fileStat->inode)
+        {
+            node->hasHash = false;
+            node->hasIncludes = false;
         }
-    } else if(ctx->type == Compile_DynamicLibrary) {
-        output = temp_sprintf("%s" VL_DLL_EXTENSION, output);
-    } else if(ctx->type == Compile_StaticLibrary) {
-        if(ctx->cc == CCompiler_MSVC) {
-            output = temp_sprintf("%s.obj", output);
-        } else {
-            output = temp_sprintf("%s.o", output);
+        node->exists = exists;
+        node->checked = true;
+        if(exists) {
+            node->time = fileStat->mtime;
+            node->size = fileStat->size;
+            node->inode = fileStat->inode;
+            node->type = fileStat->type;
         }
     }
-    return output;
+    return exists;
 }
 
-VLIBPROC int VL_Needs_C_Rebuild(vl_cmd *cmd, vl_compile_ctx *ctx)
+VLIBPROC void VL_FileTimeInvalidate(const char *path)
 {
-#if COMPILER_GCC
-    CmdAppend(cmd, "gcc", "-MM");
-#elif COMPILER_CLANG
-    CmdAppend(cmd, "clang", "-MM");
-#elif COMPILER_CL
-    CmdAppend(cmd, "cl", "/showIncludes", "/Zs", "/nologo");
-#else
-    // unimplemented
-    return -1;
-#endif
+    vl_filetime_node *node = VL__FileTimeGetNode(ViewFromCstr(path), false);
+    if(node) {
+        node->checked = false;
+        node->persisted = false;
+    }
+}
 
-    size_t iniMark = temp_save();
+VLIBPROC void VL_FileTimeInvalidateAll(void)
+{
+    vl_filetime_table *table = &VL_needsRebuildContext.table;
+    for(size_t i = 0; table->nodes.items && i < VL_BUILD_FILETIME_TABLE_SIZE; i++) {
+        for(vl_filetime_node *node = &table->nodes.items[i]; node && node->file.items; node = node->next) {
+            node->checked = false;
+            node->persisted = false;
+        }
+    }
+}
 
-    const char *output = VL_GetFilePathFromCompileCtx(ctx);
+#define VL__FILETIME_CACHE_HEADER "vl_filetime_cache 2\n"
 
-    int needsRebuildSimple = VL_NeedsRebuild_Impl(output, ctx->sourceFiles.items, ctx->sourceFiles.count);
-    if(needsRebuildSimple != 0) {
-        temp_rewind(iniMark);
-        return needsRebuildSimple;
+static bool VL__ChopU64(view *v, u64 *result)
+{
+    view number = ViewChopByDelim(v, ' ');
+    if(number.count == 0) return false;
+    *result = 0;
+    for(size_t i = 0; i < number.count; i++) {
+        if(number.items[i] < '0' || number.items[i] > '9') return false;
+        *result = *result*10 + (u64)(number.items[i] - '0');
     }
+    return true;
+}
 
-    DaAppendMany(cmd, ctx->sourceFiles.items, ctx->sourceFiles.count);
-    struct compiler_info_opts info = {
-        .cmd = cmd,
-        .cc = ctx->cc,
-    };
-    for(size_t i = 0; i < ctx->includePaths.count; i++) {
-        VL_ccIncludepath_Opt(info, ctx->includePaths.items[i]);
+static bool VL__ChopHex64(view *v, u64 *result)
+{
+    view number = ViewChopByDelim(v, ' ');
+    if(number.count == 0 || number.count > 16) return false;
+    *result = 0;
+    for(size_t i = 0; i < number.count; i++) {
+        char c = number.items[i];
+        u64 digit;
+        if(c >= '0' && c <= '9') digit = (u64)(c - '0');
+        else if(c >= 'a' && c <= 'f') digit = (u64)(c - 'a' + 10);
+        else return false;
+        *result = (*result << 4) | digit;
     }
+    return true;
+}
 
-    int result = 0;
-    vl_fd read;
-    vl_fd write;
-    if(!VL_Pipe(&read, &write)) {
-        VL_Log(VL_ERROR, "Could not create pipe for VL_Needs_C_Rebuild");
-        temp_rewind(iniMark);
-        return -1;
-    }
+VLIBPROC bool VL_FileTimeCacheLoad(const char *cache_path)
+{
+    // NOTE: Not having a cache yet is not an error
+    if(!VL_FileExists(cache_path)) return false;
 
-    vl_proc proc = VL_CmdStartProcess(*cmd, 0, &write, 0, false);
-    VL_FileClose(write);
+    string_builder sb = {0};
+    if(!SbReadEntireFile(cache_path, &sb)) return false;
 
-    char *abuf = (char*)ArenaTemp.base + ArenaTemp.used;
+    bool result = true;
+    view data = ViewFromParts(sb.items, sb.count);
+    if(!ViewChopStartsWith(&data, VIEW(VL__FILETIME_CACHE_HEADER))) {
+        VL_Log(VL_WARNING, "Ignoring file time cache '%s': unknown format", cache_path);
+        VL_ReturnDefer(false);
+    }
 
-    char buf[2048];
-    for(;;) {
-        uint32_t bytesRead;
-        if(!VL_FileRead(read, buf, (uint32_t)sizeof(buf), &bytesRead)) {
-            break;
+    while(data.count > 0) {
+        view line = ViewChopByDelim(&data, '\n');
+        // NOTE: "<content hash or -> <mtime> <size> <inode> <path>"
+        u64 time, size, inode, hash = 0;
+        bool hasHash = !ViewChopStartsWith(&line, VIEW("- "));
+        if((hasHash && !VL__ChopHex64(&line, &hash)) ||
+           !VL__ChopU64(&line, &time) || !VL__ChopU64(&line, &size) ||
+           !VL__ChopU64(&line, &inode) || line.count == 0)
+        {
+            VL_Log(VL_WARNING, "Ignoring the rest of file time cache '%s': invalid entry", cache_path);
+            VL_ReturnDefer(false);
         }
 
-        if(ArenaTemp.used + (size_t)bytesRead >= ArenaTemp.size) {
-            VL_Log(VL_ERROR, "No memory left in VL_Needs_C_Rebuild");
-            VL_ReturnDefer(-1);
+        vl_filetime_node *node = VL__FileTimeGetNode(line, true);
+        if(!node) break;
+        // NOTE: A stat from this process is newer than anything in the file
+        if(node->checked) continue;
+        node->time = time;
+        node->size = size;
+        node->inode = inode;
+        node->exists = true;
+        node->persisted = true;
+        node->hasHash = hasHash;
+        node->contentHash = hash;
+    }
+
+defer:
+    SbFree(sb);
+    return result;
+}
+
+VLIBPROC bool VL_FileTimeCacheSave(const char *cache_path)
+{
+    vl_needrebuild_context *ctx = &VL_needsRebuildContext;
+    string_builder sb = {0};
+    SbAppendCstr(&sb, VL__FILETIME_CACHE_HEADER);
+    for(size_t i = 0; ctx->table.nodes.items && i < VL_BUILD_FILETIME_TABLE_SIZE; i++) {
+        for(vl_filetime_node *node = &ctx->table.nodes.items[i]; node && node->file.items; node = node->next) {
+            if(!node->exists || !(node->checked || node->persisted)) continue;
+            if(node->hasHash) SbAppendf(&sb, "%016llx ", (unsigned long long)node->contentHash);
+            else SbAppendCstr(&sb, "- ");
+            SbAppendf(&sb, "%llu %llu %llu "VIEW_FMT"\n", (unsigned long long)node->time,
+                      (unsigned long long)node->size, (unsigned long long)node->inode, VIEW_ARG(node->file));
         }
-        mem_copy_non_overlapping(ArenaTemp.base + ArenaTemp.used, buf, bytesRead);
-        ArenaTemp.used += bytesRead;
     }
 
-    size_t callMemSize = ArenaTemp.used - iniMark;
-    view *includes;
-    size_t countIncludes = 0;
+    // NOTE: Not truncated in place, a build that stops while saving leaves the old cache
+    bool result = VL__WriteFileAtomic(cache_path, sb.items, sb.count);
+    if(!result) VL_Log(VL_ERROR, "Could not write file time cache '%s'", cache_path);
+    SbFree(sb);
+    return result;
+}
 
-#if COMPILER_GCC || COMPILER_CLANG
-    // NOTE: Full format:
-    // file1.o: file1.c <include list>
-    // file2.o: file2.c <include list>
-    // etc.
-    view data = ViewTrimRight(ViewFromParts(abuf, callMemSize));
+#define VL__XXH_PRIME1 0x9E3779B185EBCA87ULL
+#define VL__XXH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define VL__XXH_PRIME3 0x165667B19E3779F9ULL
+#define VL__XXH_PRIME4 0x85EBCA77C2B2AE63ULL
+#define VL__XXH_PRIME5 0x27D4EB2F165667C5ULL
 
-    includes = (view*)(ArenaTemp.base + ArenaTemp.used + ArenaGetAlignmentOffset(&ArenaTemp, sizeof(view)));
+static inline u64 VL__Rotl64(u64 x, int r) { return (x << r) | (x >> (64 - r)); }
 
-    ViewIterateLines(&data, lineIdx, line) {
-        (void)lineIdx;
-        // NOTE: "file.o: "
-        ViewChopByView(&line, VIEW(": "));
-        // NOTE: "file.c"
-        ViewChopByDelim(&line, ' ');
-
-        while(line.count > 0) {
-            view inc = ViewChopByDelim(&line, ' ');
-            if(inc.items[0] == '\\') {
-                /* Skip '\n' and ' ' after '\n' */
-                line = ViewChopByLine(&data);
-                line.items++;
-                line.count--;
-                continue;
-            }
-
-            if(ArenaTemp.used + sizeof(view) >= ArenaTemp.size) {
-                VL_Log(VL_ERROR, "No memory left in VL_Needs_C_Rebuild");
-                VL_ReturnDefer(-1);
-            }
-            mem_copy_non_overlapping(includes + countIncludes, &inc, sizeof(view));
-            ArenaTemp.used += sizeof(view);
-
-            countIncludes++;
-        }
-    }
+// NOTE: Assumes a little endian target, like the rest of the library
+static inline u64 VL__Read64(const u8 *p) { u64 v; memcpy(&v, p, sizeof(v)); return v; }
+static inline u32 VL__Read32(const u8 *p) { u32 v; memcpy(&v, p, sizeof(v)); return v; }
 
-#elif COMPILER_CL
-    view data = ViewFromParts(abuf, callMemSize);
-    //printf(VIEW_FMT, VIEW_ARG(data));
+static inline u64 VL__XXHRound(u64 acc, u64 input)
+{
+    acc += input*VL__XXH_PRIME2;
+    acc = VL__Rotl64(acc, 31);
+    return acc*VL__XXH_PRIME1;
+}
 
-    includes = (view*)(ArenaTemp.base + ArenaTemp.used + ArenaGetAlignmentOffset(&ArenaTemp, sizeof(view)));
+static inline u64 VL__XXHMergeRound(u64 acc, u64 val)
+{
+    acc ^= VL__XXHRound(0, val);
+    return acc*VL__XXH_PRIME1 + VL__XXH_PRIME4;
+}
 
-    ViewIterateLines(&data, lineIdx, line) {
-        (void)lineIdx;
-        if(ViewChopStartsWith(&line, VIEW("Note: including file: "))) {
-            if(ArenaTemp.used + sizeof(view) >= ArenaTemp.size) {
-                VL_Log(VL_ERROR, "No memory left in VL_Needs_C_Rebuild");
-                VL_ReturnDefer(-1);
-            }
-            // Remove spaces from the left showing include depth
-            line = ViewTrimLeft(line);
-            mem_copy_non_overlapping(includes + countIncludes, &line, sizeof(view));
-            ArenaTemp.used += sizeof(view);
+VLIBPROC void VL_HashBegin(vl_hash_state *state, u64 seed)
+{
+    state->lanes[0] = seed + VL__XXH_PRIME1 + VL__XXH_PRIME2;
+    state->lanes[1] = seed + VL__XXH_PRIME2;
+    state->lanes[2] = seed;
+    state->lanes[3] = seed - VL__XXH_PRIME1;
+    state->seed = seed;
+    state->total = 0;
+    state->tailCount = 0;
+}
 
-            countIncludes++;
-        } else {
-            // NOTE: This is a source filename, maybe it's useful to handle this later
-        }
+VLIBPROC void VL_HashUpdate(vl_hash_state *state, const void *data, size_t size)
+{
+    const u8 *p = (const u8*)data;
+    const u8 *end = p + size;
+    state->total += size;
+
+    if(state->tailCount + size < 32) {
+        memcpy(state->tail + state->tailCount, p, size);
+        state->tailCount += size;
+        return;
     }
-#endif
 
-    uint64_t outputFileTime;
-    if(!GetLastWriteTime(output, &outputFileTime)) return 1;
-
-    char path[VL_PATH_MAX+1];
-    for(size_t i = 0; i < countIncludes; i++) {
-        view inc = includes[i];
-        if(inc.count > VL_PATH_MAX) {
-            VL_Log(VL_WARNING, "Ignoring file '"VIEW_FMT"' because its path is longer than max path",
-                   VIEW_ARG(inc));
-            continue;
+    if(state->tailCount > 0) {
+        size_t fill = 32 - state->tailCount;
+        memcpy(state->tail + state->tailCount, p, fill);
+        for(int i = 0; i < 4; i++) {
+            state->lanes[i] = VL__XXHRound(state->lanes[i], VL__Read64(state->tail + i*8));
         }
+        p += fill;
+        state->tailCount = 0;
+    }
 
-        mem_copy_non_overlapping(path, inc.items, inc.count);
-        path[inc.count] = '\0';
+    for(; p + 32 <= end; p += 32) {
+        state->lanes[0] = VL__XXHRound(state->lanes[0], VL__Read64(p));
+        state->lanes[1] = VL__XXHRound(state->lanes[1], VL__Read64(p + 8));
+        state->lanes[2] = VL__XXHRound(state->lanes[2], VL__Read64(p + 16));
+        state->lanes[3] = VL__XXHRound(state->lanes[3], VL__Read64(p + 24));
+    }
 
-        u64 inputFileTime;
-        if(!VL_GetLastWriteTime(path, &inputFileTime)) VL_ReturnDefer(-1);
+    state->tailCount = (size_t)(end - p);
+    memcpy(state->tail, p, state->tailCount);
+}
 
-        // NOTE: if even a single input_path is fresher than output_path that's 100% rebuild
-        if(inputFileTime > outputFileTime) VL_ReturnDefer(1);
+VLIBPROC u64 VL_HashEnd(vl_hash_state *state)
+{
+    u64 h;
+    if(state->total >= 32) {
+        h = VL__Rotl64(state->lanes[0], 1) + VL__Rotl64(state->lanes[1], 7) +
+            VL__Rotl64(state->lanes[2], 12) + VL__Rotl64(state->lanes[3], 18);
+        for(int i = 0; i < 4; i++) h = VL__XXHMergeRound(h, state->lanes[i]);
+    } else {
+        h = state->seed + VL__XXH_PRIME5;
     }
+    h += state->total;
 
-defer:
-    if(!VL_ProcWait(proc)) {
-        VL_Log(VL_ERROR, "Could not wait for process to get includes");
-        result = -1;
+    const u8 *p = state->tail;
+    const u8 *end = p + state->tailCount;
+    for(; p + 8 <= end; p += 8) {
+        h ^= VL__XXHRound(0, VL__Read64(p));
+        h = VL__Rotl64(h, 27)*VL__XXH_PRIME1 + VL__XXH_PRIME4;
+    }
+    if(p + 4 <= end) {
+        h ^= (u64)VL__Read32(p)*VL__XXH_PRIME1;
+        h = VL__Rotl64(h, 23)*VL__XXH_PRIME2 + VL__XXH_PRIME3;
+        p += 4;
+    }
+    for(; p < end; p++) {
+        h ^= (*p)*VL__XXH_PRIME5;
+        h = VL__Rotl64(h, 11)*VL__XXH_PRIME1;
     }
 
-    VL_FileClose(read);
-
-    temp_rewind(iniMark);
+    h ^= h >> 33;
+    h *= VL__XXH_PRIME2;
+    h ^= h >> 29;
+    h *= VL__XXH_PRIME3;
+    h ^= h >> 32;
+    return h;
+}
 
-    return result;
+VLIBPROC u64 VL_HashBytes(const void *data, size_t size, u64 seed)
+{
+    vl_hash_state state;
+    VL_HashBegin(&state, seed);
+    VL_HashUpdate(&state, data, size);
+    return VL_HashEnd(&state);
 }
 
-VLIBPROC const char *VL_temp_GetCurrentDir(void)
+VLIBPROC bool VL_HashFile(const char *path, u64 *hash)
 {
-#ifdef _WIN32
-    DWORD nBufferLength = GetCurrentDirectory(0, NULL);
-    if (nBufferLength == 0) {
-        VL_Log(VL_ERROR, "could not get current directory: %s", Win32_ErrorMessage(GetLastError()));
-        return NULL;
+    vl_file_stat fileStat;
+    if(!VL_GetFileStatCached(path, &fileStat)) {
+        VL_Log(VL_ERROR, "Could not hash '%s': it does not exist", path);
+        return false;
     }
-
-    char *buffer = (char*) temp_alloc(nBufferLength, .Alignment = 1);
-    if (GetCurrentDirectory(nBufferLength, buffer) == 0) {
-        VL_Log(VL_ERROR, "could not get current directory: %s", Win32_ErrorMessage(GetLastError()));
-        return NULL;
+    vl_filetime_node *node = VL__FileTimeGetNode(ViewFromCstr(path), false);
+    if(node && node->hasHash) {
+        *hash = node->contentHash;
+        return true;
     }
 
-    return buffer;
-#else
-    char *buffer = (char*) temp_alloc(PATH_MAX, .Alignment = 1);
-    if (getcwd(buffer, PATH_MAX) == NULL) {
-        VL_Log(VL_ERROR, "could not get current directory: %s", strerror(errno));
-        return NULL;
+    size_t mark = temp_save();
+    vl_file_chunk chunk = {0};
+    chunk.BufferSize = VL_HASH_FILE_CHUNK_SIZE;
+    chunk.Buffer = (u8*)temp_alloc(VL_HASH_FILE_CHUNK_SIZE, .Alignment = 8);
+
+    vl_hash_state state;
+    VL_HashBegin(&state, 0);
+    u32 chunkSize;
+    while(ReadFileChunk(&chunk, path, &chunkSize)) {
+        VL_HashUpdate(&state, chunk.Buffer, chunkSize);
+    }
+    temp_rewind(mark);
+    if(VL_ErrorNumber != 0) {
+        VL_Log(VL_ERROR, "Could not hash '%s': %s", path, VL_GetError());
+        return false;
     }
 
-    return buffer;
-#endif // _WIN32
+    *hash = VL_HashEnd(&state);
+    if(node) {
+        node->contentHash = *hash;
+        node->hasHash = true;
+    }
+    return true;
 }
 
-struct vl__pushd_buf_type VL__pushDirectoryBuffer;
+#define VL__BUILD_DB_HEADER "vl_build_db 1\n"
 
-VLIBPROC bool VL_Pushd(const char *path)
+static bool VL__BuildDbLoad(void);
+
+static bool VL__BuildDbInit(void)
 {
-    static bool initialized = false;
-    if(!initialized) {
-        initialized = true;
-        VL__pushDirectoryBuffer.items[0] = temp_strdup(VL_temp_GetCurrentDir());
-        VL__pushDirectoryBuffer.count = 1;
+    vl_needrebuild_context *ctx = &VL_needsRebuildContext;
+    if(!ctx->buildDb.buckets) {
+        if(!VL__FileTimeInit()) return false;
+        size_t size = VL_BUILD_FILETIME_TABLE_SIZE*sizeof(vl_build_db_entry*);
+        if(ArenaGetRemaining(ctx->Arena, .Alignment = 8) < size) return false;
+        ctx->buildDb.buckets = (vl_build_db_entry**)ArenaPushSize(ctx->Arena, size, .Alignment = 8);
+        mem_zero(ctx->buildDb.buckets, size);
     }
-
-    AssertMsgAlways((VL__pushDirectoryBuffer.count+1) < VL_PUSHD_BUF_MAX, "Increase the size of the pushd buffer (VL_PUSHD_BUF_MAX)");
-    bool ok = VL_SetCurrentDir(path);
-    if(ok) {
-        VL__pushDirectoryBuffer.items[VL__pushDirectoryBuffer.count] =
-            temp_sprintf("%s/%s", VL__pushDirectoryBuffer.items[VL__pushDirectoryBuffer.count - 1], path);
-        VL__pushDirectoryBuffer.count++;
-    } else {
-#if defined(_WIN32)
-        VL_Log(VL_ERROR, "could not set current directory to %s: %s", path, Win32_ErrorMessage(GetLastError()));
-#else
-        VL_Log(VL_ERROR, "could not set current directory to %s: %s", path, strerror(errno));
-#endif
+    if(ctx->buildDbPath && !ctx->buildDb.loaded) {
+        ctx->buildDb.loaded = true;
+        VL__BuildDbLoad();
     }
-    return ok;
+    return true;
 }
 
-VLIBPROC bool VL_Popd(void)
+static void *VL__FileTimePush(size_t size)
 {
-    AssertMsg(VL__pushDirectoryBuffer.count > 1, "Need to do pushd before popd");
-    const char *path = VL__pushDirectoryBuffer.items[VL__pushDirectoryBuffer.count - 2];
-    bool ok = VL_SetCurrentDir(path);
-    if(ok) VL__pushDirectoryBuffer.count--;
-    else {
-#if defined(_WIN32)
-        VL_Log(VL_ERROR, "could not set current directory to %s: %s", path, Win32_ErrorMessage(GetLastError()));
-#else
-        VL_Log(VL_ERROR, "could not set current directory to %s: %s", path, strerror(errno));
-#endif
+    memory_arena *arena = VL_needsRebuildContext.Arena;
+    if(ArenaGetRemaining(arena, .Alignment = 8) < size) {
+        VL__FileTimeArenaFull();
+        return NULL;
     }
-    return ok;
+    return ArenaPushSize(arena, size, .Alignment = 8);
 }
 
-VLIBPROC char *VL_temp_DirName(const char *path)
+/* The inputs with their paths after them in one heap block, freed with VL_FREE. Records replace them
+   so they don't go in the arena, a long running watch or daemon records the same outputs over and over */
+static vl_build_db_input *VL__BuildDbInputsAlloc(const view *paths, size_t count)
 {
-#ifndef _WIN32
-    // Stolen from the musl's implementation of dirname.
-    // We are implementing our own one because libc vendors cannot agree on whether dirname(3)
-    // modifies the path or not.
-    if(!path || !*path) return temp_strndup(".", 1);
-    size_t i = strlen(path) - 1;
-    for(; path[i] == '/'; i--) if(!i) return temp_strndup("/", 1);
-    for(; path[i] != '/'; i--) if(!i) return temp_strndup(".", 1);
-    for(; path[i] == '/'; i--) if(!i) return temp_strndup("/", 1);
-    return temp_strndup(path, i + 1);
-#else
-    if(!path) path = ""; // Treating NULL as empty.
-    char *drive = temp_alloc(_MAX_DRIVE, .Alignment = 1);
-    char *dir   = temp_alloc(_MAX_DIR, .Alignment = 1);
-    // https://learn.microsoft.com/en-us/previous-versions/visualstudio/visual-studio-2010/8e46eyt7(v=vs.100)
-    errno_t ret = _splitpath_s(path, drive, _MAX_DRIVE, dir, _MAX_DIR, NULL, 0, NULL, 0);
-    Assert(ret == 0);
-    return temp_sprintf("%s%s", drive, dir);
-#endif // _WIN32
+    size_t size = count*sizeof(vl_build_db_input) + 1;
+    for(size_t i = 0; i < count; i++) size += paths[i].count + 1;
+    vl_build_db_input *inputs = (vl_build_db_input*)VL_REALLOC(NULL, size);
+    Assert(inputs && "Buy more RAM lol");
+    char *at = (char*)(inputs + count);
+    for(size_t i = 0; i < count; i++) {
+        memcpy(at, paths[i].items, paths[i].count);
+        at[paths[i].count] = '\0';
+        inputs[i].path = ViewFromParts(at, paths[i].count);
+        inputs[i].hash = 0;
+        at += paths[i].count + 1;
+    }
+    return inputs;
 }
 
-VLIBPROC char *VL_temp_FileName(const char *path)
+static void VL__BuildDbSetInputs(vl_build_db_entry *entry, vl_build_db_input *inputs, size_t count)
 {
-#ifndef _WIN32
-    // Stolen from the musl's implementation of dirname.
-    // We are implementing our own one because libc vendors cannot agree on whether basename(3)
-    // modifies the path or not.
-    if(!path || !*path) return temp_strndup(".", 1);
-    size_t i = strlen(path)-1;
-    char *s = temp_strndup(path, i);
-    for(; i&&s[i]=='/'; i--) s[i] = 0;
-    for(; i&&s[i-1]!='/'; i--);
-    return s+i;
-#else
-    if(!path) path = ""; // Treating NULL as empty.
-    char *fname = temp_alloc(_MAX_FNAME, .Alignment = 1);
-    char *ext = temp_alloc(_MAX_EXT, .Alignment = 1);
-    // https://learn.microsoft.com/en-us/previous-versions/visualstudio/visual-studio-2010/8e46eyt7(v=vs.100)
-    errno_t ret = _splitpath_s(path, NULL, 0, NULL, 0, fname, _MAX_FNAME, ext, _MAX_EXT);
-    Assert(ret == 0);
-    return temp_sprintf("%s%s", fname, ext);
-#endif // _WIN32
+    if(entry->pending && entry->pending != entry->inputs) VL_FREE(entry->pending);
+    if(entry->inputs) VL_FREE(entry->inputs);
+    entry->pending = 0;
+    entry->pendingCount = 0;
+    entry->inputs = inputs;
+    entry->inputCount = count;
 }
 
-VLIBPROC char *VL_temp_FileExt(const char *path)
+static view VL__FileTimePushView(view v)
 {
-#ifndef _WIN32
-    return strrchr(VL_temp_FileName(path), '.');
-#else
-    if(!path) path = ""; // Treating NULL as empty.
-    char *ext = temp_alloc(_MAX_EXT, .Alignment = 1);
-    // https://learn.microsoft.com/en-us/previous-versions/visualstudio/visual-studio-2010/8e46eyt7(v=vs.100)
-    errno_t ret = _splitpath_s(path, NULL, 0, NULL, 0, NULL, 0, ext, _MAX_EXT);
-    Assert(ret == 0);
-    return ext;
-#endif // _WIN32
+    char *s = (char*)VL__FileTimePush(v.count + 1);
+    if(!s) return ViewFromParts(0, 0);
+    memcpy(s, v.items, v.count);
+    s[v.count] = '\0';
+    return ViewFromParts(s, v.count);
 }
 
-VLIBPROC char *VL_temp_RunningExecutablePath(void)
+static vl_build_db_entry *VL__BuildDbGetEntry(view output, bool create)
 {
-#if defined(__linux__)
-    char buf[4096];
-    int length = readlink("/proc/self/exe", buf, ArrayLen(buf));
-    if(length < 0) return temp_strndup("", 0);
-    return temp_strndup(buf, length);
-#elif defined(_WIN32)
-    char buf[MAX_PATH];
-    int length = GetModuleFileNameA(NULL, buf, MAX_PATH);
-    return temp_strndup(buf, length);
-#elif defined(__APPLE__)
-    char buf[4096];
-    uint32_t size = ArrayLen(buf);
-    if(_NSGetExecutablePath(buf, &size) != 0) return temp_strndup("", 0);
-    int length = strlen(buf);
-    return temp_strndup(buf, length);
-#elif defined(__FreeBSD__)
-    char buf[4096];
-    int mib[4] = { CTL_KERN, KERN_PROC, KERN_PROC_PATHNAME, -1 };
-    size_t length = sizeof(buf);
-    if(sysctl(mib, 4, buf, &length, NULL, 0) < 0) return temp_strndup("", 0);
-    return temp_strndup(buf, length);
-#elif defined(__HAIKU__)
-    int cookie = 0;
-    image_info info;
-    while(get_next_image_info(B_CURRENT_TEAM, &cookie, &info) == B_OK) {
-        if(info.type == B_APP_IMAGE) break;
+    vl_needrebuild_context *ctx = &VL_needsRebuildContext;
+    if(!VL__BuildDbInit()) return NULL;
+
+    u64 hash;
+    VL_BUILD_FILENAME_HASH(output, hash);
+    vl_build_db_entry **slot = &ctx->buildDb.buckets[hash % VL_BUILD_FILETIME_TABLE_SIZE];
+    for(; *slot; slot = &(*slot)->next) {
+        if(ViewEq((*slot)->output, output)) return *slot;
     }
-    return temp_strdup(info.name);
-#else
-    fprintf(stderr, LOC_STR": TODO: %s is not implemented for this platform\n", __FUNCTION__);
-    return temp_strndup("", 0);
-#endif
+    if(!create) return NULL;
+
+    vl_build_db_entry *entry = (vl_build_db_entry*)VL__FileTimePush(sizeof(vl_build_db_entry));
+    if(!entry) return NULL;
+    mem_zero(entry, sizeof(*entry));
+    entry->output = VL__FileTimePushView(output);
+    if(!entry->output.items) return NULL;
+    *slot = entry;
+    ctx->buildDb.countEntries++;
+    return entry;
 }
 
-VLIBPROC void VL_cc_Opt(struct compiler_info_opts opt)
+static bool VL__BuildDbLoad(void)
 {
-    switch(opt.cc) {
-        case CCompiler_GCC: {
-            CmdAppend(opt.cmd, "cc");
-        } break;
-        case CCompiler_Clang: {
-            CmdAppend(opt.cmd, "clang");
-        } break;
-        case CCompiler_MSVC: {
-            CmdAppend(opt.cmd, "cl.exe");
-        } break;
-        case CCompiler_TCC: {
-            CmdAppend(opt.cmd, "tcc");
-        } break;
+    vl_needrebuild_context *ctx = &VL_needsRebuildContext;
+    const char *path = ctx->buildDbPath;
+    if(!VL_FileExists(path)) return true;
+
+    string_builder sb = {0};
+    if(!SbReadEntireFile(path, &sb)) return false;
+
+    bool result = true;
+    struct { view *items; size_t count; size_t capacity; } paths = {0};
+    struct { u64 *items; size_t count; size_t capacity; } hashes = {0};
+    view data = ViewFromParts(sb.items, sb.count);
+    if(!ViewChopStartsWith(&data, VIEW(VL__BUILD_DB_HEADER))) {
+        VL_Log(VL_WARNING, "Ignoring build database '%s': unknown format", path);
+        VL_ReturnDefer(false);
     }
-}
 
-VLIBPROC void VL_ccWarnings_Opt(struct compiler_info_opts opt)
-{
-    switch(opt.cc) {
-        case CCompiler_GCC:
-        case CCompiler_TCC:
-        case CCompiler_Clang: {
-            CmdAppend(opt.cmd, "-Wall", "-Wextra");
-        } break;
-        case CCompiler_MSVC: {
-            CmdAppend(opt.cmd, "-W4", "-nologo", "-D_CRT_SECURE_NO_WARNINGS");
-        } break;
+    // NOTE: Records are appended, the last one of each output wins
+    while(data.count > 0) {
+        // "o <command hash> <input count> <output>" followed by "i <hash> <input>" lines
+        view line = ViewChopByDelim(&data, '\n');
+        u64 commandHash, inputCount;
+        if(!ViewChopStartsWith(&line, VIEW("o ")) || !VL__ChopHex64(&line, &commandHash) ||
+           !VL__ChopU64(&line, &inputCount) || line.count == 0)
+        {
+            VL_Log(VL_WARNING, "Ignoring the rest of build database '%s': invalid record", path);
+            VL_ReturnDefer(false);
+        }
+
+        vl_build_db_entry *entry = VL__BuildDbGetEntry(line, true);
+        paths.count = 0;
+        hashes.count = 0;
+        for(u64 i = 0; i < inputCount; i++) {
+            line = ViewChopByDelim(&data, '\n');
+            u64 hash;
+            if(!ViewChopStartsWith(&line, VIEW("i ")) || !VL__ChopHex64(&line, &hash) || line.count == 0) {
+                VL_Log(VL_WARNING, "Ignoring the rest of build database '%s': invalid record", path);
+                if(entry) entry->recorded = false;
+                VL_ReturnDefer(false);
+            }
+            DaAppend(&paths, line);
+            DaAppend(&hashes, hash);
+        }
+        ctx->buildDb.countRecords++;
+
+        if(entry) {
+            vl_build_db_input *inputs = VL__BuildDbInputsAlloc(paths.items, paths.count);
+            for(size_t i = 0; i < hashes.count; i++) inputs[i].hash = hashes.items[i];
+            VL__BuildDbSetInputs(entry, inputs, paths.count);
+            entry->recorded = true;
+            entry->commandHash = commandHash;
+        }
     }
-}
 
-VLIBPROC void VL_ccWarningsAsErrors_Opt(struct compiler_info_opts opt)
-{
-    switch(opt.cc) {
-        case CCompiler_GCC:
-        case CCompiler_TCC:
-        case CCompiler_Clang: {
-            CmdAppend(opt.cmd, "-Werror");
-        } break;
-        case CCompiler_MSVC: {
-            CmdAppend(opt.cmd, "-WX");
-        } break;
+    if(ctx->buildDb.countRecords > 2*ctx->buildDb.countEntries + 64) {
+        result = VL_BuildDbSave();
     }
+
+defer:
+    DaFree(paths);
+    DaFree(hashes);
+    SbFree(sb);
+    return result;
 }
 
-VLIBPROC void VL_ccOutput_Opt(struct compiler_info_opts opt, const char *output)
+static void VL__BuildDbAppendEntry(string_builder *sb, vl_build_db_entry *entry)
 {
-    Assert(output);
-    switch(opt.cc) {
-        case CCompiler_GCC:
-        case CCompiler_TCC:
-        case CCompiler_Clang: {
-            CmdAppend(opt.cmd, "-o", output);
-        } break;
-        case CCompiler_MSVC: {
-            CmdAppend(opt.cmd, temp_sprintf("/Fe:%s", output));
-        } break;
+    SbAppendf(sb, "o %016llx %zu "VIEW_FMT"\n", (unsigned long long)entry->commandHash,
+              entry->inputCount, VIEW_ARG(entry->output));
+    for(size_t i = 0; i < entry->inputCount; i++) {
+        SbAppendf(sb, "i %016llx "VIEW_FMT"\n", (unsigned long long)entry->inputs[i].hash,
+                  VIEW_ARG(entry->inputs[i].path));
     }
 }
 
-VLIBPROC void VL_ccDebug_Opt(struct compiler_info_opts opt)
+VLIBPROC bool VL_BuildDbSave(void)
 {
-    switch(opt.cc) {
-        case CCompiler_GCC:
-        case CCompiler_TCC:
-        case CCompiler_Clang: {
-            CmdAppend(opt.cmd, "-g");
-        } break;
-        case CCompiler_MSVC: {
-            CmdAppend(opt.cmd, "-Zi");
-        } break;
+    vl_needrebuild_context *ctx = &VL_needsRebuildContext;
+    if(!ctx->buildDbPath || !ctx->buildDb.buckets) return true;
+
+    string_builder sb = {0};
+    SbAppendCstr(&sb, VL__BUILD_DB_HEADER);
+    uint32_t countRecords = 0;
+    for(size_t i = 0; i < VL_BUILD_FILETIME_TABLE_SIZE; i++) {
+        for(vl_build_db_entry *entry = ctx->buildDb.buckets[i]; entry; entry = entry->next) {
+            if(!entry->recorded) continue;
+            VL__BuildDbAppendEntry(&sb, entry);
+            countRecords++;
+        }
     }
+
+    // NOTE: Not truncated in place, a build that stops while saving leaves the old database
+    bool result = VL__WriteFileAtomic(ctx->buildDbPath, sb.items, sb.count);
+    if(result) ctx->buildDb.countRecords = countRecords;
+    else VL_Log(VL_ERROR, "Could not write build database '%s'", ctx->buildDbPath);
+    SbFree(sb);
+    return result;
 }
 
-VLIBPROC void VL_ccLib_Opt(struct compiler_info_opts opt, const char *lib)
+VLIBPROC int VL_NeedsRebuildHashed(const char *output_path, u64 commandHash, const char **input_paths, size_t input_paths_count)
 {
-#if OS_WINDOWS
-    if(opt.cc == CCompiler_MSVC && !opt.cmd->msvc_linkflags) {
-        CmdAppend(opt.cmd, "/link");
-        opt.cmd->msvc_linkflags = true;
+    vl_file_stat outputStat;
+    if(!VL_GetFileStat(output_path, &outputStat)) return 1;
+
+    vl_build_db_entry *entry = VL__BuildDbGetEntry(ViewFromCstr(output_path), false);
+    if(!entry || !entry->recorded) return 1;
+    if(entry->commandHash != commandHash) return 1;
+    if(entry->inputCount != input_paths_count) return 1;
+
+    for(size_t i = 0; i < input_paths_count; i++) {
+        view path = ViewFromCstr(input_paths[i]);
+        vl_build_db_input *recorded = 0;
+        // NOTE: The inputs usually come in the same order
+        if(ViewEq(entry->inputs[i].path, path)) {
+            recorded = &entry->inputs[i];
+        } else {
+            for(size_t j = 0; j < entry->inputCount; j++) {
+                if(ViewEq(entry->inputs[j].path, path)) recorded = &entry->inputs[j];
+            }
+        }
+        if(!recorded) return 1;
+
+        u64 hash;
+        if(!VL_HashFile(input_paths[i], &hash)) return -1;
+        if(hash != recorded->hash) return 1;
     }
-#endif
 
-    switch(opt.cc) {
-        case CCompiler_GCC:
-        case CCompiler_TCC:
-        case CCompiler_Clang: {
-            CmdAppend(opt.cmd, "-l", lib);
-        } break;
-        case CCompiler_MSVC: {
-            CmdAppend(opt.cmd, temp_sprintf("%s.lib", lib));
-        } break;
+    return 0;
+}
+
+VLIBPROC bool VL_BuildDbRecord(const char *output_path, u64 commandHash, const char **input_paths, size_t input_paths_count)
+{
+    vl_needrebuild_context *ctx = &VL_needsRebuildContext;
+    vl_build_db_entry *entry = VL__BuildDbGetEntry(ViewFromCstr(output_path), true);
+    if(!entry) {
+        VL_Log(VL_WARNING, "Build database is full, '%s' will be rebuilt next time", output_path);
+        return false;
+    }
+
+    size_t mark = temp_save();
+    view *paths = (view*)temp_alloc(input_paths_count*sizeof(view) + 1, .Alignment = 8);
+    for(size_t i = 0; i < input_paths_count; i++) paths[i] = ViewFromCstr(input_paths[i]);
+    vl_build_db_input *inputs = VL__BuildDbInputsAlloc(paths, input_paths_count);
+    temp_rewind(mark);
+    for(size_t i = 0; i < input_paths_count; i++) {
+        if(!VL_HashFile(input_paths[i], &inputs[i].hash)) {
+            VL_FREE(inputs);
+            entry->recorded = false;
+            return false;
+        }
+    }
+    // NOTE: input_paths can be the pending inputs, which are freed here
+    VL__BuildDbSetInputs(entry, inputs, input_paths_count);
+    entry->commandHash = commandHash;
+    entry->recorded = true;
+
+    if(ctx->buildDbPath) {
+        bool isNew = !VL_FileExists(ctx->buildDbPath);
+        FILE *f = fopen(ctx->buildDbPath, "ab");
+        if(!f) {
+            VL_Log(VL_ERROR, "Could not open build database '%s': %s", ctx->buildDbPath, strerror(errno));
+            return false;
+        }
+        string_builder sb = {0};
+        if(isNew) SbAppendCstr(&sb, VL__BUILD_DB_HEADER);
+        VL__BuildDbAppendEntry(&sb, entry);
+        bool ok = fwrite(sb.items, 1, sb.count, f) == sb.count;
+        ok = (fclose(f) == 0) && ok;
+        SbFree(sb);
+        if(!ok) {
+            VL_Log(VL_ERROR, "Could not write build database '%s'", ctx->buildDbPath);
+            return false;
+        }
+        ctx->buildDb.countRecords++;
     }
+    return true;
 }
 
-VLIBPROC void VL_ccIncludepath_Opt(struct compiler_info_opts opt, const char *includepath)
+static u64 VL__CmdHash(vl_cmd *cmd, size_t start)
 {
-    CmdAppend(opt.cmd, "-I", includepath);
+    vl_hash_state state;
+    VL_HashBegin(&state, 0);
+    for(size_t i = start; i < cmd->count; i++) {
+        // NOTE: Includes the null terminator so arguments can't run into each other
+        VL_HashUpdate(&state, cmd->items[i], strlen(cmd->items[i]) + 1);
+    }
+    return VL_HashEnd(&state);
 }
 
-VLIBPROC void VL_ccLibpath_Opt(struct compiler_info_opts opt, const char *libpath)
+static int VL__NeedsRebuildMtime(const char *output_path, const char **input_paths, size_t input_paths_count)
+{
+    // NOTE: The output is not cached, the build is what changes it
+    vl_file_stat outputStat;
+    if(!VL_GetFileStat(output_path, &outputStat)) return 1;
+
+    for(size_t i = 0; i < input_paths_count; ++i) {
+        const char *input_path = input_paths[i];
+        vl_file_stat inputStat;
+        if(!VL_GetFileStatCached(input_path, &inputStat)) {
+            VL_Log(VL_ERROR, "Could not get filetime of '%s'", input_path);
+            return -1;
+        }
+
+        // NOTE: if even a single input_path is fresher than output_path that's 100% rebuild
+        if(inputStat.mtime > outputStat.mtime) return 1;
+    }
+
+    return 0;
+}
+
+VLIBPROC int VL_NeedsRebuild_Impl(const char *output_path, const char **input_paths, size_t input_paths_count)
+{
+    size_t traceEvent = VL_TraceBegin("check", output_path);
+    int result = VL__NeedsRebuildMtime(output_path, input_paths, input_paths_count);
+    VL_TraceEnd(traceEvent);
+    return result;
+}
+
+VLIBPROC char *VL_GetFilePathFromCompileCtx(vl_compile_ctx *ctx)
 {
+    char *output = temp_sprintf("%s/%s", ctx->outputDir, ctx->output);
+    AssertMsg(output || (ctx->type == Compile_Object),
+        "Output path must be specified unless compiling for object file output");
 #if OS_WINDOWS
-    if(opt.cc == CCompiler_MSVC && !opt.cmd->msvc_linkflags) {
-        CmdAppend(opt.cmd, "/link");
-        opt.cmd->msvc_linkflags = true;
+    if(ctx->type == Compile_Executable) {
+        output = temp_sprintf("%s.exe", output);
     }
+#else
+    if(ctx->type == Compile_Executable) {}
 #endif
-
-    switch(opt.cc) {
-        case CCompiler_GCC:
-        case CCompiler_TCC:
-        case CCompiler_Clang: {
-            CmdAppend(opt.cmd, "-L", libpath);
-        } break;
-        case CCompiler_MSVC: {
-            CmdAppend(opt.cmd, temp_sprintf("/libpath:%s", libpath));
-        } break;
+    else if(ctx->type == Compile_Object) {
+        if(output) {
+            if(ctx->cc == CCompiler_MSVC) {
+                output = temp_sprintf("%s.obj", output);
+            } else {
+                output = temp_sprintf("%s.o", output);
+            }
+        }
+    } else if(ctx->type == Compile_DynamicLibrary) {
+        output = temp_sprintf("%s" VL_DLL_EXTENSION, output);
+    } else if(ctx->type == Compile_StaticLibrary) {
+        if(ctx->cc == CCompiler_MSVC) {
+            output = temp_sprintf("%s.obj", output);
+        } else {
+            output = temp_sprintf("%s.o", output);
+        }
+    } else if(ctx->type == Compile_PrecompiledHeader) {
+        if(ctx->cc == CCompiler_MSVC) {
+            output = temp_sprintf("%s.pch", output);
+        } else if(ctx->cc == CCompiler_Clang) {
+            output = temp_sprintf("%s.h.pch", output);
+        } else {
+            output = temp_sprintf("%s.h.gch", output);
+        }
     }
+    return output;
 }
 
-VLIBPROC bool VL_CCompile_Opt(vl_compile_ctx *ctx, vl_cmd_opts opt)
+VLIBPROC char *VL_GetDepFilePathFromCompileCtx(vl_compile_ctx *ctx)
 {
-    struct compiler_info_opts info = {
-        .cmd = opt.cmd,
-        .cc = ctx->cc,
-    };
+    return temp_sprintf("%s.d", VL_GetFilePathFromCompileCtx(ctx));
+}
 
-    if(!ctx->outputDir) {
-        ctx->outputDir = ".";
+static const char *VL__StaticLibPath(vl_compile_ctx *ctx)
+{
+    if(ctx->cc == CCompiler_MSVC) return temp_sprintf("%s/%s.lib", ctx->outputDir, ctx->output);
+    return temp_sprintf("%s/lib%s.a", ctx->outputDir, ctx->output);
+}
+
+static void VL__SbAppendSlashPath(string_builder *sb, const char *path)
+{
+    for(const char *c = path; *c; c++) DaAppend(sb, *c == '\\' ? '/' : *c);
+}
+
+// Appends path for an #include in a file of outputDir: from cwd unless it's absolute, with '/'
+static void VL__SbAppendIncludePath(string_builder *sb, const char *cwd, const char *path)
+{
+    bool absolute = path[0] == '/' || path[0] == '\\' || (path[0] != '\0' && path[1] == ':');
+    if(!absolute && cwd) {
+        VL__SbAppendSlashPath(sb, cwd);
+        DaAppend(sb, '/');
+        if(path[0] == '.' && (path[1] == '/' || path[1] == '\\')) path += 2;
     }
-    const char *output = VL_GetFilePathFromCompileCtx(ctx);
-    VL_cc_Opt(info);
+    VL__SbAppendSlashPath(sb, path);
+}
 
-    // compile only, don't link
-    if((ctx->type == Compile_StaticLibrary) ||
-       (ctx->type == Compile_Object))
+/* Generated sources are only written when their contents change, so their mtime says when that was.
+   A compile running at the same time never reads one half written */
+static bool VL__WriteFileIfChanged(const char *path, string_builder *sb)
+{
+    string_builder old = {0};
+    bool result = true;
+    if(!VL_FileExists(path) || !SbReadEntireFile(path, &old) ||
+       old.count != sb->count || memcmp(old.items, sb->items, sb->count) != 0)
     {
-        CmdAppend(opt.cmd, "-c");
+        result = VL__WriteFileAtomic(path, sb->items, sb->count);
+        if(!result) VL_Log(VL_ERROR, "Could not write %s: %s", path, VL_GetError());
+        VL_FileTimeInvalidate(path);
     }
+    SbFree(old);
+    return result;
+}
 
-    DaAppendMany(opt.cmd, ctx->sourceFiles.items, ctx->sourceFiles.count);
-    /* If compiling for an object, output file path is autoassigned by compiler unless specified */
-    if(output) {
-        if(((ctx->type == Compile_Object) || (ctx->type == Compile_StaticLibrary)) && (ctx->cc == CCompiler_MSVC))
+static const char *VL__isaMarch[] = {"", "-march=x86-64", "-march=x86-64-v2", "-march=x86-64-v3",
+                                     "-march=x86-64-v4", "-march=armv8.2-a"};
+
+// For "-fuse-ld=", from Linker_Mold
+static const char *VL__linkerNames[] = {"mold", "lld", "gold"};
+#if OS_WINDOWS
+static const char *VL__linkerPrograms[] = {"ld.mold", "lld-link", "ld.gold"};
+#else
+static const char *VL__linkerPrograms[] = {"ld.mold", "ld.lld", "ld.gold"};
+#endif
+
+#define VL__TOOLCHAIN_HEADER "vl_toolchain 1\n"
+
+// NOTE: The values of vl_c_compiler depend on the compiler vl_build.h is built with, the cache has names
+static const char *VL__ToolchainName(vl_c_compiler cc)
+{
+    switch(cc) {
+        case CCompiler_GCC: return "gcc";
+        case CCompiler_Clang: return "clang";
+        case CCompiler_MSVC: return "msvc";
+        case CCompiler_TCC: return "tcc";
+    }
+    return "";
+}
+
+static void VL__ToolchainFree(vl_toolchain *tc)
+{
+    VL_FREE((char*)tc->path);
+    VL_FREE((char*)tc->version);
+    VL_FREE((char*)tc->target);
+    mem_zero(tc, sizeof(*tc));
+}
+
+static void VL__ToolchainLoad(const char *cachePath)
+{
+    // NOTE: Not having a cache yet is not an error
+    if(!*cachePath || !VL_FileExists(cachePath)) return;
+    string_builder sb = {0};
+    if(!SbReadEntireFile(cachePath, &sb)) return;
+
+    view data = ViewFromParts(sb.items, sb.count);
+    if(!ViewChopStartsWith(&data, VIEW(VL__TOOLCHAIN_HEADER))) {
+        VL_Log(VL_WARNING, "Ignoring toolchain cache '%s': unknown format", cachePath);
+        data.count = 0;
+    }
+    while(data.count > 0) {
+        // NOTE: "<compiler> <mtime> <size> <features> <isas> <linkers> <target>\n<path>\n<version>\n"
+        view line = ViewChopByDelim(&data, '\n');
+        view path = ViewChopByDelim(&data, '\n');
+        view version = ViewChopByDelim(&data, '\n');
+        view name = ViewChopByDelim(&line, ' ');
+        u64 mtime, size, features, isas, linkers;
+        if(!VL__ChopU64(&line, &mtime) || !VL__ChopU64(&line, &size) || !VL__ChopU64(&line, &features) ||
+           !VL__ChopU64(&line, &isas) || !VL__ChopU64(&line, &linkers) || path.count == 0)
         {
-            CmdAppend(opt.cmd, temp_sprintf("-Fo:%s", output));
+            VL_Log(VL_WARNING, "Ignoring the rest of toolchain cache '%s': invalid entry", cachePath);
+            break;
+        }
+        for(size_t cc = 0; cc < ArrayLen(VL_toolchains.compilers); cc++) {
+            if(!ViewEq(name, ViewFromCstr(VL__ToolchainName((vl_c_compiler)cc)))) continue;
+            vl_toolchain *tc = &VL_toolchains.compilers[cc];
+            VL__ToolchainFree(tc);
+            tc->path = VL__HeapStrndup(path.items, path.count);
+            tc->mtime = mtime;
+            tc->size = size;
+            tc->version = VL__HeapStrndup(version.items, version.count);
+            tc->target = VL__HeapStrndup(line.items, line.count);
+            tc->features = (unsigned)features;
+            tc->isas = (unsigned)isas;
+            tc->linkers = (unsigned)linkers;
+            VL_toolchains.state[cc] = 3;
+        }
+    }
+    SbFree(sb);
+}
+
+static bool VL__ToolchainSave(const char *cachePath)
+{
+    string_builder sb = {0};
+    SbAppendCstr(&sb, VL__TOOLCHAIN_HEADER);
+    for(size_t cc = 0; cc < ArrayLen(VL_toolchains.compilers); cc++) {
+        if(VL_toolchains.state[cc] != 1 && VL_toolchains.state[cc] != 3) continue;
+        vl_toolchain *tc = &VL_toolchains.compilers[cc];
+        SbAppendf(&sb, "%s %llu %llu %u %u %u %s\n%s\n%s\n", VL__ToolchainName((vl_c_compiler)cc),
+                  (unsigned long long)tc->mtime, (unsigned long long)tc->size, tc->features, tc->isas,
+                  tc->linkers, tc->target, tc->path, tc->version);
+    }
+    // NOTE: Builds running at the same time probe and save it too
+    bool result = VL__WriteFileAtomic(cachePath, sb.items, sb.count);
+    if(!result) VL_Log(VL_ERROR, "Could not write toolchain cache '%s'", cachePath);
+    SbFree(sb);
+    return result;
+}
+
+// The first line of the file, trimmed and on the heap, "" if there's none
+static char *VL__ToolchainReadLine(const char *path)
+{
+    string_builder sb = {0};
+    if(VL_FileExists(path)) SbReadEntireFile(path, &sb);
+    view data = ViewFromParts(sb.items, sb.count);
+    view line = ViewTrim(ViewChopByDelim(&data, '\n'));
+    char *result = VL__HeapStrndup(line.count ? line.items : "", line.count);
+    SbFree(sb);
+    return result;
+}
+
+typedef struct {
+    vl_proc proc;
+    unsigned *flags; /* bit is set in it when the probe succeeds */
+    unsigned bit;
+} vl__toolchain_probe;
+
+typedef struct {
+    vl__toolchain_probe *items;
+    size_t count;
+    size_t capacity;
+    size_t waited; /* the probes before it are done */
+    size_t maxProcs;
+} vl__toolchain_probes;
+
+// Waits for the oldest probe still running
+static void VL__ToolchainProbeWait(vl__toolchain_probes *probes)
+{
+    vl__toolchain_probe *probe = &probes->items[probes->waited++];
+    bool ok = (probe->proc != VL_INVALID_PROC) && VL_ProcWait(probe->proc);
+    if(ok && probe->flags) *probe->flags |= probe->bit;
+}
+
+// NOTE: At most maxProcs probes run at once
+static void VL__ToolchainProbeStart(vl__toolchain_probes *probes, vl_cmd *cmd, const char *stdoutPath,
+                                    const char *stderrPath, unsigned *flags, unsigned bit)
+{
+    while(probes->count - probes->waited >= probes->maxProcs) VL__ToolchainProbeWait(probes);
+    vl_procs procs = {0};
+    vl__toolchain_probe probe = {.proc = VL_INVALID_PROC, .flags = flags, .bit = bit};
+    if(CmdRun(cmd, .async = &procs, .stdoutPath = stdoutPath ? stdoutPath : "/dev/null",
+              .stderrPath = stderrPath ? stderrPath : "/dev/null"))
+    {
+        probe.proc = procs.items[0];
+    }
+    DaFree(procs);
+    DaAppend(probes, probe);
+}
+
+// "<base><probe index><ext>", removed after probing
+static const char *VL__ToolchainProbeOutput(vl_file_paths *files, const char *base, size_t index, const char *ext)
+{
+    const char *output = temp_sprintf("%s%zu%s", base, index, ext);
+    DaAppend(files, output);
+    return output;
+}
+
+static bool VL__ToolchainProbe(vl_c_compiler cc, vl_toolchain *tc, const char *cachePath)
+{
+    VL_Log(VL_INFO, "Probing %s", tc->path);
+    // NOTE: The probes that fail are expected to, their commands and errors aren't shown
+    vl_log_level prevLogLevel = VL_MinimalLogLevel;
+    VL_MinimalLogLevel = VL_QUIET;
+
+    const char *base = temp_sprintf("%s-probe", *cachePath ? cachePath : VL_TOOLCHAIN_CACHE);
+    const char *source = temp_sprintf("%s.c", base);
+    const char *header = temp_sprintf("%s.h", base);
+    const char *versionPath = temp_sprintf("%s-version.txt", base);
+    const char *targetPath = temp_sprintf("%s-target.txt", base);
+    vl_file_paths files = {0};
+    DaAppend(&files, source);
+    DaAppend(&files, header);
+    DaAppend(&files, versionPath);
+    DaAppend(&files, targetPath);
+
+    static const char sourceText[] = "int main(void) { return 0; }\n";
+    static const char headerText[] = "typedef int vl__probe;\n";
+    vl__toolchain_probes probes = {.maxProcs = (size_t)VL_GetCountProcs()};
+    if(probes.maxProcs == 0) probes.maxProcs = 1;
+    vl_cmd cmd = {0};
+    struct compiler_info_opts info = {.cmd = &cmd, .cc = cc};
+    if(WriteEntireFile(source, sourceText, sizeof(sourceText) - 1) &&
+       WriteEntireFile(header, headerText, sizeof(headerText) - 1))
+    {
+        VL_cc_Opt(info);
+        // NOTE: cl prints its version to stderr when run without arguments
+        if(cc == CCompiler_MSVC) {
+            VL__ToolchainProbeStart(&probes, &cmd, NULL, versionPath, NULL, 0);
         } else {
-            VL_ccOutput_Opt(info, output);
+            CmdAppend(&cmd, cc == CCompiler_TCC ? "-v" : "--version");
+            VL__ToolchainProbeStart(&probes, &cmd, versionPath, NULL, NULL, 0);
         }
     }
 
-    if(ctx->optimize == Optimize_Speed) {
-        if(ctx->cc == CCompiler_MSVC) {
-            CmdAppend(opt.cmd, "-O2");
-        } else if((ctx->cc == CCompiler_GCC) || (ctx->cc == CCompiler_Clang)) {
-            CmdAppend(opt.cmd, "-O3");
+    // NOTE: Every probe writes its own outputs so they can run at once
+    if(probes.count && ((cc == CCompiler_GCC) || (cc == CCompiler_Clang))) {
+        const char *output;
+        VL_cc_Opt(info);
+        CmdAppend(&cmd, "-dumpmachine");
+        VL__ToolchainProbeStart(&probes, &cmd, targetPath, NULL, NULL, 0);
+
+        // NOTE: The lto probes link, the objects are fine without the linker plugin
+        output = VL__ToolchainProbeOutput(&files, base, probes.count, "" VL_EXE_EXTENSION);
+        VL_cc_Opt(info);
+        CmdAppend(&cmd, "-flto", source, "-o", output);
+        VL__ToolchainProbeStart(&probes, &cmd, NULL, NULL, &tc->features, Feature_Lto);
+
+        if(cc == CCompiler_Clang) {
+            output = VL__ToolchainProbeOutput(&files, base, probes.count, "" VL_EXE_EXTENSION);
+            VL_cc_Opt(info);
+            CmdAppend(&cmd, "-flto=thin", source, "-o", output);
+            VL__ToolchainProbeStart(&probes, &cmd, NULL, NULL, &tc->features, Feature_ThinLto);
         }
-    } else if(ctx->optimize == Optimize_Size) {
-        if(ctx->cc != CCompiler_TCC) {
-            CmdAppend(opt.cmd, "-Os");
+
+        VL__ToolchainProbeOutput(&files, base, probes.count, ".dwo");
+        output = VL__ToolchainProbeOutput(&files, base, probes.count, ".o");
+        VL_cc_Opt(info);
+        CmdAppend(&cmd, "-g", "-gsplit-dwarf", "-c", source, "-o", output);
+        VL__ToolchainProbeStart(&probes, &cmd, NULL, NULL, &tc->features, Feature_SplitDwarf);
+
+        output = VL__ToolchainProbeOutput(&files, base, probes.count, ".h.gch");
+        VL_cc_Opt(info);
+        CmdAppend(&cmd, "-x", "c-header", header, "-o", output);
+        VL__ToolchainProbeStart(&probes, &cmd, NULL, NULL, &tc->features, Feature_Pch);
+
+        for(int isa = Isa_X86_64_V1; isa <= Isa_Armv8_2; isa++) {
+            output = VL__ToolchainProbeOutput(&files, base, probes.count, ".o");
+            VL_cc_Opt(info);
+            CmdAppend(&cmd, VL__isaMarch[isa], "-c", source, "-o", output);
+            VL__ToolchainProbeStart(&probes, &cmd, NULL, NULL, &tc->isas, VL_ISA(isa));
+        }
+
+        for(size_t i = 0; i < ArrayLen(VL__linkerNames); i++) {
+            if(!VL_temp_FindExecutable(VL__linkerPrograms[i])) continue;
+            output = VL__ToolchainProbeOutput(&files, base, probes.count, "" VL_EXE_EXTENSION);
+            VL_cc_Opt(info);
+            CmdAppend(&cmd, source, "-o", output, temp_sprintf("-fuse-ld=%s", VL__linkerNames[i]));
+            VL__ToolchainProbeStart(&probes, &cmd, NULL, NULL, &tc->linkers, 1u << (Linker_Mold + i));
+        }
+    }
+
+    while(probes.waited < probes.count) VL__ToolchainProbeWait(&probes);
+    tc->version = VL__ToolchainReadLine(versionPath);
+    tc->target = VL__ToolchainReadLine(targetPath);
+
+    for(size_t i = 0; i < files.count; i++) {
+        if(VL_FileExists(files.items[i])) VL_DeleteFile(files.items[i]);
+    }
+    VL_MinimalLogLevel = prevLogLevel;
+    DaFree(probes);
+    DaFree(files);
+    CmdFree(cmd);
+    return tc->version[0] != '\0';
+}
+
+VLIBPROC vl_toolchain *VL_GetToolchain(vl_c_compiler cc)
+{
+    vl_toolchains *toolchains = &VL_toolchains;
+    if(toolchains->disabled || toolchains->state[cc] == 2) return NULL;
+    if(toolchains->state[cc] == 1) return &toolchains->compilers[cc];
+
+    const char *cachePath = toolchains->cachePath ? toolchains->cachePath : VL_TOOLCHAIN_CACHE;
+    if(!toolchains->loaded) {
+        toolchains->loaded = true;
+        VL__ToolchainLoad(cachePath);
+    }
+
+    vl_cmd cmd = {0};
+    VL_cc_Opt((struct compiler_info_opts){.cmd = &cmd, .cc = cc});
+    const char *path = VL_temp_FindExecutable(cmd.items[0]);
+    CmdFree(cmd);
+    vl_file_stat fileStat;
+    if(!path || !VL_GetFileStat(path, &fileStat)) {
+        toolchains->state[cc] = 2;
+        return NULL;
+    }
+
+    vl_toolchain *tc = &toolchains->compilers[cc];
+    if(toolchains->state[cc] == 3 && tc->mtime == fileStat.mtime && tc->size == fileStat.size &&
+       strcmp(tc->path, path) == 0)
+    {
+        toolchains->state[cc] = 1;
+        return tc;
+    }
+
+    vl_toolchain probed = {
+        .path = VL__HeapStrndup(path, strlen(path)),
+        .mtime = fileStat.mtime,
+        .size = fileStat.size,
+    };
+    if(!VL__ToolchainProbe(cc, &probed, cachePath)) {
+        VL_Log(VL_WARNING, "Could not get the version of %s, its options are used without checking them", path);
+        VL__ToolchainFree(&probed);
+        toolchains->state[cc] = 2;
+        return NULL;
+    }
+    VL__ToolchainFree(tc);
+    *tc = probed;
+    toolchains->state[cc] = 1;
+    if(*cachePath) VL__ToolchainSave(cachePath);
+    return tc;
+}
+
+// The toolchain VL_CCompile checks the options of ctx with, one that takes everything when it's not probed
+static vl_toolchain *VL__CheckedToolchain(vl_compile_ctx *ctx)
+{
+    static vl_toolchain unchecked = {.features = ~0u, .isas = ~0u};
+    vl_toolchain *tc = NULL;
+    if((ctx->cc == CCompiler_GCC) || (ctx->cc == CCompiler_Clang)) tc = VL_GetToolchain(ctx->cc);
+    return tc ? tc : &unchecked;
+}
+
+// Whether bit is in supported, warning once about flag when it's not
+static bool VL__ToolchainHas(vl_toolchain *tc, unsigned supported, unsigned *warned, unsigned bit, const char *flag)
+{
+    if(supported & bit) return true;
+    if(!(*warned & bit)) {
+        *warned |= bit;
+        VL_Log(VL_WARNING, "%s doesn't support %s, building without it", tc->path, flag);
+    }
+    return false;
+}
+
+static bool VL__UsesPch(vl_compile_ctx *ctx)
+{
+    if(!ctx->precompiledHeader || ctx->cc == CCompiler_TCC || ctx->type == Compile_PrecompiledHeader) return false;
+    vl_toolchain *tc = VL__CheckedToolchain(ctx);
+    return VL__ToolchainHas(tc, tc->features, &tc->warnedFeatures, Feature_Pch, "precompiled headers");
+}
+
+// What the files shared by the compiles of a target are named after
+static const char *VL__TargetOutput(vl_compile_ctx *ctx)
+{
+    return ctx->targetOutput ? ctx->targetOutput : ctx->output;
+}
+
+// "<outputDir>/<output>-pch", what the precompiled header files are named from
+static const char *VL__PchBase(vl_compile_ctx *ctx)
+{
+    if(ctx->type == Compile_PrecompiledHeader) return temp_sprintf("%s/%s", ctx->outputDir, ctx->output);
+    return temp_sprintf("%s/%s-pch", ctx->outputDir, VL__TargetOutput(ctx));
+}
+
+/* The header that includes precompiledHeader, what gets precompiled.
+   NOTE: msvc looks for quoted includes from the including file and the name has to be the same
+   for /Yc, /Yu and /FI, so it's absolute there */
+static const char *VL__PchHeaderPath(vl_compile_ctx *ctx)
+{
+    const char *header = temp_sprintf("%s.h", VL__PchBase(ctx));
+    if(ctx->cc != CCompiler_MSVC) return header;
+    string_builder sb = {0};
+    VL__SbAppendIncludePath(&sb, VL_temp_GetCurrentDir(), header);
+    const char *result = temp_sprintf("%.*s", (int)sb.count, sb.items);
+    SbFree(sb);
+    return result;
+}
+
+static const char *VL__PchObjectPath(vl_compile_ctx *ctx)
+{
+    return temp_sprintf("%s.obj", VL__PchBase(ctx));
+}
+
+static const char *VL__PchPath(vl_compile_ctx *ctx)
+{
+    vl_compile_ctx pchCtx = *ctx;
+    pchCtx.type = Compile_PrecompiledHeader;
+    pchCtx.output = temp_sprintf("%s-pch", VL__TargetOutput(ctx));
+    return VL_GetFilePathFromCompileCtx(&pchCtx);
+}
+
+static const char *VL__ProfileDir(vl_compile_ctx *ctx)
+{
+    if(ctx->profileDir) return ctx->profileDir;
+    return temp_sprintf("%s/%s-pgo", ctx->outputDir, VL__TargetOutput(ctx));
+}
+
+static const char *VL__PgdPath(vl_compile_ctx *ctx)
+{
+    return temp_sprintf("%s/%s.pgd", VL__ProfileDir(ctx), VL__TargetOutput(ctx));
+}
+
+// separateObjects, or a static library with more than one source: "cc -c a.c b.c -o out.o" doesn't work
+static bool VL__CompilesSeparately(vl_compile_ctx *ctx)
+{
+    if(ctx->type == Compile_Object) return false;
+    return ctx->separateObjects || ctx->type == Compile_StaticLibrary;
+}
+
+/* "src/main.c" of "app" -> "app-src_main-<hash>" (the object extension is added after), the hash of the path
+   keeps "a/b.c", "a_b.c" and "a/b.cpp" apart */
+static vl_compile_ctx VL__ObjectCompileCtx(vl_compile_ctx *ctx, size_t source)
+{
+    vl_compile_ctx objCtx = *ctx;
+    objCtx.type = Compile_Object;
+    objCtx.separateObjects = false;
+    objCtx.sourceFiles.items = ctx->sourceFiles.items + source;
+    objCtx.sourceFiles.count = 1;
+    objCtx.sourceFiles.capacity = 1;
+    /* link only */
+    objCtx.libs = (vl_file_paths){0};
+    objCtx.libPaths = (vl_file_paths){0};
+    objCtx.gcSections = false;
+    if(!objCtx.targetOutput) objCtx.targetOutput = ctx->output;
+
+    const char *path = ctx->sourceFiles.items[source];
+    if(path[0] == '.' && (path[1] == '/' || path[1] == '\\')) path += 2;
+    // NOTE: The unity files are in outputDir already
+    size_t dirLen = ctx->outputDir ? strlen(ctx->outputDir) : 0;
+    if(dirLen > 0 && strncmp(path, ctx->outputDir, dirLen) == 0 && (path[dirLen] == '/' || path[dirLen] == '\\')) {
+        path += dirLen + 1;
+    }
+    size_t len = strlen(path);
+    for(size_t i = len; i > 0 && path[i-1] != '/' && path[i-1] != '\\'; i--) {
+        if(path[i-1] == '.') {
+            len = i - 1;
+            break;
+        }
+    }
+    u32 hash = (u32)VL_HashBytes(path, strlen(path), 0);
+    char *name = temp_sprintf("%s-%.*s-%08x", ctx->output, (int)len, path, hash);
+    for(char *c = name + strlen(ctx->output) + 1; *c; c++) {
+        if(*c == '/' || *c == '\\' || *c == ':' || *c == '.') *c = '_';
+    }
+    objCtx.output = name;
+    return objCtx;
+}
+
+// The objects of a separateObjects ctx and what gets built from them
+static const char *VL__SeparateObjects(vl_compile_ctx *ctx, vl_file_paths *objects)
+{
+    if(!ctx->outputDir) ctx->outputDir = ".";
+    for(size_t i = 0; i < ctx->sourceFiles.count; i++) {
+        vl_compile_ctx objCtx = VL__ObjectCompileCtx(ctx, i);
+        DaAppend(objects, VL_GetFilePathFromCompileCtx(&objCtx));
+    }
+    // NOTE: /Yc makes an object too, it has to be linked with the ones using it
+    if(VL__UsesPch(ctx) && ctx->cc == CCompiler_MSVC) DaAppend(objects, VL__PchObjectPath(ctx));
+    if(ctx->type == Compile_StaticLibrary) return VL__StaticLibPath(ctx);
+    return VL_GetFilePathFromCompileCtx(ctx);
+}
+
+static bool VL__IsThinArchive(const char *path)
+{
+    char magic[8];
+    FILE *f = fopen(path, "rb");
+    if(!f) return false;
+    size_t n = fread(magic, 1, sizeof(magic), f);
+    fclose(f);
+    return n == sizeof(magic) && memcmp(magic, "!<thin>\n", sizeof(magic)) == 0;
+}
+
+// The objects the output of separateObjects was made from, one per line
+static void VL__ObjectList(vl_file_paths objects, string_builder *list)
+{
+    for(size_t i = 0; i < objects.count; i++) SbAppendf(list, "%s\n", objects.items[i]);
+}
+
+/* The output has to be made again from all the objects: it's not there, the objects aren't the ones in
+   "<final>.objects" (a removed source leaves the others older than it) or it's an archive not of the
+   thinArchive kind. Archives otherwise only replace the objects that changed */
+static bool VL__ObjectsChanged(vl_compile_ctx *ctx, vl_file_paths objects, const char *final)
+{
+    const char *listPath = temp_sprintf("%s.objects", final);
+    if(!VL_FileExists(final) || !VL_FileExists(listPath)) return true;
+    if(ctx->type == Compile_StaticLibrary && ctx->cc != CCompiler_MSVC && VL__IsThinArchive(final) != ctx->thinArchive) return true;
+
+    string_builder list = {0}, old = {0};
+    VL__ObjectList(objects, &list);
+    bool result = !SbReadEntireFile(listPath, &old) || old.count != list.count ||
+                  memcmp(old.items, list.items, list.count) != 0;
+    SbFree(list);
+    SbFree(old);
+    return result;
+}
+
+static int VL__PathCompare(const void *a, const void *b)
+{
+    return strcmp(*(const char *const*)a, *(const char *const*)b);
+}
+
+/* Writes the unity files of ctx and puts them in unity (allocated in the temporary arena).
+   With the paths sorted, a batch ends after a path with hash % unityBatchSize == 0 or once it has twice
+   unityBatchSize sources, so a source added or removed only moves the boundaries around it. A batch is named
+   by the hash of its first path, the others keep their files. Files are only written when what they include
+   changes, so their mtime is that of the batch */
+static bool VL__UnitySources(vl_compile_ctx *ctx, vl_file_paths *unity)
+{
+    if(!ctx->outputDir) ctx->outputDir = ".";
+    const char *cwd = VL_temp_GetCurrentDir();
+    if(!cwd) return false;
+
+    vl_file_paths sorted = {0};
+    DaAppendMany(&sorted, ctx->sourceFiles.items, ctx->sourceFiles.count);
+    qsort(sorted.items, sorted.count, sizeof(*sorted.items), VL__PathCompare);
+
+    bool result = true;
+    size_t size = ctx->unityBatchSize;
+    string_builder sb = {0};
+    for(size_t start = 0; start < sorted.count;) {
+        size_t end = start;
+        while(end < sorted.count) {
+            const char *path = sorted.items[end++];
+            if(end - start >= 2*size || VL_HashBytes(path, strlen(path), 0) % size == 0) break;
+        }
+
+        const char *first = sorted.items[start];
+        const char *ext = strrchr(first, '.');
+        if(!ext || strchr(ext, '/') || strchr(ext, '\\')) ext = ".c";
+        sb.count = 0;
+        for(size_t i = start; i < end; i++) {
+            // NOTE: Quoted includes are relative to the including file, which is in outputDir
+            SbAppendCstr(&sb, "#include \"");
+            VL__SbAppendIncludePath(&sb, cwd, sorted.items[i]);
+            SbAppendCstr(&sb, "\"\n");
+        }
+        start = end;
+
+        u64 name = VL_HashBytes(first, strlen(first), 0);
+        const char *path = temp_sprintf("%s/%s-unity%016llx%s", ctx->outputDir, ctx->output, (unsigned long long)name, ext);
+        if(!VL__WriteFileIfChanged(path, &sb)) {
+            result = false;
+            break;
+        }
+        DaAppend(unity, path);
+    }
+    SbFree(sb);
+    DaFree(sorted);
+    return result;
+}
+
+// ctx compiling the unity files instead of its sources, the list has to be freed with DaFree
+static bool VL__UnityCtx(vl_compile_ctx *ctx, vl_compile_ctx *unityCtx)
+{
+    if(!ctx->outputDir) ctx->outputDir = ".";
+    *unityCtx = *ctx;
+    unityCtx->unityBatchSize = 0;
+    unityCtx->sourceFiles = (vl_file_paths){0};
+    return VL__UnitySources(ctx, &unityCtx->sourceFiles);
+}
+
+/* ctx building the precompiled header of ctx, its source is a header in outputDir including precompiledHeader
+   (and a source including that for msvc /Yc). The list has to be freed with DaFree */
+static bool VL__PchCompileCtx(vl_compile_ctx *ctx, vl_compile_ctx *pchCtx)
+{
+    if(!ctx->outputDir) ctx->outputDir = ".";
+    *pchCtx = *ctx;
+    pchCtx->type = Compile_PrecompiledHeader;
+    pchCtx->separateObjects = false;
+    pchCtx->unityBatchSize = 0;
+    pchCtx->targetOutput = NULL;
+    pchCtx->output = temp_sprintf("%s-pch", VL__TargetOutput(ctx));
+    pchCtx->sourceFiles = (vl_file_paths){0};
+    /* link only */
+    pchCtx->libs = (vl_file_paths){0};
+    pchCtx->libPaths = (vl_file_paths){0};
+    pchCtx->gcSections = false;
+
+    const char *header = VL__PchHeaderPath(pchCtx);
+    string_builder sb = {0};
+    SbAppendCstr(&sb, "#include \"");
+    VL__SbAppendIncludePath(&sb, VL_temp_GetCurrentDir(), ctx->precompiledHeader);
+    SbAppendCstr(&sb, "\"\n");
+    bool result = VL__WriteFileIfChanged(header, &sb);
+    if(result && ctx->cc == CCompiler_MSVC) {
+        const char *source = temp_sprintf("%s.c", VL__PchBase(pchCtx));
+        sb.count = 0;
+        SbAppendf(&sb, "#include \"%s\"\n", header);
+        result = VL__WriteFileIfChanged(source, &sb);
+        DaAppend(&pchCtx->sourceFiles, source);
+    } else {
+        DaAppend(&pchCtx->sourceFiles, header);
+    }
+    SbFree(sb);
+    return result;
+}
+
+// NOTE: tcc doesn't support -MMD (VL_ScanIncludes)
+static bool VL__ChecksDepFile(vl_compile_ctx *ctx)
+{
+    return !ctx->noDepFile && (ctx->cc != CCompiler_TCC);
+}
+
+// NOTE: -MF only holds the dependencies of one translation unit, with more VL_Needs_C_Rebuild writes it
+static bool VL__CompileUsesDepFile(vl_compile_ctx *ctx)
+{
+    return VL__ChecksDepFile(ctx) && (ctx->sourceFiles.count == 1);
+}
+
+static void VL__CCompileCmd(vl_compile_ctx *ctx, vl_cmd *cmd, bool depFile);
+
+static void VL__DepFileAppendPath(string_builder *sb, view path)
+{
+    SbAppendCstr(sb, " \\\n ");
+    for(size_t i = 0; i < path.count; i++) {
+        if(path.items[i] == ' ' || path.items[i] == '#') DaAppend(sb, '\\');
+        else if(path.items[i] == '$') DaAppend(sb, '$');
+        DaAppend(sb, path.items[i]);
+    }
+}
+
+/* Parses make style dependencies ("out.o: in.c in.h \\\n other.h", one rule per source with -MM),
+   the paths are unescaped in place in data, which must be null terminated. Targets and the sources are skipped */
+static void VL__ParseDeps(vl_compile_ctx *ctx, char *data, size_t size, vl_file_paths *deps)
+{
+    size_t i = 0;
+    while(i < size) {
+        char c = data[i];
+        if(c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\0' ||
+           (c == '\\' && i + 1 < size && (data[i+1] == '\n' || data[i+1] == '\r')))
+        {
+            i++;
+            continue;
+        }
+
+        char *start = data + i;
+        char *w = start;
+        while(i < size) {
+            c = data[i];
+            if(c == ' ' || c == '\t' || c == '\r' || c == '\n') break;
+            if(c == '\\' && i + 1 < size) {
+                char next = data[i+1];
+                if(next == ' ' || next == '#') {
+                    *w++ = next;
+                    i += 2;
+                    continue;
+                }
+                if(next == '\r' || next == '\n') break;
+            } else if(c == '$' && i + 1 < size && data[i+1] == '$') {
+                i++;
+            }
+            *w++ = c;
+            i++;
+        }
+        if(i < size) i++;
+        *w = '\0';
+
+        // NOTE: "C:/out.obj:" a target ends with the ':', windows drives don't
+        bool skip = w == start || w[-1] == ':';
+        for(size_t j = 0; !skip && j < ctx->sourceFiles.count; j++) {
+            skip = strcmp(start, ctx->sourceFiles.items[j]) == 0;
+        }
+        if(!skip) DaAppend(deps, start);
+    }
+}
+
+/* /showIncludes goes to stdout with the diagnostics, those are printed again
+   and the includes are written to "<output>.d" so it reads like the gcc ones */
+static bool VL__WriteMsvcDepFile(vl_compile_ctx *ctx, const char *captured, bool compiled)
+{
+    string_builder out = {0};
+    bool result = SbReadEntireFile(captured, &out);
+    remove(captured);
+    if(!result) return false;
+
+    string_builder dep = {0};
+    SbAppendf(&dep, "%s:", VL_GetFilePathFromCompileCtx(ctx));
+    VL__DepFileAppendPath(&dep, ViewFromCstr(ctx->sourceFiles.items[0]));
+
+    view data = ViewFromParts(out.items, out.count);
+    ViewIterateLines(&data, lineIdx, line) {
+        (void)lineIdx;
+        view inc = line;
+        if(ViewChopStartsWith(&inc, VIEW("Note: including file:"))) {
+            VL__DepFileAppendPath(&dep, ViewTrim(inc));
+        } else {
+            fwrite(line.items, 1, line.count, stdout);
+            fputc('\n', stdout);
+        }
+    }
+    DaAppend(&dep, '\n');
+
+    if(compiled) result = WriteEntireFile(VL_GetDepFilePathFromCompileCtx(ctx), dep.items, dep.count);
+    SbFree(out);
+    SbFree(dep);
+    return result;
+}
+
+// "src/main.c" -> "src"; "main.c" -> "."
+static view VL__PathDirView(const char *path)
+{
+    size_t len = strlen(path);
+    while(len > 0 && path[len-1] != '/' && path[len-1] != '\\') len--;
+    if(len == 0) return ViewFromParts(".", 1);
+    if(len == 1) return ViewFromParts(path, 1);
+    return ViewFromParts(path, len - 1);
+}
+
+typedef struct {
+    vl__include *items;
+    size_t count;
+    size_t capacity;
+} vl__includes;
+
+// Lexes the #include "name" and #include <name> directives, skipping comments, strings and char literals
+static void VL__LexIncludes(view src, vl__includes *includes)
+{
+    const char *s = src.items;
+    size_t n = src.count;
+    size_t i = 0;
+    bool lineStart = true;
+    while(i < n) {
+        char c = s[i];
+        if(c == '\n') {
+            lineStart = true;
+            i++;
+        } else if(c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+            i++;
+        } else if(c == '\\' && i + 1 < n && (s[i+1] == '\n' || s[i+1] == '\r')) {
+            i++;
+            if(s[i] == '\r') i++;
+            if(i < n && s[i] == '\n') i++;
+        } else if(c == '/' && i + 1 < n && s[i+1] == '/') {
+            while(i < n && s[i] != '\n') i++;
+        } else if(c == '/' && i + 1 < n && s[i+1] == '*') {
+            i += 2;
+            while(i + 1 < n && !(s[i] == '*' && s[i+1] == '/')) i++;
+            i += 2;
+        } else if(c == '"' || c == '\'') {
+            i++;
+            while(i < n && s[i] != c && s[i] != '\n') {
+                if(s[i] == '\\') i++;
+                i++;
+            }
+            i++;
+            lineStart = false;
+        } else if(c == '#' && lineStart) {
+            lineStart = false;
+            i++;
+            while(i < n && (s[i] == ' ' || s[i] == '\t')) i++;
+            view directive = ViewFromParts(s + i, 0);
+            while(i < n && ((s[i] >= 'a' && s[i] <= 'z') || s[i] == '_')) i++;
+            directive.count = (size_t)(s + i - directive.items);
+            if(!ViewEq(directive, VIEW("include")) && !ViewEq(directive, VIEW("include_next"))) continue;
+
+            for(;;) {
+                if(i < n && (s[i] == ' ' || s[i] == '\t')) {
+                    i++;
+                } else if(i + 1 < n && s[i] == '/' && s[i+1] == '*') {
+                    i += 2;
+                    while(i + 1 < n && !(s[i] == '*' && s[i+1] == '/')) i++;
+                    i += 2;
+                } else {
+                    break;
+                }
+            }
+            if(i >= n || (s[i] != '"' && s[i] != '<')) continue; /* #include MACRO */
+            vl__include inc = {0};
+            inc.angled = s[i] == '<';
+            char close = inc.angled ? '>' : '"';
+            size_t start = ++i;
+            while(i < n && s[i] != close && s[i] != '\n') i++;
+            if(i >= n || s[i] != close) continue;
+            inc.name = ViewFromParts(s + start, i - start);
+            i++;
+            DaAppend(includes, inc);
+        } else {
+            lineStart = false;
+            i++;
+        }
+    }
+}
+
+// Joins dir and name collapsing "." and "dir/..", so each header has one name in the cache
+static char *VL__temp_IncludePath(view dir, view name)
+{
+    char *joined;
+    bool absolute = name.count > 0 && (name.items[0] == '/' || name.items[0] == '\\' ||
+                                       (name.count > 1 && name.items[1] == ':'));
+    if(absolute || ViewEq(dir, VIEW("."))) {
+        joined = temp_strndup(name.items, name.count);
+    } else {
+        joined = temp_sprintf(VIEW_FMT"/"VIEW_FMT, VIEW_ARG(dir), VIEW_ARG(name));
+    }
+
+    char *r = joined;
+    char *w = joined;
+    if(r[0] && r[1] == ':') {
+        w += 2;
+        r += 2;
+    }
+    if(*r == '/' || *r == '\\') *w++ = *r++;
+    char *root = w;
+    size_t removable = 0;
+    while(*r) {
+        char *component = r;
+        while(*r && *r != '/' && *r != '\\') r++;
+        size_t len = (size_t)(r - component);
+        if(*r) r++;
+
+        bool parent = len == 2 && component[0] == '.' && component[1] == '.';
+        if(len == 0 || (len == 1 && component[0] == '.')) continue;
+        if(parent && removable > 0) {
+            while(w > root && w[-1] != '/') w--;
+            if(w > root) w--;
+            removable--;
+            continue;
+        }
+        if(!parent) removable++;
+        if(w > root) *w++ = '/';
+        memmove(w, component, len);
+        w += len;
+    }
+    *w = '\0';
+    return joined;
+}
+
+// "name" is looked up next to the file including it first, <name> only in the include paths
+static vl_filetime_node *VL__ResolveInclude(vl_compile_ctx *ctx, view dir, vl__include *inc)
+{
+    vl_file_stat fileStat;
+    if(!inc->angled) {
+        char *path = VL__temp_IncludePath(dir, inc->name);
+        if(VL_GetFileStatCached(path, &fileStat)) return VL__FileTimeGetNode(ViewFromCstr(path), true);
+    }
+    for(size_t i = 0; i < ctx->includePaths.count; i++) {
+        char *path = VL__temp_IncludePath(ViewFromCstr(ctx->includePaths.items[i]), inc->name);
+        if(VL_GetFileStatCached(path, &fileStat)) return VL__FileTimeGetNode(ViewFromCstr(path), true);
+    }
+    // NOTE: System headers and headers behind an #if that isn't taken
+    return NULL;
+}
+
+// Lexes the file once per (mtime, size, inode), the directives are kept in its node
+static bool VL__ScanNode(vl_filetime_node *node, string_builder *data)
+{
+    vl_file_stat fileStat;
+    if(!VL_GetFileStatCached(node->file.items, &fileStat)) {
+        VL_Log(VL_ERROR, "Could not scan includes of '"VIEW_FMT"': it does not exist", VIEW_ARG(node->file));
+        return false;
+    }
+    if(node->hasIncludes) return true;
+
+    data->count = 0;
+    if(!SbReadEntireFile(node->file.items, data)) return false;
+
+    vl__includes includes = {0};
+    VL__LexIncludes(ViewFromParts(data->items, data->count), &includes);
+    // NOTE: The directives and their names are one heap block, replaced when the file changes
+    if(node->includes) VL_FREE(node->includes);
+    node->includes = 0;
+    node->includeCount = 0;
+    if(includes.count > 0) {
+        size_t size = includes.count*sizeof(vl__include);
+        for(size_t i = 0; i < includes.count; i++) size += includes.items[i].name.count + 1;
+        node->includes = (vl__include*)VL_REALLOC(NULL, size);
+        Assert(node->includes && "Buy more RAM lol");
+        char *at = (char*)(node->includes + includes.count);
+        for(size_t i = 0; i < includes.count; i++) {
+            view name = includes.items[i].name;
+            memcpy(at, name.items, name.count);
+            at[name.count] = '\0';
+            node->includes[i].angled = includes.items[i].angled;
+            node->includes[i].name = ViewFromParts(at, name.count);
+            at += name.count + 1;
+        }
+        node->includeCount = (u32)includes.count;
+    }
+    node->hasIncludes = true;
+    DaFree(includes);
+    return true;
+}
+
+typedef struct {
+    vl_filetime_node **items;
+    size_t count;
+    size_t capacity;
+} vl__filetime_nodes;
+
+VLIBPROC bool VL_ScanIncludes(vl_compile_ctx *ctx, vl_file_paths *includes)
+{
+    vl_needrebuild_context *rebuild = &VL_needsRebuildContext;
+    u32 mark = ++rebuild->scanMark;
+    size_t tempMark = temp_save();
+    bool result = true;
+
+    vl__filetime_nodes stack = {0};
+    string_builder data = {0};
+    for(size_t i = 0; i < ctx->sourceFiles.count; i++) {
+        vl_filetime_node *node = VL__FileTimeGetNode(ViewFromCstr(ctx->sourceFiles.items[i]), true);
+        if(!node) VL_ReturnDefer(false);
+        node->scanMark = mark;
+        DaAppend(&stack, node);
+    }
+
+    while(stack.count > 0) {
+        vl_filetime_node *node = stack.items[--stack.count];
+        if(!VL__ScanNode(node, &data)) VL_ReturnDefer(false);
+
+        view dir = VL__PathDirView(node->file.items);
+        for(u32 i = 0; i < node->includeCount; i++) {
+            vl_filetime_node *header = VL__ResolveInclude(ctx, dir, &node->includes[i]);
+            if(header && header->scanMark != mark) {
+                header->scanMark = mark;
+                DaAppend(&stack, header);
+                DaAppend(includes, header->file.items);
+            }
+        }
+        temp_rewind(tempMark);
+    }
+
+defer:
+    DaFree(stack);
+    SbFree(data);
+    temp_rewind(tempMark);
+    return result;
+}
+
+// What content hash mode compares (in the temporary arena): the sources, the precompiled header, extraDependencies and includes
+static const char **VL__HashedInputs(vl_compile_ctx *ctx, const char **includes, size_t countIncludes, size_t *count)
+{
+    const char *pch = VL__UsesPch(ctx) ? VL__PchPath(ctx) : NULL;
+    *count = ctx->sourceFiles.count + (pch ? 1 : 0) + ctx->extraDependencies.count + countIncludes;
+    const char **inputs = (const char**)temp_alloc(*count*sizeof(char*) + 1, .Alignment = 8);
+    size_t at = 0;
+    for(size_t i = 0; i < ctx->sourceFiles.count; i++) inputs[at++] = ctx->sourceFiles.items[i];
+    if(pch) inputs[at++] = pch;
+    for(size_t i = 0; i < ctx->extraDependencies.count; i++) inputs[at++] = ctx->extraDependencies.items[i];
+    for(size_t i = 0; i < countIncludes; i++) inputs[at++] = includes[i];
+    return inputs;
+}
+
+static int VL__Needs_C_RebuildHashed(vl_compile_ctx *ctx, const char *output, const char **includes, size_t countIncludes)
+{
+    size_t count;
+    const char **inputs = VL__HashedInputs(ctx, includes, countIncludes, &count);
+
+    vl_cmd compileCmd = {0};
+    VL__CCompileCmd(ctx, &compileCmd, false);
+    u64 commandHash = VL__CmdHash(&compileCmd, 0);
+    CmdFree(compileCmd);
+
+    // NOTE: Remember the inputs so VL_CCompile can record them
+    vl_build_db_entry *entry = VL__BuildDbGetEntry(ViewFromCstr(output), true);
+    if(entry) {
+        bool same = entry->recorded && entry->inputCount == count;
+        for(size_t i = 0; same && i < count; i++) {
+            same = ViewEq(entry->inputs[i].path, ViewFromCstr(inputs[i]));
+        }
+        if(entry->pending && entry->pending != entry->inputs) VL_FREE(entry->pending);
+        if(same) {
+            entry->pending = entry->inputs;
+        } else {
+            view *paths = (view*)temp_alloc(count*sizeof(view) + 1, .Alignment = 8);
+            for(size_t i = 0; i < count; i++) paths[i] = ViewFromCstr(inputs[i]);
+            entry->pending = VL__BuildDbInputsAlloc(paths, count);
+        }
+        entry->pendingCount = count;
+    }
+
+    return VL_NeedsRebuildHashed(output, commandHash, inputs, count);
+}
+
+/* Records the inputs of a compile that succeeded. Its depfile has the includes it read, the pending ones
+   from VL_Needs_C_Rebuild are from before it. Without one, the pending inputs or only the sources */
+static void VL__BuildDbCommitCompile(vl_compile_ctx *ctx, const char *output, u64 commandHash)
+{
+    vl_build_db_entry *entry = VL__BuildDbGetEntry(ViewFromCstr(output), false);
+    size_t mark = temp_save();
+    const char *depPath = VL_GetDepFilePathFromCompileCtx(ctx);
+    string_builder data = {0};
+    vl_file_paths deps = {0};
+    size_t count;
+    if(VL__CompileUsesDepFile(ctx) && VL_FileExists(depPath) && SbReadEntireFile(depPath, &data)) {
+        DaAppend(&data, '\0');
+        VL__ParseDeps(ctx, data.items, data.count - 1, &deps);
+        const char **inputs = VL__HashedInputs(ctx, deps.items, deps.count, &count);
+        VL_BuildDbRecord(output, commandHash, inputs, count);
+    } else if(entry && entry->pending) {
+        const char **inputs = (const char**)temp_alloc(entry->pendingCount*sizeof(char*) + 1, .Alignment = 8);
+        for(size_t i = 0; i < entry->pendingCount; i++) inputs[i] = entry->pending[i].path.items;
+        VL_BuildDbRecord(output, commandHash, inputs, entry->pendingCount);
+    } else {
+        const char **inputs = VL__HashedInputs(ctx, NULL, 0, &count);
+        VL_BuildDbRecord(output, commandHash, inputs, count);
+    }
+    SbFree(data);
+    DaFree(deps);
+    temp_rewind(mark);
+}
+
+static int VL__Needs_C_RebuildIncludes(vl_compile_ctx *ctx, const char *output, const char **includes, size_t countIncludes)
+{
+    if(VL_needsRebuildContext.contentHash) {
+        return VL__Needs_C_RebuildHashed(ctx, output, includes, countIncludes);
+    }
+
+    vl_file_stat outputStat;
+    if(!VL_GetFileStat(output, &outputStat)) return 1;
+
+    for(size_t i = 0; i < countIncludes; i++) {
+        vl_file_stat inputStat;
+        // NOTE: A header that's gone means the includes changed
+        if(!VL_GetFileStatCached(includes[i], &inputStat)) return 1;
+
+        // NOTE: if even a single input_path is fresher than output_path that's 100% rebuild
+        if(inputStat.mtime > outputStat.mtime) return 1;
+    }
+    return 0;
+}
+
+// Asks the compiler for the includes, used when there is no depfile
+static int VL__Needs_C_RebuildSpawn(vl_cmd *cmd, vl_compile_ctx *ctx, const char *output)
+{
+    struct compiler_info_opts info = {
+        .cmd = cmd,
+        .cc = ctx->cc,
+    };
+    VL_cc_Opt(info);
+    if(ctx->cc == CCompiler_MSVC) {
+        CmdAppend(cmd, "/showIncludes", "/Zs", "/nologo");
+    } else {
+        CmdAppend(cmd, "-MM");
+    }
+
+    DaAppendMany(cmd, ctx->sourceFiles.items, ctx->sourceFiles.count);
+    for(size_t i = 0; i < ctx->includePaths.count; i++) {
+        VL_ccIncludepath_Opt(info, ctx->includePaths.items[i]);
+    }
+
+    int result = 0;
+    vl_fd read;
+    vl_fd write;
+    if(!VL_Pipe(&read, &write)) {
+        VL_Log(VL_ERROR, "Could not create pipe for VL_Needs_C_Rebuild");
+        return -1;
+    }
+
+    vl_proc proc = VL_CmdStartProcess(*cmd, 0, &write, 0, false);
+    VL_FileClose(write);
+
+    string_builder out = {0};
+    vl_file_paths includes = {0};
+    char buf[2048];
+    for(;;) {
+        uint32_t bytesRead;
+        if(!VL_FileRead(read, buf, (uint32_t)sizeof(buf), &bytesRead)) {
+            break;
+        }
+        SbAppendBuf(&out, buf, bytesRead);
+    }
+
+    if(ctx->cc == CCompiler_MSVC) {
+        view data = ViewFromParts(out.items, out.count);
+        ViewIterateLines(&data, lineIdx, line) {
+            (void)lineIdx;
+            if(ViewChopStartsWith(&line, VIEW("Note: including file: "))) {
+                // Remove spaces from the left showing include depth
+                line = ViewTrim(line);
+                DaAppend(&includes, temp_strndup(line.items, line.count));
+            } else {
+                // NOTE: This is a source filename, maybe it's useful to handle this later
+            }
+        }
+    } else {
+        // NOTE: Full format:
+        // file1.o: file1.c <include list>
+        // file2.o: file2.c <include list>
+        // etc.
+        DaAppend(&out, '\0');
+        VL__ParseDeps(ctx, out.items, out.count - 1, &includes);
+    }
+
+    if(!VL_ProcWait(proc)) {
+        VL_Log(VL_ERROR, "Could not wait for process to get includes");
+        VL_ReturnDefer(-1);
+    }
+    // NOTE: The next checks read them from here until a compile that doesn't write it removes it
+    if(VL__ChecksDepFile(ctx)) {
+        string_builder dep = {0};
+        SbAppendf(&dep, "%s:", output);
+        for(size_t i = 0; i < ctx->sourceFiles.count; i++) {
+            VL__DepFileAppendPath(&dep, ViewFromCstr(ctx->sourceFiles.items[i]));
+        }
+        for(size_t i = 0; i < includes.count; i++) {
+            VL__DepFileAppendPath(&dep, ViewFromCstr(includes.items[i]));
+        }
+        DaAppend(&dep, '\n');
+        VL__WriteFileAtomic(VL_GetDepFilePathFromCompileCtx(ctx), dep.items, dep.count);
+        SbFree(dep);
+    }
+    result = VL__Needs_C_RebuildIncludes(ctx, output, includes.items, includes.count);
+
+defer:
+    VL_FileClose(read);
+    SbFree(out);
+    DaFree(includes);
+    return result;
+}
+
+VLIBPROC int VL_Needs_C_Rebuild(vl_cmd *cmd, vl_compile_ctx *ctx)
+{
+    size_t iniMark = temp_save();
+    int result = 0;
+    size_t traceEvent = VL_TraceBegin("check", ctx->output ? ctx->output : "C rebuild");
+
+    if(!ctx->outputDir) ctx->outputDir = ".";
+    const char *pch = NULL;
+    if(VL__UsesPch(ctx)) {
+        // NOTE: Checked once with the target, its objects only compare with the precompiled header
+        if(!ctx->targetOutput) {
+            vl_compile_ctx pchCtx;
+            result = VL__PchCompileCtx(ctx, &pchCtx) ? VL_Needs_C_Rebuild(cmd, &pchCtx) : -1;
+            DaFree(pchCtx.sourceFiles);
+            if(result != 0) VL_ReturnDefer(result);
+        }
+        pch = VL__PchPath(ctx);
+    }
+    if(VL__CompilesSeparately(ctx)) {
+        if(ctx->unityBatchSize > 0) {
+            vl_compile_ctx unityCtx;
+            result = VL__UnityCtx(ctx, &unityCtx) ? VL_Needs_C_Rebuild(cmd, &unityCtx) : -1;
+            DaFree(unityCtx.sourceFiles);
+            VL_ReturnDefer(result);
+        }
+        vl_file_paths objects = {0};
+        const char *final = VL__SeparateObjects(ctx, &objects);
+        for(size_t i = 0; result == 0 && i < ctx->sourceFiles.count; i++) {
+            vl_compile_ctx objCtx = VL__ObjectCompileCtx(ctx, i);
+            result = VL_Needs_C_Rebuild(cmd, &objCtx);
+        }
+        if(result == 0) result = VL_NeedsRebuild_Impl(final, objects.items, objects.count);
+        if(result == 0 && VL__ObjectsChanged(ctx, objects, final)) result = 1;
+        DaFree(objects);
+        VL_ReturnDefer(result);
+    }
+    const char *output = VL_GetFilePathFromCompileCtx(ctx);
+
+    if(!VL_needsRebuildContext.contentHash) {
+        result = VL_NeedsRebuild_Impl(output, ctx->sourceFiles.items, ctx->sourceFiles.count);
+        if(result != 0) VL_ReturnDefer(result);
+    }
+    // NOTE: Content hash mode hashes these with the includes
+    if(pch && !VL_needsRebuildContext.contentHash) {
+        result = VL_NeedsRebuild_Impl(output, &pch, 1);
+        if(result != 0) VL_ReturnDefer(result);
+    }
+    if(ctx->extraDependencies.count > 0 && !VL_needsRebuildContext.contentHash) {
+        result = VL_NeedsRebuild_Impl(output, ctx->extraDependencies.items, ctx->extraDependencies.count);
+        if(result != 0) VL_ReturnDefer(result);
+    }
+
+    // NOTE: The last VL_CCompile or check left the includes here, no process is needed.
+    // Without one (compiled before depfiles, more than one source or async msvc) the compiler is asked
+    const char *depPath = VL_GetDepFilePathFromCompileCtx(ctx);
+    vl_file_stat depStat;
+    if(VL__ChecksDepFile(ctx) && VL_GetFileStat(depPath, &depStat)) {
+        string_builder data = {0};
+        vl_file_paths deps = {0};
+        if(!SbReadEntireFile(depPath, &data)) {
+            result = 1;
+        } else {
+            DaAppend(&data, '\0');
+            VL__ParseDeps(ctx, data.items, data.count - 1, &deps);
+            result = VL__Needs_C_RebuildIncludes(ctx, output, deps.items, deps.count);
+        }
+        SbFree(data);
+        DaFree(deps);
+    } else if(ctx->cc == CCompiler_TCC) {
+        // NOTE: tcc can't list the includes
+        vl_file_paths includes = {0};
+        if(VL_ScanIncludes(ctx, &includes)) {
+            result = VL__Needs_C_RebuildIncludes(ctx, output, includes.items, includes.count);
+        } else {
+            result = 1;
+        }
+        DaFree(includes);
+    } else {
+        result = VL__Needs_C_RebuildSpawn(cmd, ctx, output);
+        cmd->count = 0;
+    }
+
+defer:
+    VL_TraceEnd(traceEvent);
+    temp_rewind(iniMark);
+    return result;
+}
+
+VLIBPROC const char *VL_temp_GetCurrentDir(void)
+{
+#ifdef _WIN32
+    DWORD nBufferLength = GetCurrentDirectory(0, NULL);
+    if (nBufferLength == 0) {
+        VL_Log(VL_ERROR, "could not get current directory: %s", Win32_ErrorMessage(GetLastError()));
+        return NULL;
+    }
+
+    char *buffer = (char*) temp_alloc(nBufferLength, .Alignment = 1);
+    if (GetCurrentDirectory(nBufferLength, buffer) == 0) {
+        VL_Log(VL_ERROR, "could not get current directory: %s", Win32_ErrorMessage(GetLastError()));
+        return NULL;
+    }
+
+    return buffer;
+#else
+    char *buffer = (char*) temp_alloc(PATH_MAX, .Alignment = 1);
+    if (getcwd(buffer, PATH_MAX) == NULL) {
+        VL_Log(VL_ERROR, "could not get current directory: %s", strerror(errno));
+        return NULL;
+    }
+
+    return buffer;
+#endif // _WIN32
+}
+
+VLIBPROC const char *VL_temp_FindExecutable(const char *name)
+{
+#if OS_WINDOWS
+    char *buffer = (char*) temp_alloc(MAX_PATH, .Alignment = 1);
+    DWORD len = SearchPathA(NULL, name, ".exe", MAX_PATH, buffer, NULL);
+    if(len == 0 || len >= MAX_PATH) return NULL;
+    return buffer;
+#else
+    const char *path = getenv("PATH");
+    if(!path) return NULL;
+    while(*path) {
+        const char *end = strchr(path, ':');
+        size_t len = end ? (size_t)(end - path) : strlen(path);
+        // NOTE: An empty entry is the current directory
+        const char *file = len ? temp_sprintf("%.*s/%s", (int)len, path, name) : temp_sprintf("./%s", name);
+        if(access(file, X_OK) == 0) return file;
+        if(!end) break;
+        path = end + 1;
+    }
+    return NULL;
+#endif
+}
+
+struct vl__pushd_buf_type VL__pushDirectoryBuffer;
+
+VLIBPROC bool VL_Pushd(const char *path)
+{
+    static bool initialized = false;
+    if(!initialized) {
+        initialized = true;
+        VL__pushDirectoryBuffer.items[0] = temp_strdup(VL_temp_GetCurrentDir());
+        VL__pushDirectoryBuffer.count = 1;
+    }
+
+    AssertMsgAlways((VL__pushDirectoryBuffer.count+1) < VL_PUSHD_BUF_MAX, "Increase the size of the pushd buffer (VL_PUSHD_BUF_MAX)");
+    bool ok = VL_SetCurrentDir(path);
+    if(ok) {
+        VL__pushDirectoryBuffer.items[VL__pushDirectoryBuffer.count] =
+            temp_sprintf("%s/%s", VL__pushDirectoryBuffer.items[VL__pushDirectoryBuffer.count - 1], path);
+        VL__pushDirectoryBuffer.count++;
+    } else {
+#if defined(_WIN32)
+        VL_Log(VL_ERROR, "could not set current directory to %s: %s", path, Win32_ErrorMessage(GetLastError()));
+#else
+        VL_Log(VL_ERROR, "could not set current directory to %s: %s", path, strerror(errno));
+#endif
+    }
+    return ok;
+}
+
+VLIBPROC bool VL_Popd(void)
+{
+    AssertMsg(VL__pushDirectoryBuffer.count > 1, "Need to do pushd before popd");
+    const char *path = VL__pushDirectoryBuffer.items[VL__pushDirectoryBuffer.count - 2];
+    bool ok = VL_SetCurrentDir(path);
+    if(ok) VL__pushDirectoryBuffer.count--;
+    else {
+#if defined(_WIN32)
+        VL_Log(VL_ERROR, "could not set current directory to %s: %s", path, Win32_ErrorMessage(GetLastError()));
+#else
+        VL_Log(VL_ERROR, "could not set current directory to %s: %s", path, strerror(errno));
+#endif
+    }
+    return ok;
+}
+
+VLIBPROC char *VL_temp_DirName(const char *path)
+{
+#ifndef _WIN32
+    // Stolen from the musl's implementation of dirname.
+    // We are implementing our own one because libc vendors cannot agree on whether dirname(3)
+    // modifies the path or not.
+    if(!path || !*path) return temp_strndup(".", 1);
+    size_t i = strlen(path) - 1;
+    for(; path[i] == '/'; i--) if(!i) return temp_strndup("/", 1);
+    for(; path[i] != '/'; i--) if(!i) return temp_strndup(".", 1);
+    for(; path[i] == '/'; i--) if(!i) return temp_strndup("/", 1);
+    return temp_strndup(path, i + 1);
+#else
+    if(!path) path = ""; // Treating NULL as empty.
+    char *drive = temp_alloc(_MAX_DRIVE, .Alignment = 1);
+    char *dir   = temp_alloc(_MAX_DIR, .Alignment = 1);
+    // https://learn.microsoft.com/en-us/previous-versions/visualstudio/visual-studio-2010/8e46eyt7(v=vs.100)
+    errno_t ret = _splitpath_s(path, drive, _MAX_DRIVE, dir, _MAX_DIR, NULL, 0, NULL, 0);
+    Assert(ret == 0);
+    return temp_sprintf("%s%s", drive, dir);
+#endif // _WIN32
+}
+
+VLIBPROC char *VL_temp_FileName(const char *path)
+{
+#ifndef _WIN32
+    // Stolen from the musl's implementation of dirname.
+    // We are implementing our own one because libc vendors cannot agree on whether basename(3)
+    // modifies the path or not.
+    if(!path || !*path) return temp_strndup(".", 1);
+    size_t i = strlen(path)-1;
+    char *s = temp_strndup(path, i);
+    for(; i&&s[i]=='/'; i--) s[i] = 0;
+    for(; i&&s[i-1]!='/'; i--);
+    return s+i;
+#else
+    if(!path) path = ""; // Treating NULL as empty.
+    char *fname = temp_alloc(_MAX_FNAME, .Alignment = 1);
+    char *ext = temp_alloc(_MAX_EXT, .Alignment = 1);
+    // https://learn.microsoft.com/en-us/previous-versions/visualstudio/visual-studio-2010/8e46eyt7(v=vs.100)
+    errno_t ret = _splitpath_s(path, NULL, 0, NULL, 0, fname, _MAX_FNAME, ext, _MAX_EXT);
+    Assert(ret == 0);
+    return temp_sprintf("%s%s", fname, ext);
+#endif // _WIN32
+}
+
+VLIBPROC char *VL_temp_FileExt(const char *path)
+{
+#ifndef _WIN32
+    return strrchr(VL_temp_FileName(path), '.');
+#else
+    if(!path) path = ""; // Treating NULL as empty.
+    char *ext = temp_alloc(_MAX_EXT, .Alignment = 1);
+    // https://learn.microsoft.com/en-us/previous-versions/visualstudio/visual-studio-2010/8e46eyt7(v=vs.100)
+    errno_t ret = _splitpath_s(path, NULL, 0, NULL, 0, NULL, 0, ext, _MAX_EXT);
+    Assert(ret == 0);
+    return ext;
+#endif // _WIN32
+}
+
+VLIBPROC char *VL_temp_RunningExecutablePath(void)
+{
+#if defined(__linux__)
+    char buf[4096];
+    int length = readlink("/proc/self/exe", buf, ArrayLen(buf));
+    if(length < 0) return temp_strndup("", 0);
+    return temp_strndup(buf, length);
+#elif defined(_WIN32)
+    char buf[MAX_PATH];
+    int length = GetModuleFileNameA(NULL, buf, MAX_PATH);
+    return temp_strndup(buf, length);
+#elif defined(__APPLE__)
+    char buf[4096];
+    uint32_t size = ArrayLen(buf);
+    if(_NSGetExecutablePath(buf, &size) != 0) return temp_strndup("", 0);
+    int length = strlen(buf);
+    return temp_strndup(buf, length);
+#elif defined(__FreeBSD__)
+    char buf[4096];
+    int mib[4] = { CTL_KERN, KERN_PROC, KERN_PROC_PATHNAME, -1 };
+    size_t length = sizeof(buf);
+    if(sysctl(mib, 4, buf, &length, NULL, 0) < 0) return temp_strndup("", 0);
+    return temp_strndup(buf, length);
+#elif defined(__HAIKU__)
+    int cookie = 0;
+    image_info info;
+    while(get_next_image_info(B_CURRENT_TEAM, &cookie, &info) == B_OK) {
+        if(info.type == B_APP_IMAGE) break;
+    }
+    return temp_strdup(info.name);
+#else
+    fprintf(stderr, LOC_STR": TODO: %s is not implemented for this platform\n", __FUNCTION__);
+    return temp_strndup("", 0);
+#endif
+}
+
+VLIBPROC void VL_cc_Opt(struct compiler_info_opts opt)
+{
+    switch(opt.cc) {
+        case CCompiler_GCC: {
+            CmdAppend(opt.cmd, "cc");
+        } break;
+        case CCompiler_Clang: {
+            CmdAppend(opt.cmd, "clang");
+        } break;
+        case CCompiler_MSVC: {
+            CmdAppend(opt.cmd, "cl.exe");
+        } break;
+        case CCompiler_TCC: {
+            CmdAppend(opt.cmd, "tcc");
+        } break;
+    }
+}
+
+VLIBPROC void VL_ccWarnings_Opt(struct compiler_info_opts opt)
+{
+    switch(opt.cc) {
+        case CCompiler_GCC:
+        case CCompiler_TCC:
+        case CCompiler_Clang: {
+            CmdAppend(opt.cmd, "-Wall", "-Wextra");
+        } break;
+        case CCompiler_MSVC: {
+            CmdAppend(opt.cmd, "-W4", "-nologo", "-D_CRT_SECURE_NO_WARNINGS");
+        } break;
+    }
+}
+
+VLIBPROC void VL_ccWarningsAsErrors_Opt(struct compiler_info_opts opt)
+{
+    switch(opt.cc) {
+        case CCompiler_GCC:
+        case CCompiler_TCC:
+        case CCompiler_Clang: {
+            CmdAppend(opt.cmd, "-Werror");
+        } break;
+        case CCompiler_MSVC: {
+            CmdAppend(opt.cmd, "-WX");
+        } break;
+    }
+}
+
+VLIBPROC void VL_ccOutput_Opt(struct compiler_info_opts opt, const char *output)
+{
+    Assert(output);
+    switch(opt.cc) {
+        case CCompiler_GCC:
+        case CCompiler_TCC:
+        case CCompiler_Clang: {
+            CmdAppend(opt.cmd, "-o", output);
+        } break;
+        case CCompiler_MSVC: {
+            CmdAppend(opt.cmd, temp_sprintf("/Fe:%s", output));
+        } break;
+    }
+}
+
+VLIBPROC void VL_ccDebug_Opt(struct compiler_info_opts opt)
+{
+    switch(opt.cc) {
+        case CCompiler_GCC:
+        case CCompiler_TCC:
+        case CCompiler_Clang: {
+            CmdAppend(opt.cmd, "-g");
+        } break;
+        case CCompiler_MSVC: {
+            CmdAppend(opt.cmd, "-Zi");
+        } break;
+    }
+}
+
+VLIBPROC void VL_ccLib_Opt(struct compiler_info_opts opt, const char *lib)
+{
+#if OS_WINDOWS
+    if(opt.cc == CCompiler_MSVC && !opt.cmd->msvc_linkflags) {
+        CmdAppend(opt.cmd, "/link");
+        opt.cmd->msvc_linkflags = true;
+    }
+#endif
+
+    switch(opt.cc) {
+        case CCompiler_GCC:
+        case CCompiler_TCC:
+        case CCompiler_Clang: {
+            CmdAppend(opt.cmd, "-l", lib);
+        } break;
+        case CCompiler_MSVC: {
+            CmdAppend(opt.cmd, temp_sprintf("%s.lib", lib));
+        } break;
+    }
+}
+
+VLIBPROC void VL_ccIncludepath_Opt(struct compiler_info_opts opt, const char *includepath)
+{
+    CmdAppend(opt.cmd, "-I", includepath);
+}
+
+VLIBPROC void VL_ccLibpath_Opt(struct compiler_info_opts opt, const char *libpath)
+{
+#if OS_WINDOWS
+    if(opt.cc == CCompiler_MSVC && !opt.cmd->msvc_linkflags) {
+        CmdAppend(opt.cmd, "/link");
+        opt.cmd->msvc_linkflags = true;
+    }
+#endif
+
+    switch(opt.cc) {
+        case CCompiler_GCC:
+        case CCompiler_TCC:
+        case CCompiler_Clang: {
+            CmdAppend(opt.cmd, "-L", libpath);
+        } break;
+        case CCompiler_MSVC: {
+            CmdAppend(opt.cmd, temp_sprintf("/libpath:%s", libpath));
+        } break;
+    }
+}
+
+// The name for "-fuse-ld=" of ctx->linker, NULL for the default one
+static const char *VL__LinkerName(vl_compile_ctx *ctx)
+{
+    if(ctx->linker == Linker_Default || ctx->cc == CCompiler_MSVC || ctx->cc == CCompiler_TCC) return NULL;
+
+    // NOTE: The probed toolchain knows the linkers that link, otherwise 0 not checked, 1 found, 2 not found; once per process
+    vl_toolchain *tc = VL_GetToolchain(ctx->cc);
+    static int found[ArrayLen(VL__linkerNames)];
+    static bool warned = false;
+    for(size_t i = 0; i < ArrayLen(VL__linkerNames); i++) {
+        if(ctx->linker != Linker_Fast && ctx->linker != (vl_linker)(Linker_Mold + i)) continue;
+        // NOTE: lld doesn't have gcc's lto plugin
+        if((ctx->lto != Lto_None) && (ctx->cc == CCompiler_GCC) && (Linker_Mold + i == Linker_Lld)) continue;
+        if(tc) {
+            if(tc->linkers & (1u << (Linker_Mold + i))) return VL__linkerNames[i];
+            continue;
+        }
+        if(found[i] == 0) found[i] = VL_temp_FindExecutable(VL__linkerPrograms[i]) ? 1 : 2;
+        if(found[i] == 1) return VL__linkerNames[i];
+    }
+    if(!warned) {
+        warned = true;
+        if(ctx->linker == Linker_Fast) {
+            VL_Log(VL_WARNING, "none of mold, lld and gold were found, linking with the default linker");
+        } else {
+            VL_Log(VL_WARNING, "%s can't be used, linking with the default linker", VL__linkerPrograms[ctx->linker - Linker_Mold]);
+        }
+    }
+    return NULL;
+}
+
+static void VL__CCompileCmd(vl_compile_ctx *ctx, vl_cmd *cmd, bool depFile)
+{
+    struct compiler_info_opts info = {
+        .cmd = cmd,
+        .cc = ctx->cc,
+    };
+
+    if(!ctx->outputDir) {
+        ctx->outputDir = ".";
+    }
+    const char *output = VL_GetFilePathFromCompileCtx(ctx);
+    vl_toolchain *tc = VL__CheckedToolchain(ctx);
+    VL_cc_Opt(info);
+
+    // compile only, don't link
+    if((ctx->type == Compile_StaticLibrary) ||
+       (ctx->type == Compile_Object))
+    {
+        CmdAppend(cmd, "-c");
+    } else if(ctx->type == Compile_PrecompiledHeader) {
+        if(ctx->cc == CCompiler_MSVC) {
+            CmdAppend(cmd, "-c");
+        } else {
+            CmdAppend(cmd, "-x", "c-header");
+        }
+    }
+
+    DaAppendMany(cmd, ctx->sourceFiles.items, ctx->sourceFiles.count);
+    /* If compiling for an object, output file path is autoassigned by compiler unless specified */
+    if(output) {
+        if((ctx->type == Compile_PrecompiledHeader) && (ctx->cc == CCompiler_MSVC)) {
+            CmdAppend(cmd, temp_sprintf("/Yc%s", VL__PchHeaderPath(ctx)), temp_sprintf("/Fp%s", output),
+                      temp_sprintf("-Fo:%s", VL__PchObjectPath(ctx)));
+        } else if(((ctx->type == Compile_Object) || (ctx->type == Compile_StaticLibrary)) && (ctx->cc == CCompiler_MSVC))
+        {
+            CmdAppend(cmd, temp_sprintf("-Fo:%s", output));
+        } else {
+            VL_ccOutput_Opt(info, output);
+        }
+    }
+
+    if(ctx->optimize == Optimize_Speed) {
+        if(ctx->cc == CCompiler_MSVC) {
+            CmdAppend(cmd, "-O2");
+        } else if((ctx->cc == CCompiler_GCC) || (ctx->cc == CCompiler_Clang)) {
+            CmdAppend(cmd, "-O3");
+        }
+    } else if(ctx->optimize == Optimize_Size) {
+        if(ctx->cc != CCompiler_TCC) {
+            CmdAppend(cmd, "-Os");
+        }
+    }
+
+    if(ctx->pgo == Pgo_Generate) {
+        if(ctx->cc == CCompiler_MSVC) {
+            CmdAppend(cmd, "/GL");
+        } else if(ctx->cc == CCompiler_GCC) {
+            CmdAppend(cmd, "-fprofile-generate");
+        } else if(ctx->cc == CCompiler_Clang) {
+            // NOTE: %m merges the runs of the same binary into one file
+            CmdAppend(cmd, temp_sprintf("-fprofile-instr-generate=%s/%%m.profraw", VL__ProfileDir(ctx)));
+        }
+    } else if(ctx->pgo == Pgo_Use) {
+        if(ctx->cc == CCompiler_MSVC) {
+            CmdAppend(cmd, "/GL");
+        } else if(ctx->cc == CCompiler_GCC) {
+            CmdAppend(cmd, "-fprofile-use", "-Wno-missing-profile");
+        } else if(ctx->cc == CCompiler_Clang) {
+            CmdAppend(cmd, temp_sprintf("-fprofile-instr-use=%s/default.profdata", VL__ProfileDir(ctx)));
+        }
+    }
+
+    bool link = (ctx->type == Compile_Executable) || (ctx->type == Compile_DynamicLibrary);
+    if(ctx->lto != Lto_None) {
+        if(ctx->cc == CCompiler_MSVC) {
+            // NOTE: pgo adds it already
+            if(ctx->pgo == Pgo_None) CmdAppend(cmd, "/GL");
+        } else if(ctx->cc == CCompiler_GCC) {
+            // NOTE: The number is how many jobs the link time optimization is split in
+            if(VL__ToolchainHas(tc, tc->features, &tc->warnedFeatures, Feature_Lto, "-flto")) {
+                CmdAppend(cmd, temp_sprintf("-flto=%d", VL_GetCountProcs()));
+            }
+        } else if(ctx->cc == CCompiler_Clang) {
+            if((ctx->lto == Lto_Thin) &&
+               VL__ToolchainHas(tc, tc->features, &tc->warnedFeatures, Feature_ThinLto, "-flto=thin"))
+            {
+                CmdAppend(cmd, "-flto=thin");
+                if(link) CmdAppend(cmd, temp_sprintf("-flto-jobs=%d", VL_GetCountProcs()));
+            } else if(VL__ToolchainHas(tc, tc->features, &tc->warnedFeatures, Feature_Lto, "-flto")) {
+                CmdAppend(cmd, "-flto");
+            }
+        }
+    }
+
+    if(ctx->isa != Isa_Default) {
+        if(ctx->cc == CCompiler_MSVC) {
+            if(ctx->isa == Isa_X86_64_V3) CmdAppend(cmd, "/arch:AVX2");
+            else if(ctx->isa == Isa_X86_64_V4) CmdAppend(cmd, "/arch:AVX512");
+            else if(ctx->isa == Isa_Armv8_2) CmdAppend(cmd, "/arch:armv8.2");
+        } else if(((ctx->cc == CCompiler_GCC) || (ctx->cc == CCompiler_Clang)) &&
+                  VL__ToolchainHas(tc, tc->isas, &tc->warnedIsas, VL_ISA(ctx->isa), VL__isaMarch[ctx->isa]))
+        {
+            CmdAppend(cmd, VL__isaMarch[ctx->isa]);
+        }
+    }
+
+    if(ctx->debug) {
+        VL_ccDebug_Opt(info);
+        if(ctx->splitDwarf && ((ctx->cc == CCompiler_GCC) || (ctx->cc == CCompiler_Clang)) &&
+           VL__ToolchainHas(tc, tc->features, &tc->warnedFeatures, Feature_SplitDwarf, "-gsplit-dwarf"))
+        {
+            CmdAppend(cmd, "-gsplit-dwarf");
+        }
+    }
+    if(ctx->warnings) VL_ccWarnings_Opt(info);
+    if(ctx->warningsAsErrors) VL_ccWarningsAsErrors_Opt(info);
+    for(size_t i = 0; i < ctx->includePaths.count; i++) {
+        VL_ccIncludepath_Opt(info, ctx->includePaths.items[i]);
+    }
+    if(VL__UsesPch(ctx)) {
+        if(ctx->cc == CCompiler_MSVC) {
+            const char *header = VL__PchHeaderPath(ctx);
+            CmdAppend(cmd, temp_sprintf("/Yu%s", header), temp_sprintf("/FI%s", header),
+                      temp_sprintf("/Fp%s", VL__PchPath(ctx)));
+            if((ctx->type == Compile_Executable) || (ctx->type == Compile_DynamicLibrary)) {
+                CmdAppend(cmd, VL__PchObjectPath(ctx));
+            }
+        } else if(ctx->cc == CCompiler_Clang) {
+            CmdAppend(cmd, "-include-pch", VL__PchPath(ctx));
+        } else {
+            // NOTE: gcc uses "<header>.gch" instead of the header when it's there and valid
+            CmdAppend(cmd, "-include", VL__PchHeaderPath(ctx));
+        }
+    }
+    if(depFile) {
+        if(ctx->cc == CCompiler_MSVC) {
+            CmdAppend(cmd, "/showIncludes");
+        } else {
+            CmdAppend(cmd, "-MMD", "-MF", VL_GetDepFilePathFromCompileCtx(ctx));
+        }
+    }
+
+    /* extra compiler flags */
+    DaAppendMany(cmd, ctx->extraCompilerFlags.items, ctx->extraCompilerFlags.count);
+    if(ctx->cc == CCompiler_MSVC) {
+        DaAppendMany(cmd, ctx->extraMsvcFlags.items, ctx->extraMsvcFlags.count);
+    } else {
+        DaAppendMany(cmd, ctx->extraGccClangFlags.items, ctx->extraGccClangFlags.count);
+        if(ctx->cc == CCompiler_GCC) {
+            DaAppendMany(cmd, ctx->extraGccFlags.items, ctx->extraGccFlags.count);
+        } else if(ctx->cc == CCompiler_Clang) {
+            DaAppendMany(cmd, ctx->extraClangFlags.items, ctx->extraClangFlags.count);
+        }
+    }
+
+    /* after "/link" in msvc */
+    for(size_t i = 0; i < ctx->libPaths.count; i++) {
+        VL_ccLibpath_Opt(info, ctx->libPaths.items[i]);
+    }
+
+    for(size_t i = 0; i < ctx->libs.count; i++) {
+        VL_ccLib_Opt(info, ctx->libs.items[i]);
+    }
+
+#if OS_WINDOWS
+    if((ctx->cc == CCompiler_MSVC) && !cmd->msvc_linkflags) {
+        CmdAppend(cmd, "/link");
+        cmd->msvc_linkflags = true;
+    }
+#endif
+
+    if(ctx->type == Compile_DynamicLibrary) {
+        if(ctx->cc == CCompiler_MSVC) {
+            CmdAppend(cmd, "/DLL");
+        } else {
+            CmdAppend(cmd, "-shared");
+        }
+    }
+
+    if(!ctx->incremental && (ctx->cc == CCompiler_MSVC)) {
+        CmdAppend(cmd, "-incremental:no");
+    }
+    if(ctx->gcSections) {
+        if(ctx->cc == CCompiler_MSVC) {
+            CmdAppend(cmd, "-opt:ref");
+        } else {
+            CmdAppend(cmd, "-Wl,--gc-sections");
+        }
+    }
+    if(link) {
+        const char *linker = VL__LinkerName(ctx);
+        if(linker) CmdAppend(cmd, temp_sprintf("-fuse-ld=%s", linker));
+        if(ctx->icf) {
+            if(ctx->cc == CCompiler_MSVC) {
+                CmdAppend(cmd, "/OPT:ICF");
+            } else if(linker) {
+                CmdAppend(cmd, "-Wl,--icf=all");
+            }
+        }
+        if((ctx->lto != Lto_None) && (ctx->pgo == Pgo_None) && (ctx->cc == CCompiler_MSVC)) {
+            CmdAppend(cmd, "/LTCG");
+        }
+    }
+    if((ctx->pgo != Pgo_None) && (ctx->cc == CCompiler_MSVC) &&
+       ((ctx->type == Compile_Executable) || (ctx->type == Compile_DynamicLibrary)))
+    {
+        CmdAppend(cmd, "/LTCG", temp_sprintf("%s:PGD=%s", ctx->pgo == Pgo_Generate ? "/GENPROFILE" : "/USEPROFILE",
+                                             VL__PgdPath(ctx)));
+    }
+}
+
+VLIBPROC void VL_CCompileCmd(vl_compile_ctx *ctx, vl_cmd *cmd)
+{
+    VL__CCompileCmd(ctx, cmd, VL__CompileUsesDepFile(ctx));
+}
+
+#define VL__COMPILE_CACHE_VERSION 1
+#ifndef VL_COMPILE_CACHE_MANIFEST_ENTRIES
+# define VL_COMPILE_CACHE_MANIFEST_ENTRIES 8 /* header sets kept per key, each branch that changes them adds one */
+#endif
+
+static u64 VL__compileCacheStored = 0; /* bytes since the last trim */
+static bool VL__compileCacheTrimmed = false;
+
+static const char *VL__CompileCacheDir(void)
+{
+    static bool ready = false;
+    if(!VL_compileCache.dir) VL_compileCache.dir = getenv("VL_COMPILE_CACHE_DIR");
+    if(!VL_compileCache.dir || !*VL_compileCache.dir) return NULL;
+    if(!ready) {
+        if(!MkdirIfNotExist(VL_compileCache.dir)) {
+            VL_compileCache.dir = NULL;
+            return NULL;
+        }
+        ready = true;
+    }
+    return VL_compileCache.dir;
+}
+
+// Hash of the compiler's toolchain or version output, once per compiler per process
+static bool VL__CompileCacheCompilerId(vl_c_compiler cc, u64 *id)
+{
+    // NOTE: One per vl_c_compiler
+    static u64 ids[4];
+    static bool known[4];
+    if(known[cc]) {
+        *id = ids[cc];
+        return true;
+    }
+
+    vl_toolchain *tc = VL_GetToolchain(cc);
+    if(tc) {
+        vl_hash_state state;
+        VL_HashBegin(&state, (u64)cc);
+        VL_HashUpdate(&state, tc->path, strlen(tc->path) + 1);
+        VL_HashUpdate(&state, tc->version, strlen(tc->version) + 1);
+        VL_HashUpdate(&state, tc->target, strlen(tc->target) + 1);
+        VL_HashUpdate(&state, &tc->mtime, sizeof(tc->mtime));
+        VL_HashUpdate(&state, &tc->size, sizeof(tc->size));
+        ids[cc] = VL_HashEnd(&state);
+        known[cc] = true;
+        *id = ids[cc];
+        return true;
+    }
+
+    vl_cmd cmd = {0};
+    VL_cc_Opt((struct compiler_info_opts){.cmd = &cmd, .cc = cc});
+    // NOTE: cl prints its version to stderr when run without arguments
+    if(cc != CCompiler_MSVC) CmdAppend(&cmd, "--version");
+    const char *versionPath = temp_sprintf("%s/compiler-version.%d.tmp", VL_compileCache.dir, (int)cc);
+    const char *name = cmd.items[0];
+    VL_Log(VL_INFO, "compile cache: getting the version of %s", name);
+    if(cc == CCompiler_MSVC) CmdRun(&cmd, .stderrPath = versionPath, .stdoutPath = "/dev/null");
+    else CmdRun(&cmd, .stdoutPath = versionPath, .stderrPath = "/dev/null");
+    CmdFree(cmd);
+
+    string_builder version = {0};
+    bool result = SbReadEntireFile(versionPath, &version) && version.count > 0;
+    if(result) {
+        ids[cc] = VL_HashBytes(version.items, version.count, (u64)cc);
+        known[cc] = true;
+        *id = ids[cc];
+    }
+    SbFree(version);
+    VL_DeleteFile(versionPath);
+    return result;
+}
+
+static bool VL__CompileCacheUsable(vl_compile_ctx *ctx, bool depFile)
+{
+    // NOTE: The precompiled header and profiles aren't part of the key
+    return depFile && ctx->sourceFiles.count == 1 && !VL__UsesPch(ctx) && ctx->pgo == Pgo_None &&
+           (ctx->type == Compile_Object || ctx->type == Compile_StaticLibrary) &&
+           VL__CompileCacheDir() != NULL;
+}
+
+static bool VL__CompileCacheKey(vl_compile_ctx *ctx, u64 *key)
+{
+    u64 compilerId, sourceHash;
+    if(!VL__CompileCacheCompilerId(ctx->cc, &compilerId)) return false;
+    if(!VL_HashFile(ctx->sourceFiles.items[0], &sourceHash)) return false;
+
+    vl_cmd cmd = {0};
+    VL__CCompileCmd(ctx, &cmd, false);
+    // NOTE: The output path doesn't change the object, so every build directory shares the entries
+    const char *output = VL_GetFilePathFromCompileCtx(ctx);
+    size_t kept = 0;
+    for(size_t i = 0; i < cmd.count; i++) {
+        const char *arg = cmd.items[i];
+        if(strcmp(arg, "-o") == 0 && i + 1 < cmd.count && strcmp(cmd.items[i + 1], output) == 0) {
+            i++;
+            continue;
+        }
+        if(strncmp(arg, "-Fo:", 4) == 0 && strcmp(arg + 4, output) == 0) continue;
+        cmd.items[kept++] = arg;
+    }
+    cmd.count = kept;
+
+    string_builder rendered = {0};
+    VL_CmdRender(cmd, &rendered);
+    vl_hash_state state;
+    VL_HashBegin(&state, VL__COMPILE_CACHE_VERSION);
+    VL_HashUpdate(&state, rendered.items, rendered.count);
+    VL_HashUpdate(&state, &compilerId, sizeof(compilerId));
+    VL_HashUpdate(&state, &sourceHash, sizeof(sourceHash));
+    if(ctx->debug) {
+        // NOTE: Debug info has the compile directory in it
+        const char *cwd = VL_temp_GetCurrentDir();
+        if(cwd) VL_HashUpdate(&state, cwd, strlen(cwd));
+    }
+    *key = VL_HashEnd(&state);
+    SbFree(rendered);
+    CmdFree(cmd);
+    return true;
+}
+
+/* Manifest "<dir>/<key>.manifest", one entry per header set:
+ * r <result> <header count>
+ * <content hash> <header path>
+ */
+static bool VL__CompileCacheLookup(u64 key, u64 *result)
+{
+    const char *manifestPath = temp_sprintf("%s/%016llx.manifest", VL_compileCache.dir, (unsigned long long)key);
+    vl_file_stat manifestStat;
+    if(!VL_GetFileStat(manifestPath, &manifestStat)) return false;
+    string_builder data = {0};
+    if(!SbReadEntireFile(manifestPath, &data)) return false;
+
+    bool found = false;
+    view rest = ViewFromParts(data.items, data.count);
+    while(rest.count > 0) {
+        view line = ViewChopByDelim(&rest, '\n');
+        u64 entryResult, headerCount;
+        if(!ViewChopStartsWith(&line, VIEW("r ")) || !VL__ChopHex64(&line, &entryResult) ||
+           !VL__ChopU64(&line, &headerCount)) break;
+        bool matches = true;
+        for(u64 i = 0; i < headerCount && rest.count > 0; i++) {
+            view header = ViewChopByDelim(&rest, '\n');
+            u64 recorded, current;
+            if(!matches) continue;
+            if(!VL__ChopHex64(&header, &recorded) || header.count == 0) {
+                matches = false;
+                continue;
+            }
+            const char *path = temp_strndup(header.items, header.count);
+            if(!VL_GetFileStatCached(path, &manifestStat) || !VL_HashFile(path, &current) || current != recorded) {
+                matches = false;
+            }
+        }
+        // NOTE: Later entries are newer
+        if(matches) {
+            *result = entryResult;
+            found = true;
+        }
+    }
+    SbFree(data);
+    return found;
+}
+
+static void VL__TouchFile(const char *path)
+{
+#if OS_WINDOWS
+    HANDLE file = CreateFileA(path, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE) return;
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    SetFileTime(file, NULL, NULL, &now);
+    CloseHandle(file);
+#else
+    utimensat(AT_FDCWD, path, NULL, 0);
+#endif
+}
+
+static bool VL__CompileCacheRestore(u64 result, const char *output, const char *depPath)
+{
+    const char *cachedObject = temp_sprintf("%s/%016llx.o", VL_compileCache.dir, (unsigned long long)result);
+    const char *cachedDeps = temp_sprintf("%s/%016llx.d", VL_compileCache.dir, (unsigned long long)result);
+    vl_file_stat fileStat;
+    if(!VL_GetFileStat(cachedObject, &fileStat) || !VL_GetFileStat(cachedDeps, &fileStat)) return false;
+    if(!VL_CopyFile(cachedObject, output) || !VL_CopyFile(cachedDeps, depPath)) return false;
+    // NOTE: The mtime is the last use, for VL_CompileCacheTrim
+    VL__TouchFile(cachedObject);
+    VL__TouchFile(cachedDeps);
+    return true;
+}
+
+// Copies to a temporary name first so other builds never see a half written file
+static bool VL__CompileCacheCopyIn(const char *src, const char *dst)
+{
+    const char *tmp = temp_sprintf("%s.%d.tmp", dst, VL__ProcessId());
+    if(!VL_CopyFile(src, tmp)) return false;
+    if(!VL_Rename(tmp, dst)) {
+        VL_DeleteFile(tmp);
+        return false;
+    }
+    vl_file_stat fileStat;
+    if(VL_GetFileStat(dst, &fileStat)) VL__compileCacheStored += fileStat.size;
+    return true;
+}
+
+static void VL__CompileCacheStore(vl_compile_ctx *ctx, u64 key, const char *output)
+{
+    const char *depPath = VL_GetDepFilePathFromCompileCtx(ctx);
+    string_builder data = {0};
+    vl_file_paths headers = {0};
+    string_builder entry = {0};
+    string_builder manifest = {0};
+    if(!SbReadEntireFile(depPath, &data)) goto defer;
+    DaAppend(&data, '\0');
+    VL__ParseDeps(ctx, data.items, data.count - 1, &headers);
+
+    vl_hash_state state;
+    VL_HashBegin(&state, key);
+    for(size_t i = 0; i < headers.count; i++) {
+        u64 hash;
+        if(!VL_HashFile(headers.items[i], &hash)) goto defer;
+        SbAppendf(&entry, "%016llx %s\n", (unsigned long long)hash, headers.items[i]);
+    }
+    VL_HashUpdate(&state, entry.items, entry.count);
+    u64 result = VL_HashEnd(&state);
+
+    const char *dir = VL_compileCache.dir;
+    if(!VL__CompileCacheCopyIn(output, temp_sprintf("%s/%016llx.o", dir, (unsigned long long)result)) ||
+       !VL__CompileCacheCopyIn(depPath, temp_sprintf("%s/%016llx.d", dir, (unsigned long long)result))) {
+        goto defer;
+    }
+
+    // NOTE: Keeps the newest entries of the old manifest
+    const char *manifestPath = temp_sprintf("%s/%016llx.manifest", dir, (unsigned long long)key);
+    vl_file_stat manifestStat;
+    data.count = 0;
+    if(VL_GetFileStat(manifestPath, &manifestStat) && SbReadEntireFile(manifestPath, &data)) {
+        view rest = ViewFromParts(data.items, data.count);
+        size_t entries = 0;
+        for(view it = rest; it.count > 0;) {
+            if(ViewStartsWith(ViewChopByDelim(&it, '\n'), VIEW("r "))) entries++;
+        }
+        while(rest.count > 0) {
+            view line = ViewChopByDelim(&rest, '\n');
+            if(ViewStartsWith(line, VIEW("r "))) entries--;
+            if(entries < VL_COMPILE_CACHE_MANIFEST_ENTRIES - 1) SbAppendf(&manifest, VIEW_FMT"\n", VIEW_ARG(line));
+        }
+    }
+    SbAppendf(&manifest, "r %016llx %zu\n", (unsigned long long)result, headers.count);
+    SbAppendBuf(&manifest, entry.items, entry.count);
+    const char *tmp = temp_sprintf("%s.%d.tmp", manifestPath, VL__ProcessId());
+    if(WriteEntireFile(tmp, manifest.items, manifest.count) && VL_Rename(tmp, manifestPath)) {
+        VL_compileCache.stores++;
+    }
+
+    u64 maxSize = VL_compileCache.maxSize ? VL_compileCache.maxSize : (u64)5*1024*1024*1024;
+    if(!VL__compileCacheTrimmed || VL__compileCacheStored > maxSize/16) VL_CompileCacheTrim();
+
+defer:
+    SbFree(data);
+    DaFree(headers);
+    SbFree(entry);
+    SbFree(manifest);
+}
+
+typedef struct {
+    size_t name; /* offset in the names builder */
+    u64 mtime;
+    u64 size;
+} vl__cache_file;
+
+static bool VL__CacheFileOlder(const void *a, const void *b)
+{
+    return ((const vl__cache_file*)a)->mtime < ((const vl__cache_file*)b)->mtime;
+}
+
+VLIBPROC bool VL_CompileCacheTrim(void)
+{
+    const char *dir = VL__CompileCacheDir();
+    if(!dir) return false;
+    VL__compileCacheTrimmed = true;
+    VL__compileCacheStored = 0;
+    u64 maxSize = VL_compileCache.maxSize ? VL_compileCache.maxSize : (u64)5*1024*1024*1024;
+
+    struct {
+        vl__cache_file *items;
+        size_t count;
+        size_t capacity;
+    } files = {0};
+    string_builder names = {0};
+    u64 total = 0;
+    vl_dir_iter it;
+    if(!VL_DirIterOpen(&it, dir)) return false;
+    while(VL_DirIterNext(&it)) {
+        vl_file_stat fileStat;
+        if(it.entry.type != VL_FILE_REGULAR || !VL_DirIterStat(&it, &fileStat)) continue;
+        vl__cache_file file = { .name = names.count, .mtime = fileStat.mtime, .size = fileStat.size };
+        SbAppendBuf(&names, it.entry.name.items, it.entry.name.count);
+        DaAppend(&names, '\0');
+        DaAppend(&files, file);
+        total += fileStat.size;
+    }
+    VL_DirIterClose(&it);
+
+    bool result = true;
+    if(total > maxSize) {
+        Sort(files.items, files.count, sizeof(vl__cache_file), VL__CacheFileOlder);
+        for(size_t i = 0; i < files.count && total > maxSize/10*9; i++) {
+            if(!VL_DeleteFile(temp_sprintf("%s/%s", dir, names.items + files.items[i].name))) {
+                result = false;
+                continue;
+            }
+            total -= files.items[i].size;
+            VL_compileCache.evictions++;
+        }
+    }
+    DaFree(files);
+    SbFree(names);
+    return result;
+}
+
+VLIBPROC void VL_CompileCacheLogStats(void)
+{
+    size_t lookups = VL_compileCache.hits + VL_compileCache.misses;
+    VL_Log(VL_INFO, "compile cache: %zu hits, %zu misses (%.1f%% hit rate), %zu stored, %zu evicted",
+           VL_compileCache.hits, VL_compileCache.misses,
+           lookups ? 100.0*(double)VL_compileCache.hits/(double)lookups : 0.0,
+           VL_compileCache.stores, VL_compileCache.evictions);
+}
+
+/* doneOnEnd: the caller calls VL__CCompileDone once the process ended (it ran synchronously or the caller
+   reaps it like the job lists do), so the msvc includes can be split from stdout and the object cached */
+static bool VL__CCompileRun(vl_compile_ctx *ctx, vl_cmd_opts opt, vl__compile_step *step, bool doneOnEnd)
+{
+    // NOTE: /showIncludes is mixed with the diagnostics in stdout
+    bool depFile = VL__CompileUsesDepFile(ctx);
+    if(ctx->cc == CCompiler_MSVC && (!doneOnEnd || opt.stdoutPath)) depFile = false;
+    // NOTE: The one from a check could miss includes added since, the next check asks the compiler again
+    if(!depFile && VL__ChecksDepFile(ctx)) remove(VL_GetDepFilePathFromCompileCtx(ctx));
+
+    VL__CCompileCmd(ctx, opt.cmd, depFile);
+    step->output = VL_GetFilePathFromCompileCtx(ctx);
+    step->commandHash = 0;
+    if(VL_needsRebuildContext.contentHash) {
+        // NOTE: Without the depfile flags, they don't change the output
+        vl_cmd hashCmd = {0};
+        VL__CCompileCmd(ctx, &hashCmd, false);
+        step->commandHash = VL__CmdHash(&hashCmd, 0);
+        CmdFree(hashCmd);
+    }
+
+    step->captured = 0;
+    step->cacheKey = 0;
+    step->cached = false;
+    size_t traceEvent = VL__CompileCacheUsable(ctx, depFile) ? VL_TraceBegin("cache", step->output) : VL__TRACE_NONE;
+    if(VL__CompileCacheUsable(ctx, depFile) && VL__CompileCacheKey(ctx, &step->cacheKey)) {
+        u64 result;
+        bool hit = VL__CompileCacheLookup(step->cacheKey, &result) &&
+                   VL__CompileCacheRestore(result, step->output, VL_GetDepFilePathFromCompileCtx(ctx));
+        VL_TraceEnd(traceEvent);
+        if(hit) {
+            VL_compileCache.hits++;
+            VL_Log(VL_INFO, "CACHED: %s", step->output);
+            step->cached = true;
+            opt.cmd->count = 0;
+#if OS_WINDOWS
+            opt.cmd->msvc_linkflags = 0;
+#endif
+            return true;
+        }
+        VL_compileCache.misses++;
+        if(!doneOnEnd) step->cacheKey = 0;
+    } else {
+        VL_TraceEnd(traceEvent);
+    }
+
+    if(depFile && ctx->cc == CCompiler_MSVC) {
+        step->captured = temp_sprintf("%s.includes", step->output);
+        opt.stdoutPath = step->captured;
+    }
+    return CmdRun_Opt(opt);
+}
+
+static void VL__CCompileDone(vl_compile_ctx *ctx, vl__compile_step *step, bool ok)
+{
+    if(step->captured) VL__WriteMsvcDepFile(ctx, step->captured, ok);
+    if(ok && step->cacheKey && !step->cached) {
+        size_t traceEvent = VL_TraceBegin("cache", temp_sprintf("store %s", step->output));
+        VL__CompileCacheStore(ctx, step->cacheKey, step->output);
+        VL_TraceEnd(traceEvent);
+    }
+    if(ok && VL_needsRebuildContext.contentHash) {
+        VL__BuildDbCommitCompile(ctx, step->output, step->commandHash);
+    }
+    VL_FileTimeInvalidate(step->output);
+}
+
+// Lto objects need an archiver that writes their symbols to the index
+static void VL__ArchiverCmd(vl_compile_ctx *ctx, vl_cmd *cmd)
+{
+    if(ctx->cc == CCompiler_MSVC) {
+        CmdAppend(cmd, "lib", "-nologo");
+        if(ctx->lto != Lto_None || ctx->pgo != Pgo_None) CmdAppend(cmd, "/LTCG");
+    } else if(ctx->lto != Lto_None && ctx->cc == CCompiler_GCC) {
+        CmdAppend(cmd, "gcc-ar");
+    } else if(ctx->lto != Lto_None && ctx->cc == CCompiler_Clang) {
+        static int found = 0; // NOTE: 0 not checked, 1 found, 2 not found
+        if(found == 0) found = VL_temp_FindExecutable("llvm-ar") ? 1 : 2;
+        CmdAppend(cmd, found == 1 ? "llvm-ar" : "ar");
+    } else {
+        CmdAppend(cmd, "ar");
+    }
+}
+
+/* Archive of separateObjects, updated in place with the objects newer than it and the pending ones, built
+   before it runs (ar r replaces the members with their name, lib takes the library as an input),
+   or made from all of them when remake is set */
+static void VL__SeparateArchiveCmd(vl_compile_ctx *ctx, vl_cmd *cmd, vl_file_paths objects, const char *final,
+                                   bool remake, vl_file_paths pending)
+{
+    VL__ArchiverCmd(ctx, cmd);
+    if(ctx->cc == CCompiler_MSVC) {
+        CmdAppend(cmd, temp_sprintf("/OUT:%s", final));
+        if(!remake) CmdAppend(cmd, final);
+    } else {
+        CmdAppend(cmd, ctx->thinArchive ? "rcsT" : "rcs", final);
+    }
+    for(size_t i = 0; i < objects.count; i++) {
+        bool add = remake || VL__NeedsRebuildMtime(final, &objects.items[i], 1) != 0;
+        for(size_t j = 0; !add && j < pending.count; j++) add = strcmp(objects.items[i], pending.items[j]) == 0;
+        if(add) DaAppend(cmd, objects.items[i]);
+    }
+}
+
+static void VL__ObjectListWrite(vl_file_paths objects, const char *final)
+{
+    string_builder list = {0};
+    VL__ObjectList(objects, &list);
+    VL__WriteFileIfChanged(temp_sprintf("%s.objects", final), &list);
+    SbFree(list);
+}
+
+/* Before a remake (VL__ObjectsChanged): the old output is deleted so a failed link or archive isn't taken
+   as up to date, and the new list is written */
+static void VL__SeparateLinkRemake(vl_file_paths objects, const char *final)
+{
+    if(VL_FileExists(final)) VL_DeleteFile(final);
+    VL__ObjectListWrite(objects, final);
+}
+
+/* remake: static libraries are archived from all the objects instead of only the ones that changed.
+   pending: objects that will be built before the command runs, they're archived too */
+static void VL__SeparateLinkCmd(vl_compile_ctx *ctx, vl_cmd *cmd, vl_file_paths objects, const char *final,
+                                bool remake, vl_file_paths pending)
+{
+    if(ctx->type == Compile_StaticLibrary) {
+        VL__SeparateArchiveCmd(ctx, cmd, objects, final, remake, pending);
+    } else {
+        vl_compile_ctx linkCtx = *ctx;
+        linkCtx.sourceFiles = objects;
+        linkCtx.precompiledHeader = NULL;
+        VL__CCompileCmd(&linkCtx, cmd, false);
+    }
+}
+
+typedef struct {
+    vl_proc proc;
+    vl_compile_ctx ctx;
+    vl__compile_step step;
+} vl__compile_job;
+
+typedef struct {
+    vl__compile_job *items;
+    size_t count;
+    size_t capacity;
+} vl__compile_jobs;
+
+// Waits for whichever job finishes first
+static bool VL__CompileJobsReap(vl__compile_jobs *jobs, vl_procs *procs)
+{
+    procs->count = 0;
+    for(size_t i = 0; i < jobs->count; i++) DaAppend(procs, jobs->items[i].proc);
+    bool ok;
+    size_t i = VL_ProcsWaitAny(*procs, &ok);
+    VL__CCompileDone(&jobs->items[i].ctx, &jobs->items[i].step, ok);
+    DaRemoveUnordered(jobs, i);
+    return ok;
+}
+
+// Builds the precompiled header of ctx if it's out of date, before the compiles using it
+static bool VL__PchBuild(vl_compile_ctx *ctx, vl_cmd_opts opt)
+{
+    vl_compile_ctx pchCtx;
+    bool result = VL__PchCompileCtx(ctx, &pchCtx);
+    if(result && VL_Needs_C_Rebuild(opt.cmd, &pchCtx) != 0) {
+        vl__compile_step step;
+        opt.async = 0;
+        result = VL__CCompileRun(&pchCtx, opt, &step, true);
+        VL__CCompileDone(&pchCtx, &step, result);
+    }
+    opt.cmd->count = 0;
+    DaFree(pchCtx.sourceFiles);
+    return result;
+}
+
+static bool VL__CCompileSeparate(vl_compile_ctx *ctx, vl_cmd_opts opt)
+{
+    if(ctx->unityBatchSize > 0) {
+        vl_compile_ctx unityCtx;
+        bool ok = VL__UnityCtx(ctx, &unityCtx) && VL__CCompileSeparate(&unityCtx, opt);
+        DaFree(unityCtx.sourceFiles);
+        opt.cmd->count = 0;
+        return ok;
+    }
+    if(VL__UsesPch(ctx) && !ctx->targetOutput && !VL__PchBuild(ctx, opt)) return false;
+    bool result = true;
+    size_t maxJobs = opt.maxProcs > 0 ? opt.maxProcs : (size_t)VL_GetCountProcs();
+    vl_file_paths objects = {0};
+    vl__compile_jobs jobs = {0};
+    vl_procs procs = {0};
+    const char *final = VL__SeparateObjects(ctx, &objects);
+
+    for(size_t i = 0; i < ctx->sourceFiles.count; i++) {
+        vl__compile_job job = {0};
+        job.ctx = VL__ObjectCompileCtx(ctx, i);
+        int needsRebuild = VL_Needs_C_Rebuild(opt.cmd, &job.ctx);
+        if(needsRebuild == 0) continue;
+
+        while(jobs.count >= maxJobs) {
+            if(!VL__CompileJobsReap(&jobs, &procs)) result = false;
+        }
+        // NOTE: Stop starting compiles after an error, like make without -k
+        if(!result) break;
+
+        vl_cmd_opts jobOpt = opt;
+        procs.count = 0;
+        jobOpt.async = &procs;
+        jobOpt.maxProcs = 0;
+        jobOpt.captureOutput = true;
+        if(!VL__CCompileRun(&job.ctx, jobOpt, &job.step, true)) {
+            VL__CCompileDone(&job.ctx, &job.step, false);
+            result = false;
+            break;
+        }
+        if(job.step.cached) {
+            VL__CCompileDone(&job.ctx, &job.step, true);
+            continue;
+        }
+        job.proc = procs.items[0];
+        DaAppend(&jobs, job);
+    }
+    while(jobs.count > 0) {
+        if(!VL__CompileJobsReap(&jobs, &procs)) result = false;
+    }
+    if(!result) VL_ReturnDefer(false);
+
+    bool remake = VL__ObjectsChanged(ctx, objects, final);
+    if(!remake && VL_NeedsRebuild_Impl(final, objects.items, objects.count) == 0) VL_ReturnDefer(true);
+
+    if(remake) VL__SeparateLinkRemake(objects, final);
+    VL__SeparateLinkCmd(ctx, opt.cmd, objects, final, remake, (vl_file_paths){0});
+    // NOTE: The archive/link waits for the objects anyway
+    opt.async = 0;
+    result = CmdRun_Opt(opt);
+    VL_FileTimeInvalidate(final);
+
+defer:
+    opt.cmd->count = 0;
+    DaFree(objects);
+    DaFree(jobs);
+    DaFree(procs);
+    return result;
+}
+
+VLIBPROC bool VL_CCompile_Opt(vl_compile_ctx *ctx, vl_cmd_opts opt)
+{
+    if(VL__CompilesSeparately(ctx)) return VL__CCompileSeparate(ctx, opt);
+    if(VL__UsesPch(ctx) && !ctx->targetOutput && !VL__PchBuild(ctx, opt)) return false;
+
+    vl__compile_step step;
+    bool ok = VL__CCompileRun(ctx, opt, &step, !opt.async);
+    if(opt.async && !step.cached) {
+        // NOTE: Async results are not known here, so those outputs are not recorded.
+        // The output is still being written, it's stat'ed again on the next check anyway
+        VL_FileTimeInvalidate(step.output);
+    } else {
+        VL__CCompileDone(ctx, &step, ok);
+    }
+    return ok;
+}
+
+// The instrumented build of VL_PgoBuild, ctx built in its profileDir
+static vl_compile_ctx VL__PgoInstrumentedCtx(vl_compile_ctx *ctx)
+{
+    if(!ctx->outputDir) ctx->outputDir = ".";
+    vl_compile_ctx instrCtx = *ctx;
+    instrCtx.profileDir = VL__ProfileDir(ctx);
+    instrCtx.outputDir = instrCtx.profileDir;
+    instrCtx.pgo = Pgo_Generate;
+    return instrCtx;
+}
+
+VLIBPROC const char *VL_PgoInstrumentedPath(vl_compile_ctx *ctx)
+{
+    vl_compile_ctx instrCtx = VL__PgoInstrumentedCtx(ctx);
+    if(ctx->type == Compile_StaticLibrary) return VL__StaticLibPath(&instrCtx);
+    return VL_GetFilePathFromCompileCtx(&instrCtx);
+}
+
+// Deletes the profiles of the last training, gcc adds the counters of a run to the .gcda files there
+static void VL__PgoClean(const char *profileDir, const char *ext)
+{
+    vl_dir_iter it;
+    if(!VL_DirIterOpen(&it, profileDir, .ext = ext)) return;
+    while(VL_DirIterNext(&it)) {
+        VL_DeleteFile(temp_sprintf("%s/%s", profileDir, it.entry.name.items));
+    }
+    VL_DirIterClose(&it);
+}
+
+/* Puts the profiles of the training where the optimized build reads them: the .profraw files are merged
+   with llvm-profdata and the .gcda ones copied next to the objects, they're named after them.
+   msvc's linker merges the .pgc files next to the .pgd itself */
+static bool VL__PgoMerge(vl_compile_ctx *ctx, const char *profileDir, vl_cmd *cmd)
+{
+    if((ctx->cc != CCompiler_GCC) && (ctx->cc != CCompiler_Clang)) return true;
+
+    cmd->count = 0;
+    if(ctx->cc == CCompiler_Clang) {
+        CmdAppend(cmd, "llvm-profdata", "merge", temp_sprintf("-output=%s/default.profdata", profileDir));
+    }
+    vl_dir_iter it;
+    if(!VL_DirIterOpen(&it, profileDir, .ext = ctx->cc == CCompiler_Clang ? ".profraw" : ".gcda")) return false;
+    bool result = true;
+    while(result && VL_DirIterNext(&it)) {
+        const char *path = temp_sprintf("%s/%s", profileDir, it.entry.name.items);
+        if(ctx->cc == CCompiler_Clang) {
+            CmdAppend(cmd, path);
+        } else {
+            result = VL_CopyFile(path, temp_sprintf("%s/%s", ctx->outputDir, it.entry.name.items));
+        }
+    }
+    if(it.failed) result = false;
+    VL_DirIterClose(&it);
+
+    if(result && ctx->cc == CCompiler_Clang) result = CmdRun(cmd);
+    cmd->count = 0;
+    return result;
+}
+
+VLIBPROC bool VL_PgoBuild_Opt(struct VL_PgoBuild_opts opt)
+{
+    vl_compile_ctx *ctx = opt.ctx;
+    bool result = true;
+    vl_file_paths deps = {0};
+    vl_cmd training = {0};
+    string_builder stamp = {0};
+    vl_compile_ctx instrCtx = VL__PgoInstrumentedCtx(ctx);
+    const char *profileDir = instrCtx.profileDir;
+    vl_compile_ctx useCtx = *ctx;
+
+    if(ctx->cc == CCompiler_TCC) {
+        VL_Log(VL_WARNING, "tcc doesn't support profile guided optimization, building %s without it", ctx->output);
+        useCtx.pgo = Pgo_None;
+        if(VL_Needs_C_Rebuild(opt.cmd, &useCtx) != 0) result = VL_CCompile(opt.cmd, &useCtx, .maxProcs = opt.maxProcs);
+        VL_ReturnDefer(result);
+    }
+    if(!MkdirIfNotExist(profileDir)) VL_ReturnDefer(false);
+
+    int instrRebuild = VL_Needs_C_Rebuild(opt.cmd, &instrCtx);
+    if(instrRebuild != 0 && !VL_CCompile(opt.cmd, &instrCtx, .maxProcs = opt.maxProcs)) VL_ReturnDefer(false);
+
+    // NOTE: Written after the profiles with the hash of the training command, the optimized build depends on it
+    const char *stampPath = temp_sprintf("%s/%s.trained", profileDir, ctx->output);
+    const char *hash = temp_sprintf("%016llx\n", (unsigned long long)VL__CmdHash(&opt.training, 0));
+    const char *instrumented = VL_PgoInstrumentedPath(ctx);
+    bool train = instrRebuild != 0 || !VL_FileExists(stampPath) || !SbReadEntireFile(stampPath, &stamp) ||
+                 stamp.count != strlen(hash) || memcmp(stamp.items, hash, stamp.count) != 0 ||
+                 VL_NeedsRebuild_Impl(stampPath, &instrumented, 1) != 0;
+    if(train) {
+        VL__PgoClean(profileDir, ctx->cc == CCompiler_MSVC ? ".pgc" : (ctx->cc == CCompiler_Clang ? ".profraw" : ".gcda"));
+        DaAppendMany(&training, opt.training.items, opt.training.count);
+        if(!CmdRun(&training)) {
+            VL_Log(VL_ERROR, "Training run for %s failed", ctx->output);
+            VL_ReturnDefer(false);
+        }
+        if(!VL__PgoMerge(ctx, profileDir, opt.cmd)) VL_ReturnDefer(false);
+        if(!VL__WriteFileAtomic(stampPath, hash, strlen(hash))) {
+            VL_Log(VL_ERROR, "Could not write %s: %s", stampPath, VL_GetError());
+            VL_ReturnDefer(false);
+        }
+        VL_FileTimeInvalidate(stampPath);
+    }
+
+    useCtx.pgo = Pgo_Use;
+    useCtx.profileDir = profileDir;
+    DaAppendMany(&deps, ctx->extraDependencies.items, ctx->extraDependencies.count);
+    DaAppend(&deps, stampPath);
+    useCtx.extraDependencies = deps;
+    if(VL_Needs_C_Rebuild(opt.cmd, &useCtx) != 0) result = VL_CCompile(opt.cmd, &useCtx, .maxProcs = opt.maxProcs);
+
+defer:
+    DaFree(deps);
+    CmdFree(training);
+    SbFree(stamp);
+    return result;
+}
+
+static const char *VL__IsaName(vl_isa isa)
+{
+    static const char *names[] = {"baseline", "x86-64-v1", "x86-64-v2", "x86-64-v3", "x86-64-v4", "armv8.2-a"};
+    return names[isa];
+}
+
+// What the generated header checks the cpu with, after the tables of the variants
+static const char VL__isaDispatchCode[] =
+    "#if defined(__x86_64__) || defined(_M_X64)\n"
+    "# if defined(_MSC_VER)\n"
+    "#  include <intrin.h>\n"
+    "# else\n"
+    "#  include <cpuid.h>\n"
+    "# endif\n"
+    "static void VL_IsaCpuid(unsigned leaf, unsigned r[4])\n"
+    "{\n"
+    "# if defined(_MSC_VER)\n"
+    "    __cpuidex((int*)r, (int)leaf, 0);\n"
+    "# else\n"
+    "    __cpuid_count(leaf, 0, r[0], r[1], r[2], r[3]);\n"
+    "# endif\n"
+    "}\n"
+    "\n"
+    "static unsigned long long VL_IsaXcr0(void)\n"
+    "{\n"
+    "# if defined(_MSC_VER)\n"
+    "    return _xgetbv(0);\n"
+    "# else\n"
+    "    unsigned lo, hi;\n"
+    "    __asm__ volatile(\"xgetbv\" : \"=a\"(lo), \"=d\"(hi) : \"c\"(0));\n"
+    "    return ((unsigned long long)hi << 32) | lo;\n"
+    "# endif\n"
+    "}\n"
+    "\n"
+    "#define VL_ISA_HAS(reg, bits) (((reg) & (bits)) == (bits))\n"
+    "// The x86-64 microarchitecture level of this cpu, 1 to 4\n"
+    "static int VL_IsaX86Level(void)\n"
+    "{\n"
+    "    unsigned r0[4], r1[4], r7[4] = {0}, ext[4] = {0};\n"
+    "    VL_IsaCpuid(0, r0);\n"
+    "    VL_IsaCpuid(1, r1);\n"
+    "    if(r0[0] >= 7) VL_IsaCpuid(7, r7);\n"
+    "    VL_IsaCpuid(0x80000000u, ext);\n"
+    "    if(ext[0] >= 0x80000001u) VL_IsaCpuid(0x80000001u, ext);\n"
+    "    else ext[2] = 0;\n"
+    "    /* sse3, ssse3, cmpxchg16b, sse4.1, sse4.2, popcnt and lahf */\n"
+    "    if(!VL_ISA_HAS(r1[2], (1u<<0)|(1u<<9)|(1u<<13)|(1u<<19)|(1u<<20)|(1u<<23)) || !(ext[2] & 1u)) return 1;\n"
+    "    /* fma, movbe, osxsave, avx, f16c, bmi1, avx2, bmi2, lzcnt and the os saving the ymm registers */\n"
+    "    if(!VL_ISA_HAS(r1[2], (1u<<12)|(1u<<22)|(1u<<27)|(1u<<28)|(1u<<29)) ||\n"
+    "       !VL_ISA_HAS(r7[1], (1u<<3)|(1u<<5)|(1u<<8)) || !(ext[2] & (1u<<5))) return 2;\n"
+    "    unsigned long long xcr0 = VL_IsaXcr0();\n"
+    "    if((xcr0 & 0x6) != 0x6) return 2;\n"
+    "    /* avx512 f, dq, cd, bw and vl and the os saving the zmm registers */\n"
+    "    if(!VL_ISA_HAS(r7[1], (1u<<16)|(1u<<17)|(1u<<28)|(1u<<30)|(1u<<31)) || (xcr0 & 0xe6) != 0xe6) return 3;\n"
+    "    return 4;\n"
+    "}\n"
+    "#elif defined(__aarch64__) || defined(_M_ARM64)\n"
+    "# if defined(__linux__)\n"
+    "#  include <sys/auxv.h>\n"
+    "# elif defined(_WIN32)\n"
+    "#  include <windows.h>\n"
+    "# endif\n"
+    "static int VL_IsaArmv82(void)\n"
+    "{\n"
+    "# if defined(__APPLE__)\n"
+    "    return 1; /* every apple cpu is armv8.4 or newer */\n"
+    "# elif defined(__linux__)\n"
+    "    /* atomics and rdm (armv8.1), dcpop (armv8.2) */\n"
+    "    unsigned long bits = (1ul<<8)|(1ul<<12)|(1ul<<16);\n"
+    "    return (getauxval(AT_HWCAP) & bits) == bits;\n"
+    "# elif defined(_WIN32)\n"
+    "    return IsProcessorFeaturePresent(43); /* PF_ARM_V82_DP_INSTRUCTIONS_AVAILABLE */\n"
+    "# else\n"
+    "    return 0;\n"
+    "# endif\n"
+    "}\n"
+    "#endif\n"
+    "\n"
+    "static int VL_IsaSupported(int isa)\n"
+    "{\n"
+    "    if(isa == 0) return 1;\n"
+    "#if defined(__x86_64__) || defined(_M_X64)\n"
+    "    if(isa >= 1 && isa <= 4) return VL_IsaX86Level() >= isa;\n"
+    "#elif defined(__aarch64__) || defined(_M_ARM64)\n"
+    "    if(isa == 5) return VL_IsaArmv82();\n"
+    "#endif\n"
+    "    return 0;\n"
+    "}\n"
+    "\n"
+    "static const char *VL_IsaBestVariant(void)\n"
+    "{\n"
+    "    for(int i = 0; i < (int)(sizeof(VL_isaVariantIsas)/sizeof(VL_isaVariantIsas[0])); i++) {\n"
+    "        if(VL_IsaSupported(VL_isaVariantIsas[i])) return VL_isaVariants[i];\n"
+    "    }\n"
+    "    return 0;\n"
+    "}\n";
+
+// The launcher of executable variants, "%s" is the name of the generated header
+static const char VL__isaLauncherCode[] =
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "#if defined(_WIN32)\n"
+    "# include <windows.h>\n"
+    "# include <process.h>\n"
+    "#else\n"
+    "# include <unistd.h>\n"
+    "#endif\n"
+    "#include \"%s\"\n"
+    "\n"
+    "#if defined(_WIN32)\n"
+    "/* _spawnv joins the arguments with spaces, so they're quoted for the command line parser of the variant */\n"
+    "static char *VL_QuoteArg(const char *arg)\n"
+    "{\n"
+    "    size_t len = strlen(arg);\n"
+    "    char *quoted = (char*)malloc(2*len + 3);\n"
+    "    if(!quoted) return 0;\n"
+    "    if(len != 0 && !strpbrk(arg, \" \\t\\n\\v\\\"\")) {\n"
+    "        memcpy(quoted, arg, len + 1);\n"
+    "        return quoted;\n"
+    "    }\n"
+    "    size_t n = 0, backslashes = 0;\n"
+    "    quoted[n++] = '\"';\n"
+    "    for(size_t i = 0; i < len; i++) {\n"
+    "        if(arg[i] == '\\\\') {\n"
+    "            backslashes++;\n"
+    "        } else {\n"
+    "            if(arg[i] == '\"') {\n"
+    "                for(size_t k = 0; k < backslashes + 1; k++) quoted[n++] = '\\\\';\n"
+    "            }\n"
+    "            backslashes = 0;\n"
+    "        }\n"
+    "        quoted[n++] = arg[i];\n"
+    "    }\n"
+    "    for(size_t k = 0; k < backslashes; k++) quoted[n++] = '\\\\';\n"
+    "    quoted[n++] = '\"';\n"
+    "    quoted[n] = 0;\n"
+    "    return quoted;\n"
+    "}\n"
+    "#endif\n"
+    "\n"
+    "int main(int argc, char **argv)\n"
+    "{\n"
+    "    (void)argc;\n"
+    "    const char *variant = VL_IsaBestVariant();\n"
+    "    if(!variant) {\n"
+    "        fprintf(stderr, \"This cpu can't run any of the variants of %%s\\n\", argv[0]);\n"
+    "        return 1;\n"
+    "    }\n"
+    "    /* the variants are next to this executable */\n"
+    "    char path[4096];\n"
+    "    size_t len = 0, dirLen = 0;\n"
+    "#if defined(_WIN32)\n"
+    "    len = GetModuleFileNameA(NULL, path, sizeof(path));\n"
+    "#elif defined(__linux__)\n"
+    "    ssize_t n = readlink(\"/proc/self/exe\", path, sizeof(path));\n"
+    "    if(n > 0) len = (size_t)n;\n"
+    "#endif\n"
+    "    if(len == 0 && strlen(argv[0]) < sizeof(path)) {\n"
+    "        len = strlen(argv[0]);\n"
+    "        memcpy(path, argv[0], len);\n"
+    "    }\n"
+    "    for(size_t i = len; i > 0; i--) {\n"
+    "        if(path[i-1] == '/' || path[i-1] == '\\\\') {\n"
+    "            dirLen = i;\n"
+    "            break;\n"
+    "        }\n"
+    "    }\n"
+    "    if(dirLen + strlen(variant) >= sizeof(path)) return 1;\n"
+    "    memcpy(path + dirLen, variant, strlen(variant) + 1);\n"
+    "#if defined(_WIN32)\n"
+    "    /* no exec on windows, wait for it and return its exit code */\n"
+    "    for(int i = 0; i < argc; i++) {\n"
+    "        argv[i] = VL_QuoteArg(argv[i]);\n"
+    "        if(!argv[i]) return 1;\n"
+    "    }\n"
+    "    return (int)_spawnv(_P_WAIT, path, (const char* const*)argv);\n"
+    "#else\n"
+    "    if(dirLen > 0) execv(path, argv);\n"
+    "    else execvp(variant, argv);\n"
+    "    fprintf(stderr, \"Could not run %%s\\n\", path);\n"
+    "    return 1;\n"
+    "#endif\n"
+    "}\n";
+
+VLIBPROC bool VL_CCompileIsaVariants_Opt(struct VL_CCompileIsaVariants_opts opt)
+{
+    vl_compile_ctx *ctx = opt.ctx;
+    if(!ctx->outputDir) ctx->outputDir = ".";
+    unsigned isas = opt.isas;
+    if(isas == 0) {
+#if ARCH_X64
+        isas = VL_ISA(Isa_X86_64_V1) | VL_ISA(Isa_X86_64_V2) | VL_ISA(Isa_X86_64_V3) | VL_ISA(Isa_X86_64_V4);
+#elif ARCH_ARM64
+        isas = VL_ISA(Isa_Default) | VL_ISA(Isa_Armv8_2);
+#else
+        isas = VL_ISA(Isa_Default);
+#endif
+        vl_toolchain *tc = VL__CheckedToolchain(ctx);
+        isas &= tc->isas | VL_ISA(Isa_Default);
+        if(isas == 0) isas = VL_ISA(Isa_Default);
+    }
+    if(ctx->cc == CCompiler_TCC) {
+        VL_Log(VL_WARNING, "tcc can't target an isa, building %s once", ctx->output);
+        isas = VL_ISA(Isa_Default);
+    }
+
+    vl_build_graph graph = {0};
+    string_builder sb = {0};
+    SbAppendf(&sb, "/* Generated by vl_build.h: the variants of %s, best first */\n", ctx->output);
+    string_builder isaList = {0};
+    SbAppendCstr(&sb, "static const char *VL_isaVariants[] = {");
+    // NOTE: Best first, the baseline is only picked when nothing else runs
+    for(int isa = Isa_Armv8_2; isa >= Isa_Default; isa--) {
+        if(!(isas & VL_ISA(isa))) continue;
+        vl_compile_ctx variant = *ctx;
+        variant.isa = (vl_isa)isa;
+        variant.output = temp_sprintf("%s-%s", ctx->output, VL__IsaName((vl_isa)isa));
+        VL_GraphAddCompile(&graph, variant.output, variant);
+
+        const char *file = variant.type == Compile_StaticLibrary ? VL__StaticLibPath(&variant) : VL_GetFilePathFromCompileCtx(&variant);
+        SbAppendf(&sb, "\"%s\", ", VL_PathName(file));
+        SbAppendf(&isaList, "%d, ", isa);
+    }
+    SbAppendCstr(&sb, "};\n");
+    SbAppendf(&sb, "static const int VL_isaVariantIsas[] = {%.*s};\n\n", (int)isaList.count, isaList.items);
+    SbAppendCstr(&sb, VL__isaDispatchCode);
+    SbFree(isaList);
+
+    const char *headerName = temp_sprintf("%s-isa.h", ctx->output);
+    const char *launcher = temp_sprintf("%s/%s-dispatch.c", ctx->outputDir, ctx->output);
+    bool result = VL__WriteFileIfChanged(temp_sprintf("%s/%s", ctx->outputDir, headerName), &sb);
+    if(result && ctx->type == Compile_Executable) {
+        sb.count = 0;
+        SbAppendf(&sb, "/* Generated by vl_build.h: runs the best variant of %s for this cpu */\n", ctx->output);
+        SbAppendf(&sb, VL__isaLauncherCode, headerName);
+        result = VL__WriteFileIfChanged(launcher, &sb);
+
+        vl_compile_ctx launchCtx = {
+            .cc = ctx->cc,
+            .optimize = ctx->optimize,
+            .debug = ctx->debug,
+            .sourceFiles = {.items = &launcher, .count = 1},
+            .output = ctx->output,
+            .outputDir = ctx->outputDir,
+        };
+        if(result) VL_GraphAddCompile(&graph, ctx->output, launchCtx);
+    }
+    SbFree(sb);
+
+    if(result) result = VL_GraphRun(&graph, .maxJobs = opt.maxJobs, .keepGoing = opt.keepGoing);
+    VL_GraphFree(&graph);
+    return result;
+}
+
+VLIBPROC size_t VL_GraphAddCompile(vl_build_graph *graph, const char *name, vl_compile_ctx ctx)
+{
+    vl_target target = {0};
+    target.name = name ? name : ctx.output;
+    target.kind = VL_TARGET_COMPILE;
+    target.ctx = ctx;
+    target.cost = VL__CompilesSeparately(&ctx) ? 1 : (ctx.sourceFiles.count > 0 ? ctx.sourceFiles.count : 1);
+    DaAppend(graph, target);
+    return graph->count - 1;
+}
+
+VLIBPROC size_t VL_GraphAddCmd(vl_build_graph *graph, const char *name, vl_cmd cmd)
+{
+    vl_target target = {0};
+    target.name = name ? name : (cmd.count > 0 ? cmd.items[0] : "cmd");
+    target.kind = VL_TARGET_CMD;
+    target.cmd = cmd;
+    target.cost = 1;
+    DaAppend(graph, target);
+    return graph->count - 1;
+}
+
+VLIBPROC void VL_GraphDepends(vl_build_graph *graph, size_t target, size_t dependency)
+{
+    AssertMsg(target < graph->count && dependency < graph->count, "Unknown target in VL_GraphDepends");
+    DaAppend(&graph->items[target].deps, dependency);
+}
+
+VLIBPROC void VL_GraphFree(vl_build_graph *graph)
+{
+    for(size_t i = 0; i < graph->count; i++) {
+        vl_target *target = &graph->items[i];
+        if(target->object) VL_FREE((char*)target->ctx.output);
+        if(target->ownsSourceFiles) {
+            for(size_t j = 0; j < target->ctx.sourceFiles.count; j++) VL_FREE((char*)target->ctx.sourceFiles.items[j]);
+            DaFree(target->ctx.sourceFiles);
+        }
+        CmdFree(target->cmd);
+        DaFree(target->deps);
+        DaFree(target->dependents);
+    }
+    DaFree(*graph);
+    graph->count = 0;
+    graph->capacity = 0;
+}
+
+/* A separateObjects compile becomes a target per object, with the same dependencies, and the link.
+   A precompiled header becomes a target with the same dependencies that the compiles depend on */
+static void VL__GraphExpand(vl_build_graph *graph)
+{
+    size_t count = graph->count;
+    for(size_t i = 0; i < count; i++) {
+        vl_target *target = &graph->items[i];
+        if(target->kind == VL_TARGET_COMPILE && VL__UsesPch(&target->ctx) && !target->ctx.targetOutput) {
+            vl_target pch = {0};
+            pch.kind = VL_TARGET_COMPILE;
+            pch.object = true;
+            pch.cost = 1;
+            if(VL__PchCompileCtx(&target->ctx, &pch.ctx)) {
+                pch.ownsSourceFiles = true;
+                pch.ctx.output = VL__HeapStrndup(pch.ctx.output, strlen(pch.ctx.output));
+                pch.ctx.sourceFiles.items[0] = VL__HeapStrndup(pch.ctx.sourceFiles.items[0], strlen(pch.ctx.sourceFiles.items[0]));
+                pch.name = pch.ctx.output;
+                DaAppendMany(&pch.deps, target->deps.items, target->deps.count);
+                // NOTE: Marks the precompiled header as added, the compiles only use it
+                target->ctx.targetOutput = target->ctx.output;
+                DaAppend(graph, pch);
+                target = &graph->items[i];
+                DaAppend(&target->deps, graph->count - 1);
+            } else {
+                // NOTE: Without it the sources include the header themselves
+                DaFree(pch.ctx.sourceFiles);
+                target->ctx.precompiledHeader = NULL;
+            }
+        }
+        if(target->kind != VL_TARGET_COMPILE || !VL__CompilesSeparately(&target->ctx)) continue;
+
+        target->kind = VL_TARGET_LINK;
+        if(!target->ctx.outputDir) target->ctx.outputDir = ".";
+        if(target->ctx.unityBatchSize > 0) {
+            // NOTE: If the unity files can't be written the sources are compiled one by one
+            vl_compile_ctx unityCtx;
+            if(VL__UnityCtx(&target->ctx, &unityCtx)) {
+                for(size_t j = 0; j < unityCtx.sourceFiles.count; j++) {
+                    const char *path = unityCtx.sourceFiles.items[j];
+                    unityCtx.sourceFiles.items[j] = VL__HeapStrndup(path, strlen(path));
+                }
+                target->ctx = unityCtx;
+                target->ownsSourceFiles = true;
+            } else {
+                DaFree(unityCtx.sourceFiles);
+                target->ctx.unityBatchSize = 0;
+            }
+        }
+        size_t countDeps = target->deps.count;
+        for(size_t j = 0; j < target->ctx.sourceFiles.count; j++) {
+            vl_target object = {0};
+            object.kind = VL_TARGET_COMPILE;
+            object.object = true;
+            object.ctx = VL__ObjectCompileCtx(&graph->items[i].ctx, j);
+            object.ctx.output = VL__HeapStrndup(object.ctx.output, strlen(object.ctx.output));
+            object.name = object.ctx.output;
+            object.cost = 1;
+            DaAppendMany(&object.deps, graph->items[i].deps.items, countDeps);
+            DaAppend(graph, object);
+            DaAppend(&graph->items[i].deps, graph->count - 1);
+        }
+    }
+}
+
+typedef struct {
+    vl_build_graph *graph;
+    vl_target_ids ready;
+    vl_target_ids running;
+    vl_cmd cmd;
+    vl_procs procs;
+    vl_procs waiting;
+    bool failed;
+    bool orderedOutput;
+} vl__graph_run;
+
+static void VL__GraphSkip(vl__graph_run *run, size_t id, const char *failed)
+{
+    vl_target *target = &run->graph->items[id];
+    if(target->state != VL_TARGET_WAITING) return;
+    VL_Log(VL_WARNING, "Skipping '%s', '%s' failed", target->name, failed);
+    target->state = VL_TARGET_SKIPPED;
+    for(size_t i = 0; i < target->dependents.count; i++) {
+        VL__GraphSkip(run, target->dependents.items[i], failed);
+    }
+}
+
+static void VL__GraphComplete(vl__graph_run *run, size_t id, bool ok)
+{
+    vl_target *target = &run->graph->items[id];
+    target->state = ok ? VL_TARGET_DONE : VL_TARGET_FAILED;
+    if(!ok) {
+        VL_Log(VL_ERROR, "Target '%s' failed", target->name);
+        run->failed = true;
+    }
+
+    for(size_t i = 0; i < target->dependents.count; i++) {
+        vl_target *dependent = &run->graph->items[target->dependents.items[i]];
+        if(!ok) {
+            VL__GraphSkip(run, target->dependents.items[i], target->name);
+        } else if(--dependent->pendingDeps == 0) {
+            DaAppend(&run->ready, target->dependents.items[i]);
+        }
+    }
+}
+
+static bool VL__GraphStartCmd(vl__graph_run *run, vl_target *target)
+{
+    vl_cmd_opts opt = {
+        .cmd = &run->cmd,
+        .async = &run->procs,
+        .captureOutput = true,
+        .orderedOutput = run->orderedOutput,
+    };
+    run->procs.count = 0;
+    if(!CmdRun_Opt(opt)) return false;
+    target->proc = run->procs.items[0];
+    target->state = VL_TARGET_RUNNING;
+    target->ran = true;
+    return true;
+}
+
+static void VL__GraphStep(vl__graph_run *run, size_t id, bool ok);
+
+// Returns false if it failed to start, a target that is up to date is completed right away
+static bool VL__GraphStart(vl__graph_run *run, size_t id)
+{
+    vl_target *target = &run->graph->items[id];
+    // NOTE: Objects only wait for the dependencies of their link, their own check sees generated headers
+    bool force = false;
+    for(size_t i = 0; !target->object && i < target->deps.count; i++) {
+        if(run->graph->items[target->deps.items[i]].ran) force = true;
+    }
+
+    run->cmd.count = 0;
+    if(target->kind == VL_TARGET_CMD) {
+        DaAppendMany(&run->cmd, target->cmd.items, target->cmd.count);
+        return VL__GraphStartCmd(run, target);
+    }
+
+    if(target->kind == VL_TARGET_LINK) {
+        vl_file_paths objects = {0};
+        target->step.output = VL__SeparateObjects(&target->ctx, &objects);
+        // NOTE: The objects are dependencies too, the ones that were compiled are newer than the archive
+        bool remake = VL__ObjectsChanged(&target->ctx, objects, target->step.output);
+        bool needed = force || remake || VL_NeedsRebuild_Impl(target->step.output, objects.items, objects.count) != 0;
+        if(needed && remake) VL__SeparateLinkRemake(objects, target->step.output);
+        if(needed) VL__SeparateLinkCmd(&target->ctx, &run->cmd, objects, target->step.output, remake, (vl_file_paths){0});
+        DaFree(objects);
+        if(!needed) {
+            VL__GraphComplete(run, id, true);
+            return true;
+        }
+        return VL__GraphStartCmd(run, target);
+    }
+
+    if(!force && VL_Needs_C_Rebuild(&run->cmd, &target->ctx) == 0) {
+        VL__GraphComplete(run, id, true);
+        return true;
+    }
+    vl_cmd_opts opt = {
+        .cmd = &run->cmd,
+        .async = &run->procs,
+        .captureOutput = true,
+        .orderedOutput = run->orderedOutput,
+    };
+    run->cmd.count = 0;
+    run->procs.count = 0;
+    if(!VL__CCompileRun(&target->ctx, opt, &target->step, true)) {
+        VL__CCompileDone(&target->ctx, &target->step, false);
+        return false;
+    }
+    if(target->step.cached) {
+        target->ran = true;
+        VL__GraphStep(run, id, true);
+        return true;
+    }
+    target->proc = run->procs.items[0];
+    target->state = VL_TARGET_RUNNING;
+    target->ran = true;
+    return true;
+}
+
+// The process of target ended
+static void VL__GraphStep(vl__graph_run *run, size_t id, bool ok)
+{
+    vl_target *target = &run->graph->items[id];
+    if(target->kind == VL_TARGET_LINK) {
+        VL_FileTimeInvalidate(target->step.output);
+    } else if(target->kind == VL_TARGET_COMPILE) {
+        VL__CCompileDone(&target->ctx, &target->step, ok);
+    }
+    VL__GraphComplete(run, id, ok);
+}
+
+// Critical path: a target's priority is its cost plus the highest priority among its dependents
+static bool VL__GraphPrioritize(vl_build_graph *graph)
+{
+    vl_target_ids order = {0};
+    vl_target_ids remaining = {0};
+    for(size_t i = 0; i < graph->count; i++) {
+        DaAppend(&remaining, graph->items[i].dependents.count);
+        if(graph->items[i].dependents.count == 0) DaAppend(&order, i);
+    }
+    for(size_t next = 0; next < order.count; next++) {
+        vl_target *target = &graph->items[order.items[next]];
+        size_t most = 0;
+        for(size_t i = 0; i < target->dependents.count; i++) {
+            size_t priority = graph->items[target->dependents.items[i]].priority;
+            if(priority > most) most = priority;
+        }
+        target->priority = target->cost + most;
+        for(size_t i = 0; i < target->deps.count; i++) {
+            if(--remaining.items[target->deps.items[i]] == 0) DaAppend(&order, target->deps.items[i]);
+        }
+    }
+
+    bool result = order.count == graph->count;
+    if(!result) {
+        for(size_t i = 0; i < graph->count; i++) {
+            if(remaining.items[i] > 0) VL_Log(VL_ERROR, "Target '%s' is part of a dependency cycle", graph->items[i].name);
+        }
+    }
+    DaFree(order);
+    DaFree(remaining);
+    return result;
+}
+
+VLIBPROC bool VL_GraphRun_Opt(struct VL_GraphRun_opts opt)
+{
+    vl_build_graph *graph = opt.graph;
+    size_t maxJobs = opt.maxJobs > 0 ? opt.maxJobs : (size_t)VL_GetCountProcs();
+    vl__graph_run run = {0};
+    run.graph = graph;
+    run.orderedOutput = opt.orderedOutput;
+
+    VL__GraphExpand(graph);
+    for(size_t i = 0; i < graph->count; i++) {
+        vl_target *target = &graph->items[i];
+        target->state = VL_TARGET_WAITING;
+        target->ran = false;
+        target->pendingDeps = target->deps.count;
+        target->dependents.count = 0;
+    }
+    for(size_t i = 0; i < graph->count; i++) {
+        vl_target *target = &graph->items[i];
+        for(size_t j = 0; j < target->deps.count; j++) {
+            DaAppend(&graph->items[target->deps.items[j]].dependents, i);
+        }
+    }
+    if(!VL__GraphPrioritize(graph)) return false;
+
+    for(size_t i = 0; i < graph->count; i++) {
+        if(graph->items[i].pendingDeps == 0) DaAppend(&run.ready, i);
+    }
+
+    for(;;) {
+        while(run.running.count < maxJobs && run.ready.count > 0 && (opt.keepGoing || !run.failed)) {
+            size_t best = 0;
+            for(size_t i = 1; i < run.ready.count; i++) {
+                if(graph->items[run.ready.items[i]].priority > graph->items[run.ready.items[best]].priority) best = i;
+            }
+            size_t id = run.ready.items[best];
+            DaRemoveUnordered(&run.ready, best);
+            if(!VL__GraphStart(&run, id)) {
+                VL__GraphComplete(&run, id, false);
+            } else if(graph->items[id].state == VL_TARGET_RUNNING) {
+                DaAppend(&run.running, id);
+            }
+        }
+        if(run.running.count == 0) break;
+
+        run.waiting.count = 0;
+        for(size_t i = 0; i < run.running.count; i++) {
+            DaAppend(&run.waiting, graph->items[run.running.items[i]].proc);
+        }
+        bool ok;
+        size_t i = VL_ProcsWaitAny(run.waiting, &ok);
+        VL__GraphStep(&run, run.running.items[i], ok);
+        DaRemoveUnordered(&run.running, i);
+    }
+
+    CmdFree(run.cmd);
+    DaFree(run.procs);
+    DaFree(run.waiting);
+    DaFree(run.ready);
+    DaFree(run.running);
+    return !run.failed;
+}
+
+static void VL__SleepMs(int ms)
+{
+#if OS_WINDOWS
+    Sleep((DWORD)ms);
+#else
+    struct timespec duration = {
+        .tv_sec = ms/1000,
+        .tv_nsec = (long)(ms%1000)*1000*1000,
+    };
+    nanosleep(&duration, NULL);
+#endif
+}
+
+static void VL__WatchReport(vl_watch *watch, const char *path, size_t len)
+{
+    for(size_t i = 0; i < watch->changed.count; i++) {
+        const char *changed = watch->changed.items[i];
+        if(strncmp(changed, path, len) == 0 && changed[len] == '\0') return;
+    }
+    DaAppend(&watch->changed, VL__HeapStrndup(path, len));
+}
+
+static void VL__WatchSnapshotAdd(vl__watch_snapshot *snap, const char *path, size_t len, vl_file_stat *fileStat)
+{
+    vl__watch_file file = {
+        .offset = snap->names.count,
+        .mtime = fileStat->mtime,
+        .size = fileStat->size,
+    };
+    SbAppendBuf(&snap->names, path, len);
+    SbAppendNull(&snap->names);
+    DaAppend(&snap->files, file);
+}
+
+static void VL__WatchScanDir(vl__watch_snapshot *snap, string_builder *path, bool recursive)
+{
+    vl_dir_iter it;
+    // NOTE: The directory may have been removed since it was listed, that's just a change
+    if(!VL_DirIterOpen(&it, path->items, .quietMissing = true)) return;
+
+    size_t mark = path->count;
+    while(VL_DirIterNext(&it)) {
+        path->count = mark;
+        SbAppendf(path, "/%s", it.entry.name.items);
+        if(it.entry.type == VL_FILE_DIRECTORY) {
+            if(recursive) VL__WatchScanDir(snap, path, true);
+        } else {
+            vl_file_stat fileStat;
+            if(VL_DirIterStat(&it, &fileStat)) {
+                VL__WatchSnapshotAdd(snap, path->items, path->count, &fileStat);
+            }
+        }
+    }
+    VL_DirIterClose(&it);
+    path->count = mark;
+    path->items[mark] = '\0';
+}
+
+static int VL__WatchFileCompare(const void *a, const void *b)
+{
+    return strcmp(((const vl__watch_file*)a)->path, ((const vl__watch_file*)b)->path);
+}
+
+static void VL__WatchScan(vl_watch *watch, vl__watch_snapshot *snap)
+{
+    snap->names.count = 0;
+    snap->files.count = 0;
+
+    string_builder path = {0};
+    // NOTE: Reserved up front so the path open iterators point to is never reallocated
+    DaReserve(&path, VL_PATH_MAX + 1);
+    for(size_t i = 0; i < watch->roots.count; i++) {
+        vl__watch_root *root = &watch->roots.items[i];
+        if(root->isDir) {
+            path.count = 0;
+            SbAppendf(&path, "%s", root->path);
+            VL__WatchScanDir(snap, &path, !root->shallow);
+        } else {
+            vl_file_stat fileStat;
+            if(VL_GetFileStat(root->path, &fileStat)) {
+                VL__WatchSnapshotAdd(snap, root->path, strlen(root->path), &fileStat);
+            }
+        }
+    }
+    SbFree(path);
+
+    for(size_t i = 0; i < snap->files.count; i++) {
+        snap->files.items[i].path = snap->names.items + snap->files.items[i].offset;
+    }
+    if(snap->files.count > 0) {
+        qsort(snap->files.items, snap->files.count, sizeof(vl__watch_file), VL__WatchFileCompare);
+    }
+}
+
+// Both snapshots are sorted, so added, removed and modified files come out of a single merge
+static void VL__WatchDiff(vl_watch *watch, vl__watch_snapshot *prev, vl__watch_snapshot *next)
+{
+    size_t i = 0, j = 0;
+    while(i < prev->files.count || j < next->files.count) {
+        int cmp;
+        if(i >= prev->files.count) cmp = 1;
+        else if(j >= next->files.count) cmp = -1;
+        else cmp = strcmp(prev->files.items[i].path, next->files.items[j].path);
+
+        if(cmp < 0) {
+            VL__WatchReport(watch, prev->files.items[i].path, strlen(prev->files.items[i].path));
+            i++;
+        } else if(cmp > 0) {
+            VL__WatchReport(watch, next->files.items[j].path, strlen(next->files.items[j].path));
+            j++;
+        } else {
+            vl__watch_file *a = &prev->files.items[i];
+            vl__watch_file *b = &next->files.items[j];
+            if(a->mtime != b->mtime || a->size != b->size) {
+                VL__WatchReport(watch, b->path, strlen(b->path));
+            }
+            i++;
+            j++;
+        }
+    }
+}
+
+#if OS_LINUX
+#define VL__INOTIFY_MASK (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | \
+                          IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+static int VL__WatchFindDir(vl_watch *watch, int wd)
+{
+    for(size_t i = 0; i < watch->dirs.count; i++) {
+        if(watch->dirs.items[i].wd == wd) return (int)i;
+    }
+    return -1;
+}
+
+/* Returns the watch descriptor or -1. When report is set every file found is reported,
+ * used for directories created after the watch started */
+static int VL__WatchAddDir(vl_watch *watch, const char *path, bool all, bool recursive, bool report)
+{
+    int wd = inotify_add_watch(watch->fd, path, VL__INOTIFY_MASK | IN_ONLYDIR);
+    if(wd < 0) {
+        VL_Log(VL_ERROR, "Could not watch directory %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    int idx = VL__WatchFindDir(watch, wd);
+    if(idx >= 0) {
+        // NOTE: Same directory through another path, or already watched for a file inside it
+        vl__watch_dir *dir = &watch->dirs.items[idx];
+        bool wasRecursive = dir->recursive;
+        dir->all = dir->all || all;
+        dir->recursive = dir->recursive || recursive;
+        if(wasRecursive || !recursive) return wd;
+    } else {
+        vl__watch_dir dir = {
+            .wd = wd,
+            .path = VL__HeapStrndup(path, strlen(path)),
+            .all = all,
+            .recursive = recursive,
+        };
+        DaAppend(&watch->dirs, dir);
+    }
+    if(!recursive && !report) return wd;
+
+    vl_dir_iter it;
+    if(!VL_DirIterOpen(&it, path)) return wd;
+    while(VL_DirIterNext(&it)) {
+        size_t mark = temp_save();
+        char *child = temp_sprintf("%s/%s", path, it.entry.name.items);
+        if(it.entry.type == VL_FILE_DIRECTORY) {
+            if(recursive) VL__WatchAddDir(watch, child, true, true, report);
+        } else if(report) {
+            VL__WatchReport(watch, child, strlen(child));
+        }
+        temp_rewind(mark);
+    }
+    VL_DirIterClose(&it);
+    return wd;
+}
+
+static bool VL__WatchReadEvents(vl_watch *watch)
+{
+    u64 buffer[4096/sizeof(u64)];
+    for(;;) {
+        ssize_t n = read(watch->fd, buffer, sizeof(buffer));
+        if(n < 0) {
+            if(errno == EAGAIN) return true;
+            if(errno == EINTR) continue;
+            VL_Log(VL_ERROR, "Could not read inotify events: %s", strerror(errno));
+            return false;
+        }
+
+        for(u8 *at = (u8*)buffer; at < (u8*)buffer + n;) {
+            struct inotify_event *ev = (struct inotify_event*)at;
+            at += sizeof(struct inotify_event) + ev->len;
+
+            if(ev->mask & IN_Q_OVERFLOW) {
+                // NOTE: Events were lost, everything could have changed. The roots make the batch not empty
+                watch->overflowed = true;
+                for(size_t i = 0; i < watch->roots.count; i++) {
+                    VL__WatchReport(watch, watch->roots.items[i].path, strlen(watch->roots.items[i].path));
+                }
+                continue;
+            }
+
+            int idx = VL__WatchFindDir(watch, ev->wd);
+            if(idx < 0) continue;
+            vl__watch_dir *dir = &watch->dirs.items[idx];
+
+            if(ev->mask & IN_IGNORED) {
+                VL_FREE(dir->path);
+                DaRemoveUnordered(&watch->dirs, (size_t)idx);
+                continue;
+            }
+            if(ev->len == 0) {
+                if(dir->all) VL__WatchReport(watch, dir->path, strlen(dir->path));
+                continue;
+            }
+
+            if(dir->all) {
+                size_t mark = temp_save();
+                char *path = temp_sprintf("%s/%s", dir->path, ev->name);
+                VL__WatchReport(watch, path, strlen(path));
+                if((ev->mask & IN_ISDIR) && (ev->mask & (IN_CREATE | IN_MOVED_TO)) && dir->recursive) {
+                    VL__WatchAddDir(watch, path, true, true, true);
+                }
+                temp_rewind(mark);
+            }
+            // NOTE: Watched files are reported with the path they were added with, even in a watched directory
+            for(size_t i = 0; i < watch->roots.count; i++) {
+                vl__watch_root *root = &watch->roots.items[i];
+                if(!root->isDir && root->wd == ev->wd && strcmp(root->name, ev->name) == 0) {
+                    VL__WatchReport(watch, root->path, strlen(root->path));
+                }
+            }
+        }
+    }
+}
+#endif // OS_LINUX
+
+VLIBPROC bool VL_WatchInit_Opt(struct VL_WatchInit_opts opt)
+{
+    AssertMsg(opt.watch != 0, "Invalid parameter: watch is null");
+    vl_watch *watch = opt.watch;
+    memset(watch, 0, sizeof(*watch));
+    watch->pollIntervalMs = opt.pollIntervalMs > 0 ? opt.pollIntervalMs : 250;
+    watch->debounceMs = opt.debounceMs > 0 ? opt.debounceMs : 30;
+    watch->polling = true;
+#if OS_LINUX
+    watch->fd = -1;
+    if(!opt.forcePolling) {
+        watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(watch->fd >= 0) {
+            watch->polling = false;
+        } else {
+            VL_Log(VL_WARNING, "Could not initialize inotify, falling back to polling: %s", strerror(errno));
+        }
+    }
+#endif
+    return true;
+}
+
+VLIBPROC bool VL_WatchAdd_Opt(struct VL_WatchAdd_opts opt)
+{
+    AssertMsg(opt.path != 0, "Invalid parameter: path is null");
+    vl_watch *watch = opt.watch;
+
+    vl_file_stat fileStat;
+    if(!VL_GetFileStat(opt.path, &fileStat)) {
+        VL_Log(VL_ERROR, "Could not watch '%s': it does not exist", opt.path);
+        return false;
+    }
+
+    size_t len = strlen(opt.path);
+    while(len > 1 && (opt.path[len-1] == '/' || opt.path[len-1] == '\\')) len--;
+
+    vl__watch_root root = {0};
+    root.path = VL__HeapStrndup(opt.path, len);
+    root.isDir = fileStat.type == VL_FILE_DIRECTORY;
+    root.shallow = opt.shallow;
+
+#if OS_LINUX
+    root.wd = -1;
+    root.name = root.path + strlen(root.path);
+    while(root.name > root.path && root.name[-1] != '/') root.name--;
+    if(!watch->polling) {
+        int wd;
+        if(root.isDir) {
+            wd = VL__WatchAddDir(watch, root.path, true, !root.shallow, false);
+        } else {
+            size_t mark = temp_save();
+            view dir = VL__PathDirView(root.path);
+            wd = VL__WatchAddDir(watch, temp_strndup(dir.items, dir.count), false, false, false);
+            root.wd = wd;
+            temp_rewind(mark);
+        }
+        if(wd < 0) {
+            VL_FREE(root.path);
+            return false;
+        }
+    }
+#endif
+
+    DaAppend(&watch->roots, root);
+    // NOTE: Scanning the whole tree on every add would be quadratic when adding many files
+    if(watch->polling) watch->snapshotStale = true;
+    return true;
+}
+
+VLIBPROC bool VL_WatchWait(vl_watch *watch, int timeoutMs)
+{
+    for(size_t i = 0; i < watch->changed.count; i++) {
+        VL_FREE((char*)watch->changed.items[i]);
+    }
+    watch->changed.count = 0;
+    watch->overflowed = false;
+
+    u64 deadline = timeoutMs >= 0 ? VL_GetNanos() + (u64)timeoutMs*1000*1000 : 0;
+    if(watch->polling) {
+        if(watch->snapshotStale) {
+            VL__WatchScan(watch, &watch->snapshot);
+            watch->snapshotStale = false;
+        }
+        for(;;) {
+            int sleepMs = watch->pollIntervalMs;
+            if(timeoutMs >= 0) {
+                u64 now = VL_GetNanos();
+                if(now >= deadline) return true;
+                u64 remainingMs = (deadline - now)/(1000*1000);
+                if(remainingMs < (u64)sleepMs) sleepMs = (int)remainingMs;
+            }
+            VL__SleepMs(sleepMs);
+
+            VL__WatchScan(watch, &watch->scan);
+            VL__WatchDiff(watch, &watch->snapshot, &watch->scan);
+            vl__watch_snapshot tmp = watch->snapshot;
+            watch->snapshot = watch->scan;
+            watch->scan = tmp;
+            if(watch->changed.count > 0) return true;
+        }
+    }
+
+#if OS_LINUX
+    for(;;) {
+        int pollMs = -1;
+        if(watch->changed.count > 0) {
+            // NOTE: Wait until the events stop, saving a file usually produces a few of them
+            pollMs = watch->debounceMs;
+        } else if(timeoutMs >= 0) {
+            u64 now = VL_GetNanos();
+            if(now >= deadline) return true;
+            pollMs = (int)((deadline - now + 999999)/(1000*1000));
+        }
+
+        struct pollfd pollfd = {
+            .fd = watch->fd,
+            .events = POLLIN,
+        };
+        int status = poll(&pollfd, 1, pollMs);
+        if(status < 0) {
+            if(errno == EINTR) continue;
+            VL_Log(VL_ERROR, "Could not poll inotify: %s", strerror(errno));
+            return false;
+        }
+        if(status == 0) {
+            if(watch->changed.count > 0) return true;
+            continue;
+        }
+        if(!VL__WatchReadEvents(watch)) return false;
+    }
+#else
+    return false;
+#endif
+}
+
+VLIBPROC void VL_WatchFree(vl_watch *watch)
+{
+    for(size_t i = 0; i < watch->changed.count; i++) VL_FREE((char*)watch->changed.items[i]);
+    DaFree(watch->changed);
+    for(size_t i = 0; i < watch->roots.count; i++) VL_FREE(watch->roots.items[i].path);
+    DaFree(watch->roots);
+    SbFree(watch->snapshot.names);
+    DaFree(watch->snapshot.files);
+    SbFree(watch->scan.names);
+    DaFree(watch->scan.files);
+#if OS_LINUX
+    for(size_t i = 0; i < watch->dirs.count; i++) VL_FREE(watch->dirs.items[i].path);
+    DaFree(watch->dirs);
+    if(watch->fd >= 0) close(watch->fd);
+#endif
+    memset(watch, 0, sizeof(*watch));
+}
+
+typedef struct {
+    vl_file_paths paths; /* on the heap */
+    bool headersKnown; /* from the depfile or VL_ScanIncludes, until then anything in the include paths matches */
+} vl__target_inputs;
+
+/* Adds the files a rebuild check of ctx reads that inputs doesn't have yet: the sources, extraDependencies and
+   the headers from its depfile (VL_ScanIncludes for tcc). Returns the index of the first new one */
+static size_t VL__TargetInputsUpdate(vl_compile_ctx *ctx, vl__target_inputs *inputs)
+{
+    size_t first = inputs->paths.count;
+    size_t mark = temp_save();
+    vl_file_paths found = {0};
+    string_builder data = {0};
+    DaAppendMany(&found, ctx->sourceFiles.items, ctx->sourceFiles.count);
+    DaAppendMany(&found, ctx->extraDependencies.items, ctx->extraDependencies.count);
+    if(VL__ChecksDepFile(ctx)) {
+        const char *depPath = VL_GetDepFilePathFromCompileCtx(ctx);
+        if(VL_FileExists(depPath) && SbReadEntireFile(depPath, &data)) {
+            SbAppendNull(&data);
+            VL__ParseDeps(ctx, data.items, data.count - 1, &found);
+            inputs->headersKnown = true;
+        }
+    } else if(ctx->cc == CCompiler_TCC) {
+        inputs->headersKnown = VL_ScanIncludes(ctx, &found);
+    }
+
+    for(size_t i = 0; i < found.count; i++) {
+        bool known = false;
+        for(size_t j = 0; !known && j < inputs->paths.count; j++) {
+            known = strcmp(inputs->paths.items[j], found.items[i]) == 0;
+        }
+        if(!known) DaAppend(&inputs->paths, VL__HeapStrndup(found.items[i], strlen(found.items[i])));
+    }
+    DaFree(found);
+    SbFree(data);
+    temp_rewind(mark);
+    return first;
+}
+
+static void VL__TargetInputsFree(vl__target_inputs *inputs)
+{
+    for(size_t i = 0; i < inputs->paths.count; i++) VL_FREE((char*)inputs->paths.items[i]);
+    DaFree(inputs->paths);
+    memset(inputs, 0, sizeof(*inputs));
+}
+
+static bool VL__PathInIncludePaths(vl_compile_ctx *ctx, const char *changed)
+{
+    view path = ViewFromCstr(changed);
+    for(size_t i = 0; i < ctx->includePaths.count; i++) {
+        view inc = ViewFromCstr(ctx->includePaths.items[i]);
+        while(inc.count > 1 && (inc.items[inc.count-1] == '/' || inc.items[inc.count-1] == '\\')) inc.count--;
+        if(path.count > inc.count && ViewStartsWith(path, inc) &&
+           (path.items[inc.count] == '/' || path.items[inc.count] == '\\'))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Whether a changed path is one of the inputs of ctx
+static bool VL__WatchTargetAffected(vl_compile_ctx *ctx, vl__target_inputs *inputs, vl_file_paths *changed)
+{
+    for(size_t i = 0; i < changed->count; i++) {
+        for(size_t j = 0; j < inputs->paths.count; j++) {
+            if(strcmp(changed->items[i], inputs->paths.items[j]) == 0) return true;
+        }
+        if(!inputs->headersKnown && VL__PathInIncludePaths(ctx, changed->items[i])) return true;
+    }
+    return false;
+}
+
+static bool VL__WatchTargetInputs(vl_watch *watch, vl_compile_ctx *ctx, vl__target_inputs *inputs)
+{
+    for(size_t i = VL__TargetInputsUpdate(ctx, inputs); i < inputs->paths.count; i++) {
+        const char *path = inputs->paths.items[i];
+        // NOTE: Sources that don't exist yet are matched through their directory
+        if(VL_FileExists(path) && !VL_WatchAdd(watch, path)) return false;
+    }
+    return true;
+}
+
+// changed == NULL checks every target
+static void VL__WatchRebuildTargets(struct VL_WatchRebuild_opts *opt, vl_watch *watch, vl__target_inputs *inputs,
+                                    vl_file_paths *changed)
+{
+    for(size_t i = 0; i < opt->count; i++) {
+        vl_compile_ctx *ctx = &opt->targets[i];
+        if(changed && !VL__WatchTargetAffected(ctx, &inputs[i], changed)) continue;
+
+        size_t mark = temp_save();
+        int needsRebuild = VL_Needs_C_Rebuild(opt->cmd, ctx);
+        opt->cmd->count = 0;
+        if(needsRebuild != 0) {
+            const char *output = VL_GetFilePathFromCompileCtx(ctx);
+            if(!VL_CCompile_Opt(ctx, (vl_cmd_opts){.cmd = opt->cmd})) {
+                VL_Log(VL_ERROR, "Could not build %s", output);
+            }
+        }
+        // NOTE: The compile could include new headers
+        VL__WatchTargetInputs(watch, ctx, &inputs[i]);
+        temp_rewind(mark);
+    }
+}
+
+VLIBPROC bool VL_WatchRebuild_Opt(struct VL_WatchRebuild_opts opt)
+{
+    AssertMsg(opt.cmd != 0, "Invalid parameter: cmd is null");
+    bool result = true;
+    vl_watch watch;
+    VL_WatchInit(&watch, .forcePolling = opt.forcePolling);
+    vl__target_inputs *inputs = (vl__target_inputs*)VL_REALLOC(NULL, (opt.count + 1)*sizeof(vl__target_inputs));
+    Assert(inputs && "Buy more RAM lol");
+    memset(inputs, 0, (opt.count + 1)*sizeof(vl__target_inputs));
+
+    for(size_t i = 0; i < opt.count; i++) {
+        vl_compile_ctx *ctx = &opt.targets[i];
+        if(!ctx->outputDir) ctx->outputDir = ".";
+
+        size_t mark = temp_save();
+        for(size_t j = 0; j < ctx->sourceFiles.count; j++) {
+            view dir = VL__PathDirView(ctx->sourceFiles.items[j]);
+            if(!VL_WatchAdd(&watch, temp_strndup(dir.items, dir.count), .shallow = true)) VL_ReturnDefer(false);
+        }
+        for(size_t j = 0; j < ctx->includePaths.count; j++) {
+            if(!VL_WatchAdd(&watch, ctx->includePaths.items[j])) VL_ReturnDefer(false);
+        }
+        if(!VL__WatchTargetInputs(&watch, ctx, &inputs[i])) VL_ReturnDefer(false);
+        temp_rewind(mark);
+    }
+
+    VL__WatchRebuildTargets(&opt, &watch, inputs, NULL);
+    for(;;) {
+        if(!VL_WatchWait(&watch, -1)) VL_ReturnDefer(false);
+        if(watch.changed.count == 0) continue;
+
+        if(watch.overflowed) {
+            // NOTE: What changed isn't known, so every target is checked again
+            VL_FileTimeInvalidateAll();
+            VL__WatchRebuildTargets(&opt, &watch, inputs, NULL);
+        } else {
+            for(size_t i = 0; i < watch.changed.count; i++) {
+                VL_FileTimeInvalidate(watch.changed.items[i]);
+            }
+            VL__WatchRebuildTargets(&opt, &watch, inputs, &watch.changed);
+        }
+        if(opt.onBatch && !opt.onBatch(&watch.changed, opt.userData)) break;
+    }
+
+defer:
+    for(size_t i = 0; i < opt.count; i++) VL__TargetInputsFree(&inputs[i]);
+    VL_FREE(inputs);
+    VL_WatchFree(&watch);
+    return result;
+}
+
+#if !OS_WINDOWS
+/* The protocol is text. The client sends "dirty <graph hash>\n", the daemon answers "stale\n" and exits when the
+   hash isn't the one of its graph (the hash is left out when the client doesn't have the graph), otherwise
+   with every out of date target in dependency order and "end\n":
+     target <id> <dependency count> <dependency ids...> <command count>\n
+     <name length>\n<name>\n
+     then per command: <argc>\n and per argument <length>\n<argument>\n
+   The client sends "built <id> <0|1>\n" for each of them and "done\n", or "stop\n" instead of "dirty\n" */
+
+typedef struct {
+    int fd;
+    string_builder in;
+    size_t pos;
+} vl__daemon_conn;
+
+typedef struct {
+    const char *path; /* on the heap */
+    vl_target_ids targets; /* that read it */
+} vl__daemon_input;
+
+typedef struct {
+    vl_build_graph *graph;
+    u64 graphHash;
+    vl_target_ids order; /* dependencies first */
+    struct { bool *items; size_t count; size_t capacity; } clean; /* up to date, not checked until something changes */
+    struct { bool *items; size_t count; size_t capacity; } dirty; /* in the last answer */
+    struct { u64 *items; size_t count; size_t capacity; } outputStamps; /* of the outputs of clean targets */
+    vl_watch watch;
+    vl_file_paths watched;
+    struct { vl__target_inputs *items; size_t count; size_t capacity; } targetInputs;
+    /* Every input of a target to the targets that read it, an open addressing table of inputs indices + 1 */
+    struct { vl__daemon_input *items; size_t count; size_t capacity; } inputs;
+    size_t *inputSlots;
+    size_t inputSlotCount;
+    vl_cmd cmd;
+} vl__daemon;
+
+// Hash of what each target of graph runs, the daemon and its clients compare it before it's expanded
+static u64 VL__GraphHash(vl_build_graph *graph)
+{
+    vl_hash_state state;
+    VL_HashBegin(&state, (u64)graph->count);
+    vl_cmd cmd = {0};
+    for(size_t i = 0; i < graph->count; i++) {
+        vl_target *target = &graph->items[i];
+        size_t mark = temp_save();
+        VL_HashUpdate(&state, target->name, strlen(target->name) + 1);
+        VL_HashUpdate(&state, &target->kind, sizeof(target->kind));
+        VL_HashUpdate(&state, target->deps.items, target->deps.count*sizeof(*target->deps.items));
+        if(target->kind == VL_TARGET_CMD) {
+            CmdExtend(&cmd, &target->cmd);
+        } else {
+            vl_compile_ctx *ctx = &target->ctx;
+            VL_CCompileCmd(ctx, &cmd);
+            VL_HashUpdate(&state, &ctx->separateObjects, sizeof(ctx->separateObjects));
+            VL_HashUpdate(&state, &ctx->unityBatchSize, sizeof(ctx->unityBatchSize));
+            DaAppendMany(&cmd, ctx->extraDependencies.items, ctx->extraDependencies.count);
+        }
+        for(size_t j = 0; j < cmd.count; j++) VL_HashUpdate(&state, cmd.items[j], strlen(cmd.items[j]) + 1);
+        cmd.count = 0;
+        temp_rewind(mark);
+    }
+    CmdFree(cmd);
+    return VL_HashEnd(&state);
+}
+
+static bool VL__DaemonSend(int fd, string_builder *sb)
+{
+#ifdef MSG_NOSIGNAL
+    int flags = MSG_NOSIGNAL; // NOTE: A client that went away must not kill the daemon
+#else
+    int flags = 0;
+#endif
+    size_t written = 0;
+    while(written < sb->count) {
+        ssize_t n = send(fd, sb->items + written, sb->count - written, flags);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) {
+            VL_Log(VL_ERROR, "Could not write to the build daemon socket: %s", strerror(errno));
+            return false;
+        }
+        written += (size_t)n;
+    }
+    sb->count = 0;
+    return true;
+}
+
+// Reads until there are count bytes after conn->pos
+static bool VL__DaemonFill(vl__daemon_conn *conn, size_t count)
+{
+    char buf[4096];
+    while(conn->in.count - conn->pos < count) {
+        ssize_t n = read(conn->fd, buf, sizeof(buf));
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) return false;
+        SbAppendBuf(&conn->in, buf, (size_t)n);
+    }
+    return true;
+}
+
+// The line without '\n', valid until the next read
+static bool VL__DaemonReadLine(vl__daemon_conn *conn, view *line)
+{
+    for(;;) {
+        char *start = conn->in.items + conn->pos;
+        char *end = conn->in.count > conn->pos ? (char*)memchr(start, '\n', conn->in.count - conn->pos) : NULL;
+        if(end) {
+            *line = ViewFromParts(start, (size_t)(end - start));
+            conn->pos += line->count + 1;
+            return true;
+        }
+        if(!VL__DaemonFill(conn, conn->in.count - conn->pos + 1)) return false;
+    }
+}
+
+// "<length>\n<bytes>\n", copied to the temporary arena
+static char *VL__DaemonReadString(vl__daemon_conn *conn)
+{
+    view line;
+    u64 length;
+    if(!VL__DaemonReadLine(conn, &line) || !VL__ChopU64(&line, &length)) return NULL;
+    if(!VL__DaemonFill(conn, (size_t)length + 1)) return NULL;
+    char *result = temp_strndup(conn->in.items + conn->pos, (size_t)length);
+    conn->pos += (size_t)length + 1;
+    return result;
+}
+
+static void VL__DaemonAppendString(string_builder *sb, const char *str)
+{
+    SbAppendf(sb, "%zu\n", strlen(str));
+    SbAppendCstr(sb, str);
+    DaAppend(sb, '\n');
+}
+
+static int VL__DaemonConnect(const char *socketPath)
+{
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    if(strlen(socketPath) >= sizeof(addr.sun_path)) {
+        VL_Log(VL_ERROR, "Build daemon socket path '%s' is too long", socketPath);
+        return -1;
+    }
+    strcpy(addr.sun_path, socketPath);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) return -1;
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void VL__DaemonWatch(vl__daemon *daemon, const char *path, bool shallow)
+{
+    for(size_t i = 0; i < daemon->watched.count; i++) {
+        if(strcmp(daemon->watched.items[i], path) == 0) return;
+    }
+    if(!VL_FileExists(path)) return;
+    if(VL_WatchAdd(&daemon->watch, path, .shallow = shallow)) {
+        DaAppend(&daemon->watched, VL__HeapStrndup(path, strlen(path)));
+    }
+}
+
+static size_t VL__DaemonInputSlot(vl__daemon *daemon, const char *path)
+{
+    size_t mask = daemon->inputSlotCount - 1;
+    size_t i = (size_t)VL_HashBytes(path, strlen(path), 0) & mask;
+    while(daemon->inputSlots[i] != 0 && strcmp(daemon->inputs.items[daemon->inputSlots[i] - 1].path, path) != 0) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static vl__daemon_input *VL__DaemonFindInput(vl__daemon *daemon, const char *path)
+{
+    if(daemon->inputSlotCount == 0) return NULL;
+    size_t slot = daemon->inputSlots[VL__DaemonInputSlot(daemon, path)];
+    return slot ? &daemon->inputs.items[slot - 1] : NULL;
+}
+
+static void VL__DaemonAddInput(vl__daemon *daemon, const char *path, size_t id)
+{
+    if((daemon->inputs.count + 1)*2 > daemon->inputSlotCount) {
+        VL_FREE(daemon->inputSlots);
+        daemon->inputSlotCount = daemon->inputSlotCount ? daemon->inputSlotCount*2 : 256;
+        daemon->inputSlots = (size_t*)VL_REALLOC(NULL, daemon->inputSlotCount*sizeof(size_t));
+        Assert(daemon->inputSlots && "Buy more RAM lol");
+        memset(daemon->inputSlots, 0, daemon->inputSlotCount*sizeof(size_t));
+        for(size_t i = 0; i < daemon->inputs.count; i++) {
+            daemon->inputSlots[VL__DaemonInputSlot(daemon, daemon->inputs.items[i].path)] = i + 1;
+        }
+    }
+    size_t slot = VL__DaemonInputSlot(daemon, path);
+    if(daemon->inputSlots[slot] == 0) {
+        vl__daemon_input input = { .path = VL__HeapStrndup(path, strlen(path)) };
+        DaAppend(&daemon->inputs, input);
+        daemon->inputSlots[slot] = daemon->inputs.count;
+    }
+    vl__daemon_input *input = &daemon->inputs.items[daemon->inputSlots[slot] - 1];
+    for(size_t i = 0; i < input->targets.count; i++) {
+        if(input->targets.items[i] == id) return;
+    }
+    DaAppend(&input->targets, id);
+}
+
+// Everything a rebuild check of target reads, the headers come from its depfile (or VL_ScanIncludes for tcc)
+static void VL__DaemonWatchTarget(vl__daemon *daemon, size_t id)
+{
+    vl_target *target = &daemon->graph->items[id];
+    if(target->kind == VL_TARGET_CMD) return;
+    vl_compile_ctx *ctx = &target->ctx;
+    vl__target_inputs *inputs = &daemon->targetInputs.items[id];
+    for(size_t i = VL__TargetInputsUpdate(ctx, inputs); i < inputs->paths.count; i++) {
+        VL__DaemonAddInput(daemon, inputs->paths.items[i], id);
+        VL__DaemonWatch(daemon, inputs->paths.items[i], true);
+    }
+    for(size_t i = 0; i < ctx->includePaths.count; i++) VL__DaemonWatch(daemon, ctx->includePaths.items[i], false);
+}
+
+// The targets that read what changed since the last call are checked again
+static bool VL__DaemonDrain(vl__daemon *daemon)
+{
+    do {
+#if OS_LINUX
+        if(!daemon->watch.polling) {
+            struct pollfd fd = { .fd = daemon->watch.fd, .events = POLLIN };
+            if(poll(&fd, 1, 0) <= 0) return true;
+        }
+#endif
+        // NOTE: 0 wouldn't read anything, polling scans once per call
+        if(!VL_WatchWait(&daemon->watch, 1)) return false;
+        if(daemon->watch.overflowed) {
+            VL_FileTimeInvalidateAll();
+            for(size_t j = 0; j < daemon->graph->count; j++) daemon->clean.items[j] = false;
+            continue;
+        }
+        for(size_t i = 0; i < daemon->watch.changed.count; i++) {
+            const char *path = daemon->watch.changed.items[i];
+            VL_FileTimeInvalidate(path);
+            vl__daemon_input *input = VL__DaemonFindInput(daemon, path);
+            for(size_t j = 0; input && j < input->targets.count; j++) daemon->clean.items[input->targets.items[j]] = false;
+            // NOTE: Until a target has a depfile any header in its include paths could be one of its
+            for(size_t j = 0; j < daemon->graph->count; j++) {
+                if(daemon->clean.items[j] && !daemon->targetInputs.items[j].headersKnown &&
+                   VL__PathInIncludePaths(&daemon->graph->items[j].ctx, path))
+                {
+                    daemon->clean.items[j] = false;
+                }
+            }
+        }
+    } while(!daemon->watch.polling && daemon->watch.changed.count > 0);
+    return true;
+}
+
+/* Stats the output of target, it isn't watched since the builds write it. Returns whether it
+   changed since *stamp (0 when it's missing), the stat cache entry of a changed output is dropped */
+static bool VL__DaemonOutputsChanged(vl_target *target, u64 *stamp)
+{
+    if(target->kind == VL_TARGET_CMD) return false;
+    size_t mark = temp_save();
+    const char *output;
+    if(target->kind == VL_TARGET_LINK) {
+        vl_file_paths objects = {0};
+        output = VL__SeparateObjects(&target->ctx, &objects);
+        DaFree(objects);
+    } else {
+        output = VL_GetFilePathFromCompileCtx(&target->ctx);
+    }
+
+    u64 newStamp = 0;
+    vl_file_stat fileStat;
+    if(VL_GetFileStat(output, &fileStat)) {
+        newStamp = VL_HashBytes(&fileStat.mtime, sizeof(fileStat.mtime), 1 ^ fileStat.size);
+    }
+    bool changed = newStamp != *stamp;
+    if(changed) VL_FileTimeInvalidate(output);
+    *stamp = newStamp;
+    temp_rewind(mark);
+    return changed;
+}
+
+// Same checks as VL__GraphStart, without dependencies
+static bool VL__DaemonTargetDirty(vl__daemon *daemon, vl_target *target)
+{
+    if(target->kind == VL_TARGET_CMD) return true;
+    if(target->kind == VL_TARGET_LINK) {
+        vl_file_paths objects = {0};
+        const char *output = VL__SeparateObjects(&target->ctx, &objects);
+        bool dirty = VL_NeedsRebuild_Impl(output, objects.items, objects.count) != 0 ||
+                     VL__ObjectsChanged(&target->ctx, objects, output);
+        DaFree(objects);
+        return dirty;
+    }
+    bool dirty = VL_Needs_C_Rebuild(&daemon->cmd, &target->ctx) != 0;
+    daemon->cmd.count = 0;
+    return dirty;
+}
+
+static void VL__DaemonAppendCmd(string_builder *out, vl_cmd *cmd)
+{
+    SbAppendf(out, "%zu\n", cmd->count);
+    for(size_t i = 0; i < cmd->count; i++) VL__DaemonAppendString(out, cmd->items[i]);
+    cmd->count = 0;
+}
+
+static bool VL__DaemonAnswerDirty(vl__daemon *daemon, int fd)
+{
+    if(!VL__DaemonDrain(daemon)) return false;
+    vl_build_graph *graph = daemon->graph;
+    string_builder out = {0};
+    size_t countDirty = 0;
+    for(size_t n = 0; n < daemon->order.count; n++) {
+        size_t id = daemon->order.items[n];
+        vl_target *target = &graph->items[id];
+        bool dirty = false;
+        // NOTE: Objects only check themselves, like in VL_GraphRun
+        for(size_t i = 0; !target->object && i < target->deps.count; i++) {
+            if(daemon->dirty.items[target->deps.items[i]]) dirty = true;
+        }
+        // NOTE: Something other than the builds removed or changed an output
+        if(daemon->clean.items[id] && VL__DaemonOutputsChanged(target, &daemon->outputStamps.items[id])) {
+            daemon->clean.items[id] = false;
+        }
+        if(!dirty && !daemon->clean.items[id]) {
+            dirty = VL__DaemonTargetDirty(daemon, target);
+            if(!dirty) VL__DaemonOutputsChanged(target, &daemon->outputStamps.items[id]);
+        }
+        daemon->clean.items[id] = !dirty;
+        daemon->dirty.items[id] = dirty;
+        if(!dirty) continue;
+
+        size_t mark = temp_save();
+        vl_cmd cmds[2] = {0};
+        size_t countCmds = 1;
+        if(target->kind == VL_TARGET_CMD) {
+            DaAppendMany(&cmds[0], target->cmd.items, target->cmd.count);
+        } else if(target->kind == VL_TARGET_LINK) {
+            // NOTE: Nothing is deleted or written while answering, the list is written once a client built it
+            vl_file_paths objects = {0}, pending = {0};
+            const char *output = VL__SeparateObjects(&target->ctx, &objects);
+            bool remake = VL__ObjectsChanged(&target->ctx, objects, output);
+            for(size_t i = 0; i < target->deps.count; i++) {
+                vl_target *dep = &graph->items[target->deps.items[i]];
+                if(dep->object && daemon->dirty.items[target->deps.items[i]]) {
+                    DaAppend(&pending, VL_GetFilePathFromCompileCtx(&dep->ctx));
+                }
+            }
+            if(remake && target->ctx.type == Compile_StaticLibrary) {
+                // NOTE: ar only adds to an archive, the members of removed sources would stay
+                CmdAppend(&cmds[0], "rm", "-f", output);
+                countCmds = 2;
+            }
+            VL__SeparateLinkCmd(&target->ctx, &cmds[countCmds - 1], objects, output, remake, pending);
+            DaFree(objects);
+            DaFree(pending);
+        } else {
+            VL_CCompileCmd(&target->ctx, &cmds[0]);
+        }
+
+        size_t countDeps = 0;
+        for(size_t i = 0; i < target->deps.count; i++) countDeps += daemon->dirty.items[target->deps.items[i]];
+        SbAppendf(&out, "target %zu %zu", id, countDeps);
+        for(size_t i = 0; i < target->deps.count; i++) {
+            if(daemon->dirty.items[target->deps.items[i]]) SbAppendf(&out, " %zu", target->deps.items[i]);
+        }
+        SbAppendf(&out, " %zu\n", countCmds);
+        VL__DaemonAppendString(&out, target->name);
+        for(size_t i = 0; i < countCmds; i++) {
+            VL__DaemonAppendCmd(&out, &cmds[i]);
+            CmdFree(cmds[i]);
+        }
+        countDirty++;
+        temp_rewind(mark);
+    }
+    SbAppendCstr(&out, "end\n");
+    VL_Log(VL_INFO, "Build daemon: %zu of %zu targets out of date", countDirty, graph->count);
+    bool result = VL__DaemonSend(fd, &out);
+    SbFree(out);
+    return result;
+}
+
+static void VL__DaemonBuilt(vl__daemon *daemon, size_t id, bool ok)
+{
+    vl_target *target = &daemon->graph->items[id];
+    size_t mark = temp_save();
+    if(target->kind == VL_TARGET_LINK) {
+        vl_file_paths objects = {0};
+        const char *output = VL__SeparateObjects(&target->ctx, &objects);
+        if(ok) VL__ObjectListWrite(objects, output);
+        VL_FileTimeInvalidate(output);
+        DaFree(objects);
+    } else if(target->kind == VL_TARGET_COMPILE) {
+        VL_FileTimeInvalidate(VL_GetFilePathFromCompileCtx(&target->ctx));
+    }
+    temp_rewind(mark);
+    // NOTE: Commands always run, the rest is up to date until something changes. The headers could be new
+    daemon->clean.items[id] = ok && target->kind != VL_TARGET_CMD;
+    if(ok) {
+        VL__DaemonOutputsChanged(target, &daemon->outputStamps.items[id]);
+        VL__DaemonWatchTarget(daemon, id);
+    }
+}
+
+// Returns false when the client asked to stop
+static bool VL__DaemonServe(vl__daemon *daemon, int fd)
+{
+    vl__daemon_conn conn = { .fd = fd };
+    bool result = true;
+    view line;
+    while(VL__DaemonReadLine(&conn, &line)) {
+        size_t mark = temp_save();
+        if(ViewChopStartsWith(&line, VIEW("dirty"))) {
+            u64 hash;
+            if(ViewChopStartsWith(&line, VIEW(" ")) && (!VL__ChopHex64(&line, &hash) || hash != daemon->graphHash)) {
+                VL_Log(VL_INFO, "Build daemon: the client has another graph, exiting");
+                string_builder out = {0};
+                SbAppendCstr(&out, "stale\n");
+                VL__DaemonSend(fd, &out);
+                SbFree(out);
+                result = false;
+                break;
+            }
+            if(!VL__DaemonAnswerDirty(daemon, fd)) break;
+        } else if(ViewChopStartsWith(&line, VIEW("built "))) {
+            u64 id, ok;
+            if(VL__ChopU64(&line, &id) && VL__ChopU64(&line, &ok) && id < daemon->graph->count) {
+                VL__DaemonBuilt(daemon, (size_t)id, ok != 0);
+            }
+        } else if(ViewEq(line, VIEW("stop"))) {
+            result = false;
+            break;
+        } else {
+            break;
         }
+        temp_rewind(mark);
     }
+    SbFree(conn.in);
+    return result;
+}
+#endif // !OS_WINDOWS
 
-    if(ctx->debug) VL_ccDebug_Opt(info);
-    if(ctx->warnings) VL_ccWarnings_Opt(info);
-    if(ctx->warningsAsErrors) VL_ccWarningsAsErrors_Opt(info);
-    for(size_t i = 0; i < ctx->includePaths.count; i++) {
-        VL_ccIncludepath_Opt(info, ctx->includePaths.items[i]);
+VLIBPROC bool VL_BuildDaemon_Opt(struct VL_BuildDaemon_opts opt)
+{
+    AssertMsg(opt.graph != 0, "Invalid parameter: graph is null");
+#if OS_WINDOWS
+    VL_Log(VL_ERROR, "The build daemon is not available on windows");
+    return false;
+#else
+    const char *socketPath = opt.socketPath ? opt.socketPath : VL_DAEMON_SOCKET;
+    int existing = VL__DaemonConnect(socketPath);
+    if(existing >= 0) {
+        close(existing);
+        VL_Log(VL_ERROR, "A build daemon is already listening on %s", socketPath);
+        return false;
     }
 
-    /* extra compiler flags */
-    DaAppendMany(opt.cmd, ctx->extraCompilerFlags.items, ctx->extraCompilerFlags.count);
-    if(ctx->cc == CCompiler_MSVC) {
-        DaAppendMany(opt.cmd, ctx->extraMsvcFlags.items, ctx->extraMsvcFlags.count);
-    } else {
-        DaAppendMany(opt.cmd, ctx->extraGccClangFlags.items, ctx->extraGccClangFlags.count);
-        if(ctx->cc == CCompiler_GCC) {
-            DaAppendMany(opt.cmd, ctx->extraGccFlags.items, ctx->extraGccFlags.count);
-        } else if(ctx->cc == CCompiler_Clang) {
-            DaAppendMany(opt.cmd, ctx->extraClangFlags.items, ctx->extraClangFlags.count);
+    bool result = true;
+    int listenFd = -1;
+    vl__daemon daemon = {0};
+    daemon.graph = opt.graph;
+    vl_build_graph *graph = opt.graph;
+
+    daemon.graphHash = VL__GraphHash(graph);
+    VL__GraphExpand(graph);
+    for(size_t i = 0; i < graph->count; i++) graph->items[i].dependents.count = 0;
+    for(size_t i = 0; i < graph->count; i++) {
+        vl_target *target = &graph->items[i];
+        for(size_t j = 0; j < target->deps.count; j++) {
+            DaAppend(&graph->items[target->deps.items[j]].dependents, i);
+        }
+    }
+    if(!VL__GraphPrioritize(graph)) VL_ReturnDefer(false);
+    vl_target_ids pending = {0};
+    for(size_t i = 0; i < graph->count; i++) {
+        DaAppend(&pending, graph->items[i].deps.count);
+        if(graph->items[i].deps.count == 0) DaAppend(&daemon.order, i);
+        DaAppend(&daemon.clean, false);
+        DaAppend(&daemon.dirty, false);
+        DaAppend(&daemon.outputStamps, 0);
+        vl__target_inputs inputs = {0};
+        DaAppend(&daemon.targetInputs, inputs);
+    }
+    for(size_t next = 0; next < daemon.order.count; next++) {
+        vl_target *target = &graph->items[daemon.order.items[next]];
+        for(size_t i = 0; i < target->dependents.count; i++) {
+            if(--pending.items[target->dependents.items[i]] == 0) DaAppend(&daemon.order, target->dependents.items[i]);
         }
     }
+    DaFree(pending);
 
-    /* after "/link" in msvc */
-    for(size_t i = 0; i < ctx->libPaths.count; i++) {
-        VL_ccLibpath_Opt(info, ctx->libPaths.items[i]);
+    if(!VL_WatchInit(&daemon.watch, .forcePolling = opt.forcePolling)) VL_ReturnDefer(false);
+    for(size_t i = 0; i < graph->count; i++) VL__DaemonWatchTarget(&daemon, i);
+
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    if(strlen(socketPath) >= sizeof(addr.sun_path)) {
+        VL_Log(VL_ERROR, "Build daemon socket path '%s' is too long", socketPath);
+        VL_ReturnDefer(false);
+    }
+    strcpy(addr.sun_path, socketPath);
+    // NOTE: Left by a daemon that didn't exit cleanly, nothing is listening on it
+    unlink(socketPath);
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listenFd < 0 || bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 8) < 0) {
+        VL_Log(VL_ERROR, "Could not listen on %s: %s", socketPath, strerror(errno));
+        VL_ReturnDefer(false);
     }
+    fcntl(listenFd, F_SETFD, FD_CLOEXEC);
+    VL_Log(VL_INFO, "Build daemon listening on %s (%zu targets, %zu watched paths)",
+           socketPath, graph->count, daemon.watched.count);
 
-    for(size_t i = 0; i < ctx->libs.count; i++) {
-        VL_ccLib_Opt(info, ctx->libs.items[i]);
+    for(;;) {
+        struct pollfd fds[2] = {
+            { .fd = listenFd, .events = POLLIN },
+            { .fd = -1, .events = POLLIN },
+        };
+#if OS_LINUX
+        // NOTE: Events are read as they come so the inotify queue doesn't overflow
+        if(!daemon.watch.polling) fds[1].fd = daemon.watch.fd;
+#endif
+        int status = poll(fds, 2, opt.idleTimeoutMs > 0 ? opt.idleTimeoutMs : -1);
+        if(status < 0) {
+            if(errno == EINTR) continue;
+            VL_Log(VL_ERROR, "Could not poll the build daemon socket: %s", strerror(errno));
+            VL_ReturnDefer(false);
+        }
+        if(status == 0) {
+            VL_Log(VL_INFO, "Build daemon idle for %dms, exiting", opt.idleTimeoutMs);
+            break;
+        }
+        if(fds[1].revents && !VL__DaemonDrain(&daemon)) VL_ReturnDefer(false);
+        if(fds[0].revents & POLLIN) {
+            int client = accept(listenFd, NULL, NULL);
+            if(client < 0) continue;
+            bool keep = VL__DaemonServe(&daemon, client);
+            close(client);
+            if(!keep) break;
+        }
     }
 
-#if OS_WINDOWS
-    if((ctx->cc == CCompiler_MSVC) && !opt.cmd->msvc_linkflags) {
-        CmdAppend(opt.cmd, "/link");
-        opt.cmd->msvc_linkflags = true;
+defer:
+    if(listenFd >= 0) {
+        close(listenFd);
+        unlink(socketPath);
     }
+    VL_WatchFree(&daemon.watch);
+    for(size_t i = 0; i < daemon.watched.count; i++) VL_FREE((char*)daemon.watched.items[i]);
+    DaFree(daemon.watched);
+    DaFree(daemon.order);
+    DaFree(daemon.clean);
+    DaFree(daemon.dirty);
+    DaFree(daemon.outputStamps);
+    for(size_t i = 0; i < daemon.targetInputs.count; i++) VL__TargetInputsFree(&daemon.targetInputs.items[i]);
+    DaFree(daemon.targetInputs);
+    for(size_t i = 0; i < daemon.inputs.count; i++) {
+        VL_FREE((char*)daemon.inputs.items[i].path);
+        DaFree(daemon.inputs.items[i].targets);
+    }
+    DaFree(daemon.inputs);
+    VL_FREE(daemon.inputSlots);
+    CmdFree(daemon.cmd);
+    return result;
 #endif
+}
 
-    if(ctx->type == Compile_DynamicLibrary) {
-        if(ctx->cc == CCompiler_MSVC) {
-            CmdAppend(opt.cmd, "/DLL");
-        } else {
-            CmdAppend(opt.cmd, "-shared");
+VLIBPROC int VL_DaemonBuild_Opt(struct VL_DaemonBuild_opts opt)
+{
+#if OS_WINDOWS
+    (void)opt;
+    return -1;
+#else
+    const char *socketPath = opt.socketPath ? opt.socketPath : VL_DAEMON_SOCKET;
+    int fd = VL__DaemonConnect(socketPath);
+    if(fd < 0) return -1;
+
+    int result = 1;
+    size_t mark = temp_save();
+    vl__daemon_conn conn = { .fd = fd };
+    string_builder out = {0};
+    vl_build_graph graph = {0};
+    // NOTE: A target of the daemon becomes a chain of commands, first..last in graph
+    vl_target_ids ids = {0}, first = {0}, last = {0};
+
+    if(opt.graph) SbAppendf(&out, "dirty %016llx\n", (unsigned long long)VL__GraphHash(opt.graph));
+    else SbAppendCstr(&out, "dirty\n");
+    if(!VL__DaemonSend(fd, &out)) VL_ReturnDefer(0);
+    for(;;) {
+        view line;
+        if(!VL__DaemonReadLine(&conn, &line)) {
+            VL_Log(VL_ERROR, "The build daemon closed the connection");
+            VL_ReturnDefer(0);
+        }
+        if(ViewEq(line, VIEW("stale"))) {
+            VL_Log(VL_INFO, "The build daemon has another graph, it exited");
+            VL_ReturnDefer(-1);
+        }
+        if(ViewEq(line, VIEW("end"))) break;
+
+        u64 id, countDeps, dep, countCmds;
+        vl_target_ids deps = {0};
+        bool ok = ViewChopStartsWith(&line, VIEW("target ")) && VL__ChopU64(&line, &id) && VL__ChopU64(&line, &countDeps);
+        for(u64 i = 0; ok && i < countDeps; i++) {
+            ok = VL__ChopU64(&line, &dep);
+            for(size_t j = 0; ok && j < ids.count; j++) {
+                if(ids.items[j] == dep) DaAppend(&deps, last.items[j]);
+            }
+        }
+        ok = ok && VL__ChopU64(&line, &countCmds) && countCmds > 0;
+        char *name = ok ? VL__DaemonReadString(&conn) : NULL;
+        for(u64 i = 0; name && i < countCmds; i++) {
+            view argcLine;
+            u64 argc;
+            if(!VL__DaemonReadLine(&conn, &argcLine) || !VL__ChopU64(&argcLine, &argc)) {
+                name = NULL;
+                break;
+            }
+            vl_cmd cmd = {0};
+            for(u64 j = 0; j < argc; j++) {
+                char *arg = VL__DaemonReadString(&conn);
+                if(!arg) {
+                    name = NULL;
+                    break;
+                }
+                CmdAppend(&cmd, arg);
+            }
+            if(!name) {
+                CmdFree(cmd);
+                break;
+            }
+            size_t target = VL_GraphAddCmd(&graph, name, cmd);
+            if(i == 0) {
+                DaAppend(&ids, (size_t)id);
+                DaAppend(&first, target);
+                for(size_t j = 0; j < deps.count; j++) VL_GraphDepends(&graph, target, deps.items[j]);
+            } else {
+                VL_GraphDepends(&graph, target, target - 1);
+            }
+        }
+        DaFree(deps);
+        if(!name) {
+            VL_Log(VL_ERROR, "Invalid answer from the build daemon");
+            VL_ReturnDefer(0);
         }
+        DaAppend(&last, graph.count - 1);
     }
 
-    if(!ctx->incremental && (ctx->cc == CCompiler_MSVC)) {
-        CmdAppend(opt.cmd, "-incremental:no");
+    if(graph.count > 0 && !VL_GraphRun(&graph, .maxJobs = opt.maxJobs, .keepGoing = opt.keepGoing,
+                                       .orderedOutput = opt.orderedOutput))
+    {
+        result = 0;
     }
-    if(ctx->gcSections) {
-        if(ctx->cc == CCompiler_MSVC) {
-            CmdAppend(opt.cmd, "-opt:ref");
-        } else {
-            CmdAppend(opt.cmd, "-Wl,--gc-sections");
+    for(size_t i = 0; i < ids.count; i++) {
+        bool built = true;
+        for(size_t j = first.items[i]; j <= last.items[i]; j++) {
+            if(graph.items[j].state != VL_TARGET_DONE) built = false;
         }
+        SbAppendf(&out, "built %zu %d\n", ids.items[i], built);
     }
+    SbAppendCstr(&out, "done\n");
+    VL__DaemonSend(fd, &out);
 
-    bool ok = CmdRun_Opt(opt);
+defer:
+    close(fd);
+    SbFree(out);
+    SbFree(conn.in);
+    VL_GraphFree(&graph);
+    DaFree(ids);
+    DaFree(first);
+    DaFree(last);
+    temp_rewind(mark);
+    return result;
+#endif
+}
 
-    if(ok && ctx->type == Compile_StaticLibrary) {
-        if(ctx->cc == CCompiler_MSVC) {
-            CmdAppend(opt.cmd, "lib", "-nologo", output);
-        } else {
-            CmdAppend(opt.cmd, "ar", "rcs",
-                temp_sprintf("%s/lib%s.a", ctx->outputDir, ctx->output), output);
-        }
+VLIBPROC bool VL_DaemonStop(const char *socketPath)
+{
+#if OS_WINDOWS
+    (void)socketPath;
+    return false;
+#else
+    int fd = VL__DaemonConnect(socketPath ? socketPath : VL_DAEMON_SOCKET);
+    if(fd < 0) return false;
+    string_builder out = {0};
+    SbAppendCstr(&out, "stop\n");
+    bool result = VL__DaemonSend(fd, &out);
+    SbFree(out);
+    close(fd);
+    return result;
+#endif
+}
+
+// The commit checked out in repo, read from its .git directory instead of running git
+static bool VL__GitHead(const char *repo, string_builder *commit)
+{
+    string_builder head = {0}, refs = {0};
+    bool result = true;
+    if(!SbReadEntireFile(temp_sprintf("%s/.git/HEAD", repo), &head)) VL_ReturnDefer(false);
+    view v = ViewTrim(ViewFromParts(head.items, head.count));
+    if(!ViewChopStartsWith(&v, VIEW("ref: "))) {
+        DaAppendMany(commit, v.items, v.count);
+        VL_ReturnDefer(true);
+    }
 
-        if(opt.async) {
-            VL_ProcWait(opt.async->items[opt.async->count - 1]);
+    const char *ref = temp_sprintf("%.*s", (int)v.count, v.items);
+    if(SbReadEntireFile(temp_sprintf("%s/.git/%s", repo, ref), &refs)) {
+        view id = ViewTrim(ViewFromParts(refs.items, refs.count));
+        DaAppendMany(commit, id.items, id.count);
+        VL_ReturnDefer(true);
+    }
+    // NOTE: Refs can be packed, "<commit> <ref>" per line
+    if(!SbReadEntireFile(temp_sprintf("%s/.git/packed-refs", repo), &refs)) VL_ReturnDefer(false);
+    view packed = ViewFromParts(refs.items, refs.count);
+    while(packed.count > 0) {
+        view line = ViewChopByLine(&packed);
+        view id = ViewChopByDelim(&line, ' ');
+        if(ViewEq(ViewTrim(line), v)) {
+            DaAppendMany(commit, id.items, id.count);
+            VL_ReturnDefer(true);
         }
-        ok = CmdRun_Opt(opt);
     }
+    result = false;
 
-    return ok;
+defer:
+    SbFree(head);
+    SbFree(refs);
+    return result;
 }
 
-bool Install_SDL3(vl_cmd *cmd, vl_install_info *info)
-{
-    bool result = true;
-
-    const char *modeStr;
-    const char *directoryOut;
-    const char *cmakeOutDir;
+typedef struct {
+    vl_install_info *info;
+    const char *directoryOut; /* in vendor */
     const char *cmakeGenerator;
     const char *sdlLibName;
+    const char *sdlDllPath; /* the built library, from vendor */
+    const char *modeStr;
+    string_builder stamp;
+    bool built;
+    size_t configureTarget;
+} vl__sdl_variant;
+
+typedef struct {
+    vl__sdl_variant *items;
+    size_t count;
+    size_t capacity;
+} vl__sdl_variants;
+
+static bool VL__SDL3Variant(vl_install_info *info, vl__sdl_variant *variant)
+{
+    variant->info = info;
 #if OS_WINDOWS
     const char *sdlDllName = "SDL3.dll";
 #else
-    (void)sdlLibName; (void)cmakeOutDir;
     const char *sdlDllName = "libSDL3" VL_DLL_EXTENSION;
 #endif
-
+    const char *ccName;
     if(info->cc == CCompiler_MSVC) {
-        directoryOut = "SDL-build-msvc";
-        cmakeGenerator = VL_CMAKE_MSVC_GENERATOR;
-        sdlLibName = "SDL3.lib";
+        ccName = "msvc";
+        variant->cmakeGenerator = VL_CMAKE_MSVC_GENERATOR;
+        variant->sdlLibName = "SDL3.lib";
     } else if(info->cc == CCompiler_GCC) {
-        directoryOut = "SDL-build-gcc";
-        cmakeGenerator = VL_CMAKE_GCC_GENERATOR;
-        sdlLibName = "libSDL3.dll.a";
+        ccName = "gcc";
+        variant->cmakeGenerator = VL_CMAKE_GCC_GENERATOR;
+        variant->sdlLibName = "libSDL3.dll.a";
     } else if(info->cc == CCompiler_Clang) {
-        directoryOut = "SDL-build-clang";
-        cmakeGenerator = VL_CMAKE_CLANG_GENERATOR;
-        sdlLibName = "libSDL3.dll.a";
+        ccName = "clang";
+        variant->cmakeGenerator = VL_CMAKE_CLANG_GENERATOR;
+        variant->sdlLibName = "libSDL3.dll.a";
     } else {
         VL_Log(VL_ERROR, "Unsupported compiler.\n"
                          "Supported compilers: [CCompiler_MSVC, CCompiler_GCC, CCompiler_Clang]");
@@ -1984,25 +8789,136 @@ bool Install_SDL3(vl_cmd *cmd, vl_install_info *info)
     }
 
     if(info->mode == VL_INSTALL_MODE_RELEASE) {
-        modeStr = "Release";
+        variant->modeStr = "Release";
     } else if(info->mode == VL_INSTALL_MODE_RELEASE_WITH_DEBUG) {
-        modeStr = "RelWithDebInfo";
+        variant->modeStr = "RelWithDebInfo";
     } else if(info->mode == VL_INSTALL_MODE_DEBUG) {
-        modeStr = "Debug";
+        variant->modeStr = "Debug";
     } else {
         VL_Log(VL_ERROR, "Unknown install mode\n"
                          "supported modes are: [VL_INSTALL_MODE_RELEASE, VL_INSTALL_MODE_RELEASE_WITH_DEBUG, VL_INSTALL_MODE_DEBUG]");
         return false;
     }
 
-    uint64_t tempMark = temp_save();
+#if VL_CMAKE_USE_NINJA
+    if(info->cc != CCompiler_MSVC && VL_temp_FindExecutable("ninja")) variant->cmakeGenerator = "Ninja";
+#endif
+    variant->directoryOut = temp_sprintf("SDL-build-%s-%s", ccName, variant->modeStr);
+    if(info->cc == CCompiler_MSVC) {
+        // NOTE: The Visual Studio generator puts the outputs in a directory per mode
+        variant->sdlDllPath = temp_sprintf("%s/%s/%s", variant->directoryOut, variant->modeStr, sdlDllName);
+    } else {
+        variant->sdlDllPath = temp_sprintf("%s/%s", variant->directoryOut, sdlDllName);
+    }
+    return true;
+}
+
+// A build directory made with another generator (Ninja was installed) can't be configured again
+static void VL__CMakeCheckGenerator(const char *directory, const char *generator)
+{
+    const char *cachePath = temp_sprintf("%s/CMakeCache.txt", directory);
+    string_builder cache = {0};
+    if(VL_FileExists(cachePath) && SbReadEntireFile(cachePath, &cache)) {
+        view v = ViewFromParts(cache.items, cache.count);
+        while(v.count > 0) {
+            view line = ViewChopByLine(&v);
+            if(ViewChopStartsWith(&line, VIEW("CMAKE_GENERATOR:INTERNAL="))) {
+                if(!ViewEq(ViewTrim(line), ViewFromCstr(generator))) VL_DeleteFile(cachePath);
+                break;
+            }
+        }
+    }
+    SbFree(cache);
+}
+
+// Makes the installed files (lib, dynamic_libs) the ones of variant, from vendor
+static bool VL__SDL3InstallVariant(vl__sdl_variant *variant)
+{
+    bool result = true;
+    vl_install_info *info = variant->info;
 #if OS_WINDOWS
-    bool skipped = VL_FileExists("dynamic_libs/SDL3.dll");
+    const char *newDllPath = "../dynamic_libs/SDL3.dll";
+    MkdirIfNotExist("../dynamic_libs");
+    if(info->cc == CCompiler_MSVC) {
+        const char *cmakeOutDir = temp_sprintf("%s/%s", variant->directoryOut, variant->modeStr);
+        if(!VL_CopyDirectoryRecursively(cmakeOutDir, "../dynamic_libs", VL_DLL_EXTENSION)) {
+            VL_Log(VL_ERROR, "Could not copy SDL3 dlls");
+            return false;
+        }
+        if(info->mode != VL_INSTALL_MODE_RELEASE) {
+            if(!VL_CopyDirectoryRecursively(cmakeOutDir, "../dynamic_libs", ".pdb")) {
+                VL_Log(VL_ERROR, "Could not copy SDL3 pdbs");
+                return false;
+            }
+        }
+    } else {
+        if(!VL_CopyFile(variant->sdlDllPath, newDllPath)) {
+            VL_Log(VL_ERROR, "Could not copy SDL3 dll");
+            return false;
+        }
+    }
+
+    MkdirIfNotExist("../lib");
+    const char *sdlLibNewPath = temp_sprintf("../lib/%s", variant->sdlLibName);
+    const char *oldPath;
+    if(info->cc == CCompiler_MSVC) {
+        oldPath = temp_sprintf("%s/%s/%s", variant->directoryOut, variant->modeStr, variant->sdlLibName);
+    } else {
+        oldPath = temp_sprintf("%s/%s", variant->directoryOut, variant->sdlLibName);
+    }
+    if(!VL_CopyFile(oldPath, sdlLibNewPath)) {
+        VL_Log(VL_ERROR, "Could not copy %s", variant->sdlLibName);
+        return false;
+    }
 #else
-    bool skipped = VL_FileExists("dynamic_libs/libSDL3.so");
+    (void)info;
+    const char *sdlDllName = "libSDL3" VL_DLL_EXTENSION;
+    char buf[2048];
+    char *realPath = realpath(variant->sdlDllPath, buf);
+    if(!realPath) {
+        VL_Log(VL_ERROR, "Could not get real path from SDL" VL_DLL_EXTENSION " symlink");
+        return false;
+    }
+
+    MkdirIfNotExist("../dynamic_libs");
+    MkdirIfNotExist("../lib");
+
+    const char *links[] = {
+        temp_sprintf("../lib/%s", sdlDllName),
+        temp_sprintf("../dynamic_libs/%s", sdlDllName),
+        temp_sprintf("../lib/%s.0", sdlDllName),
+        temp_sprintf("../dynamic_libs/%s.0", sdlDllName),
+    };
+    for(size_t i = 0; result && i < ArrayLen(links); i++) {
+        // NOTE: They point to the variant installed before
+        if(unlink(links[i]) == -1 && errno != ENOENT) result = false;
+        if(result && symlink(realPath, links[i]) == -1) result = false;
+    }
+    if(!result) {
+        VL_Log(VL_ERROR, "Could not create symlink to SDL3" VL_DLL_EXTENSION ": %s", strerror(errno));
+    }
 #endif
-    if(skipped) {
-        goto get_info;
+    return result;
+}
+
+bool Install_SDL3Variants(vl_cmd *cmd, vl_install_info *infos, size_t count)
+{
+    bool result = true;
+    vl__sdl_variants variants = {0};
+    vl_build_graph graph = {0};
+    string_builder commit = {0};
+    string_builder old = {0};
+    size_t stale = 0;
+    AssertMsg(count > 0, "Install_SDL3Variants needs at least one variant");
+
+    uint64_t tempMark = temp_save();
+    for(size_t i = 0; i < count; i++) {
+        vl__sdl_variant variant = {0};
+        if(!VL__SDL3Variant(&infos[i], &variant)) {
+            DaFree(variants);
+            return false;
+        }
+        DaAppend(&variants, variant);
     }
 
     MkdirIfNotExist("vendor");
@@ -2016,129 +8932,137 @@ bool Install_SDL3(vl_cmd *cmd, vl_install_info *info)
             VL_ReturnDefer(false);
         }
     }
-
-    CmdAppend(cmd, "cmake", "-S", "SDL", "-B", directoryOut, "-G", cmakeGenerator);
-    if(info->cc == CCompiler_GCC) {
-        CmdAppend(cmd, "-DCMAKE_C_COMPILER=gcc", "-DCMAKE_CXX_COMPILER=g++");
-    } else if(info->cc == CCompiler_Clang) {
-        CmdAppend(cmd, "-DCMAKE_C_COMPILER=clang", "-DCMAKE_CXX_COMPILER=clang++");
-    }
-    if(!CmdRun(cmd)) {
-        VL_Log(VL_ERROR, "Could not configure build");
-        VL_ReturnDefer(false);
+    if(!VL__GitHead("SDL", &commit)) {
+        VL_Log(VL_WARNING, "Could not get the commit of vendor/SDL, a new one won't be rebuilt");
+        commit.count = 0;
+        SbAppendCstr(&commit, "unknown");
     }
 
-    CmdAppend(cmd, "cmake", "--build", directoryOut, "--config", modeStr);
-    if(!CmdRun(cmd)) {
-        VL_Log(VL_ERROR, "Could not build SDL");
-        VL_ReturnDefer(false);
-    }
+    for(size_t i = 0; i < variants.count; i++) {
+        vl__sdl_variant *variant = &variants.items[i];
+        if(variant->info == NULL) continue;
+        vl_cmd configure = {0};
+        CmdAppend(&configure, "cmake", "-S", "SDL", "-B", variant->directoryOut, "-G", variant->cmakeGenerator,
+                  temp_sprintf("-DCMAKE_BUILD_TYPE=%s", variant->modeStr));
+        if(variant->info->cc == CCompiler_GCC) {
+            CmdAppend(&configure, "-DCMAKE_C_COMPILER=gcc", "-DCMAKE_CXX_COMPILER=g++");
+        } else if(variant->info->cc == CCompiler_Clang) {
+            CmdAppend(&configure, "-DCMAKE_C_COMPILER=clang", "-DCMAKE_CXX_COMPILER=clang++");
+        }
+        DaAppendMany(&configure, variant->info->cmakeFlags.items, variant->info->cmakeFlags.count);
+
+        SbAppendf(&variant->stamp, "commit %.*s\nmode %s\ndirectory %s\nconfigure %016llx\n", (int)commit.count,
+                  commit.items, variant->modeStr, variant->directoryOut, (unsigned long long)VL__CmdHash(&configure, 0));
+        const char *stampPath = temp_sprintf("%s/vl-install.stamp", variant->directoryOut);
+        old.count = 0;
+        if(VL_FileExists(variant->sdlDllPath) && VL_FileExists(stampPath) && SbReadEntireFile(stampPath, &old) &&
+           old.count == variant->stamp.count && memcmp(old.items, variant->stamp.items, old.count) == 0)
+        {
+            CmdFree(configure);
+            continue;
+        }
 
-    if(info->installDir) {
-        CmdAppend(cmd, "cmake", "--install", directoryOut, "--config", modeStr, "--prefix", info->installDir);
-        if(!CmdRun(cmd)) {
-            VL_Log(VL_ERROR, "Could not intall SDL in '%s' directory", info->installDir);
-            VL_ReturnDefer(false);
+        // NOTE: The same variant twice would build in the same directory at once
+        for(size_t j = i + 1; j < variants.count; j++) {
+            if(strcmp(variants.items[j].directoryOut, variant->directoryOut) == 0) variants.items[j].info = NULL;
         }
+        VL__CMakeCheckGenerator(variant->directoryOut, variant->cmakeGenerator);
+        variant->configureTarget = VL_GraphAddCmd(&graph, temp_sprintf("configure %s", variant->directoryOut), configure);
+        variant->built = true;
+        stale++;
     }
 
-    if(!VL_FileExists("../include/SDL3")) {
-        MkdirIfNotExist("../include");
-        if(!VL_CopyDirectoryRecursively("SDL/include/SDL3", "../include/SDL3")) {
-            VL_Log(VL_ERROR, "Could not copy SDL3 include directory");
+    if(stale > 0) {
+        // NOTE: The variants build at the same time, the cores are split between them.
+        // With a jobserver make and ninja take tokens from it instead
+        bool jobserver = VL_JobserverActive();
+        int jobs = VL_GetCountProcs() / (int)stale;
+        if(jobs < 1) jobs = 1;
+        for(size_t i = 0; i < variants.count; i++) {
+            vl__sdl_variant *variant = &variants.items[i];
+            if(!variant->built) continue;
+            vl_cmd build = {0};
+            CmdAppend(&build, "cmake", "--build", variant->directoryOut, "--config", variant->modeStr);
+            if(!jobserver) CmdAppend(&build, "-j", temp_sprintf("%d", jobs));
+            size_t buildTarget = VL_GraphAddCmd(&graph, temp_sprintf("build %s", variant->directoryOut), build);
+            VL_GraphDepends(&graph, buildTarget, variant->configureTarget);
+        }
+        if(!VL_GraphRun(&graph, .maxJobs = stale)) {
+            VL_Log(VL_ERROR, "Could not build SDL");
             VL_ReturnDefer(false);
         }
     }
 
-    cmakeOutDir = temp_sprintf("%s/%s", directoryOut, modeStr);
-    const char *newDllPath = temp_sprintf("../dynamic_libs/%s", sdlDllName);
-    if(!VL_FileExists(newDllPath)) {
-#if OS_WINDOWS
-        if(info->cc == CCompiler_MSVC) {
-            
-            if(!VL_CopyDirectoryRecursively(cmakeOutDir, "../dynamic_libs", VL_DLL_EXTENSION)) {
-                VL_Log(VL_ERROR, "Could not copy SDL3 dlls");
-                VL_ReturnDefer(false);
-            }
-            if(info->mode != VL_INSTALL_MODE_RELEASE) {
-                if(!VL_CopyDirectoryRecursively(cmakeOutDir, "../dynamic_libs", ".pdb")) {
-                    VL_Log(VL_ERROR, "Could not copy SDL3 pdbs");
-                    VL_ReturnDefer(false);
-                }
-            }
-        } else {
-            if(!VL_CopyFile(temp_sprintf("%s/%s", directoryOut, sdlDllName), newDllPath)) {
-                VL_Log(VL_ERROR, "Could not copy SDL3 dll");
+    for(size_t i = 0; i < variants.count; i++) {
+        vl__sdl_variant *variant = &variants.items[i];
+        if(!variant->built) continue;
+        if(variant->info->installDir) {
+            CmdAppend(cmd, "cmake", "--install", variant->directoryOut, "--config", variant->modeStr,
+                      "--prefix", variant->info->installDir);
+            if(!CmdRun(cmd)) {
+                VL_Log(VL_ERROR, "Could not intall SDL in '%s' directory", variant->info->installDir);
                 VL_ReturnDefer(false);
             }
         }
-#else
-        char buf[2048];
-        char *realPath = realpath(temp_sprintf("%s/%s", directoryOut, sdlDllName), buf);
-        if(!realPath) {
-            VL_Log(VL_ERROR, "Could not get real path from SDL" VL_DLL_EXTENSION " symlink");
-            VL_ReturnDefer(false);
+        const char *stampPath = temp_sprintf("%s/vl-install.stamp", variant->directoryOut);
+        if(!VL__WriteFileAtomic(stampPath, variant->stamp.items, variant->stamp.count)) {
+            VL_Log(VL_ERROR, "Could not write %s: %s", stampPath, VL_GetError());
         }
+    }
 
-        MkdirIfNotExist("../dynamic_libs");
-        MkdirIfNotExist("../lib");
-
-        const char *unversionedLib = temp_sprintf("../lib/%s", sdlDllName);
-        const char *unversionedDll = newDllPath;
-
-        const char *versionedLib = temp_sprintf("../lib/%s.0", sdlDllName);
-        const char *versionedDll = temp_sprintf("../dynamic_libs/%s.0", sdlDllName);
-
-        if((symlink(realPath, unversionedLib) == -1) ||
-           (symlink(realPath, unversionedDll) == -1) ||
-           (symlink(realPath, versionedLib) == -1) ||
-           (symlink(realPath, versionedDll) == -1))
-        {
-            VL_Log(VL_ERROR, "Could not create symlink to SDL3" VL_DLL_EXTENSION ": %s", strerror(errno));
+    if(!VL_FileExists("../include/SDL3")) {
+        MkdirIfNotExist("../include");
+        if(!VL_CopyDirectoryRecursively("SDL/include/SDL3", "../include/SDL3")) {
+            VL_Log(VL_ERROR, "Could not copy SDL3 include directory");
             VL_ReturnDefer(false);
         }
-#endif
     }
 
-#if OS_WINDOWS
-    const char *sdlLibNewPath = temp_sprintf("../lib/%s", sdlLibName);
-    if(!VL_FileExists(sdlLibNewPath)) {
-        MkdirIfNotExist("../lib");
-        const char *oldPath;
-        if(info->cc == CCompiler_MSVC) {
-            oldPath = temp_sprintf("%s/%s", cmakeOutDir, sdlLibName);
-        } else {
-            oldPath = temp_sprintf("%s/%s", directoryOut, sdlLibName);
-        }
-        if(!VL_CopyFile(oldPath, sdlLibNewPath)) {
-            VL_Log(VL_ERROR, "Could not copy %s", sdlLibName);
-            VL_ReturnDefer(false);
+    // NOTE: "SDL-installed" has the directory of what's in lib and dynamic_libs
+    old.count = 0;
+    vl__sdl_variant *installed = &variants.items[0];
+    if(installed->built || !SbReadEntireFile("SDL-installed", &old) || old.count != strlen(installed->directoryOut) ||
+       memcmp(old.items, installed->directoryOut, old.count) != 0)
+    {
+        if(!VL__SDL3InstallVariant(installed)) VL_ReturnDefer(false);
+        if(!VL__WriteFileAtomic("SDL-installed", installed->directoryOut, strlen(installed->directoryOut))) {
+            VL_Log(VL_ERROR, "Could not write SDL-installed: %s", VL_GetError());
         }
     }
-#endif
 
-get_info:
-    info->libs.items = 0;
-    info->libs.count = 0;
-    info->libs.capacity = 0;
-    info->extraCompilerFlags.items = 0;
-    info->extraCompilerFlags.count = 0;
-    info->extraCompilerFlags.capacity = 0;
+    for(size_t i = 0; i < count; i++) {
+        vl_install_info *info = &infos[i];
+        info->libs.items = 0;
+        info->libs.count = 0;
+        info->libs.capacity = 0;
+        info->extraCompilerFlags.items = 0;
+        info->extraCompilerFlags.count = 0;
+        info->extraCompilerFlags.capacity = 0;
 #if OS_WINDOWS
-    // NOTE: SDL3.lib or libSDL3.dll.a
-    DaAppend(&info->libs, (info->cc == CCompiler_MSVC) ? "SDL3" : "SDL3.dll");
+        // NOTE: SDL3.lib or libSDL3.dll.a
+        DaAppend(&info->libs, (info->cc == CCompiler_MSVC) ? "SDL3" : "SDL3.dll");
 #else
-    DaAppend(&info->libs, "SDL3");
-    DaAppend(&info->extraCompilerFlags, "-Wl,-rpath,$ORIGIN/lib");
+        DaAppend(&info->libs, "SDL3");
+        DaAppend(&info->extraCompilerFlags, "-Wl,-rpath,$ORIGIN/lib");
 #endif
-    if(skipped) return true;
+    }
 
 defer:
+    for(size_t i = 0; i < variants.count; i++) SbFree(variants.items[i].stamp);
+    DaFree(variants);
+    VL_GraphFree(&graph);
+    SbFree(commit);
+    SbFree(old);
     temp_rewind(tempMark);
     VL_SetCurrentDir("..");
     return result;
 }
 
+bool Install_SDL3(vl_cmd *cmd, vl_install_info *info)
+{
+    return Install_SDL3Variants(cmd, info, 1);
+}
+
 #if OS_WINDOWS
 static void Win32_CmdQuote(vl_cmd cmd, string_builder *quoted)
 {
@@ -2228,52 +9152,151 @@ VLIBPROC vl_proc VL_CmdStartProcess(vl_cmd cmd, vl_fd *fdin, vl_fd *fdout, vl_fd
     }
 
     CloseHandle(piProcInfo.hThread);
+    VL__TraceProcStart(piProcInfo.hProcess, cmd);
 
     return piProcInfo.hProcess;
 #else
-    pid_t cpid = fork();
-    if(cpid < 0) {
-        VL_Log(VL_ERROR, "Could not fork child process: %s", strerror(errno));
-        return VL_INVALID_PROC;
+    // NOTE: posix_spawn doesn't copy the page tables like fork (glibc uses clone(CLONE_VM|CLONE_VFORK)),
+    // which matters when a big build process starts hundreds of compiler jobs
+    vl_cmd cmdNull = {0};
+    DaAppendMany(&cmdNull, cmd.items, cmd.count);
+    CmdAppend(&cmdNull, NULL);
+
+    posix_spawn_file_actions_t actions;
+    int err = posix_spawn_file_actions_init(&actions);
+    if(err == 0 && fdin) err = posix_spawn_file_actions_adddup2(&actions, *fdin, STDIN_FILENO);
+    if(err == 0 && fdout) err = posix_spawn_file_actions_adddup2(&actions, *fdout, STDOUT_FILENO);
+    if(err == 0 && fderr) err = posix_spawn_file_actions_adddup2(&actions, *fderr, STDERR_FILENO);
+
+    pid_t cpid = VL_INVALID_PROC;
+    if(err == 0) {
+        err = posix_spawnp(&cpid, cmd.items[0], &actions, NULL, (char * const*)cmdNull.items, environ);
+        if(err != 0) {
+            VL_Log(VL_ERROR, "Could not spawn child process for %s: %s", cmd.items[0], strerror(err));
+            cpid = VL_INVALID_PROC;
+        }
+    } else {
+        VL_Log(VL_ERROR, "Could not setup redirects for child process: %s", strerror(err));
     }
+    posix_spawn_file_actions_destroy(&actions);
+    DaFree(cmdNull);
+    if(cpid != VL_INVALID_PROC) VL__TraceProcStart(cpid, cmd);
 
-    if(cpid == 0) {
-        if(fdin) {
-            if(dup2(*fdin, STDIN_FILENO) < 0) {
-                VL_Log(VL_ERROR, "Could not setup stdin for child process: %s", strerror(errno));
-                exit(1);
-            }
-        }
+    return cpid;
+#endif
+}
 
-        if(fdout) {
-            if(dup2(*fdout, STDOUT_FILENO) < 0) {
-                VL_Log(VL_ERROR, "Could not setup stdout for child process: %s", strerror(errno));
-                exit(1);
-            }
-        }
+#if (COMPILER_GCC || COMPILER_CLANG) && !defined(VL_REBUILD_URSELF_NO_DEPFILE)
+# define VL__REBUILD_URSELF_DEPFILE 1
+#else
+# define VL__REBUILD_URSELF_DEPFILE 0
+#endif
 
-        if(fderr) {
-            if(dup2(*fderr, STDERR_FILENO) < 0) {
-                VL_Log(VL_ERROR, "Could not setup stderr for child process: %s", strerror(errno));
-                exit(1);
-            }
-        }
+// The current time in the units of vl_file_stat.mtime
+static u64 VL__FileTimeNow(void)
+{
+#if OS_WINDOWS
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    return ((u64)now.dwHighDateTime << 32) | now.dwLowDateTime;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (u64)now.tv_sec*1000000000ull + (u64)now.tv_nsec;
+#endif
+}
 
-        // NOTE: This leaks a bit of memory in the child process.
-        // But do we actually care? It's a one off leak anyway...
-        vl_cmd cmdNull = {0};
-        DaAppendMany(&cmdNull, cmd.items, cmd.count);
-        CmdAppend(&cmdNull, NULL);
+// Whether the files in the manifest of the running build still look the same, without comparing them to anything else
+static bool VL__RebuildManifestUpToDate(const char *manifestPath, u64 id)
+{
+    string_builder data = {0};
+    if(!VL_FileExists(manifestPath) || !SbReadEntireFile(manifestPath, &data)) return false;
+    SbAppendNull(&data);
+
+    bool result = false;
+    char *end;
+    char *line = data.items;
+    if(strncmp(line, "vl-rebuild ", 11) != 0 || strtoull(line + 11, &end, 16) != id || *end != '\n') VL_ReturnDefer(false);
+    line = end + 1;
+    while(*line) {
+        u64 mtime = strtoull(line, &end, 10);
+        u64 size = strtoull(end, &end, 10);
+        if(*end != ' ') VL_ReturnDefer(false);
+        char *path = end + 1;
+        char *newline = strchr(path, '\n');
+        if(!newline) VL_ReturnDefer(false);
+        *newline = '\0';
+        line = newline + 1;
+
+        vl_file_stat fileStat;
+        if(!VL_GetFileStat(path, &fileStat) || fileStat.mtime != mtime || fileStat.size != size) VL_ReturnDefer(false);
+    }
+    result = true;
 
-        if(execvp(cmd.items[0], (char * const*) cmdNull.items) < 0) {
-            VL_Log(VL_ERROR, "Could not exec child process for %s: %s", cmd.items[0], strerror(errno));
-            exit(1);
-        }
-        Assert(!"unreachable");
+defer:
+    SbFree(data);
+    return result;
+}
+
+// Files that changed at or after startTime are recorded with time 0 so the next check never trusts them
+static bool VL__RebuildWriteManifest(const char *manifestPath, u64 id, vl_file_paths deps, u64 startTime)
+{
+    string_builder manifest = {0};
+    SbAppendf(&manifest, "vl-rebuild %016llx\n", (unsigned long long)id);
+    for(size_t i = 0; i < deps.count; i++) {
+        vl_file_stat fileStat;
+        if(!VL_GetFileStat(deps.items[i], &fileStat)) continue;
+        u64 mtime = fileStat.mtime >= startTime ? 0 : fileStat.mtime;
+        SbAppendf(&manifest, "%llu %llu %s\n", (unsigned long long)mtime, (unsigned long long)fileStat.size, deps.items[i]);
     }
+    bool result = VL__WriteFileAtomic(manifestPath, manifest.items, manifest.count);
+    SbFree(manifest);
+    return result;
+}
 
-    return cpid;
+// Set for the rebuilt binary, which doesn't check again and takes it out of the environment of its children
+#define VL__REBUILT_ENV "VL_REBUILT_URSELF"
+
+static void VL__RebuiltEnvSet(bool set)
+{
+#if OS_WINDOWS
+    SetEnvironmentVariableA(VL__REBUILT_ENV, set ? "1" : NULL);
+#else
+    if(set) setenv(VL__REBUILT_ENV, "1", 1);
+    else unsetenv(VL__REBUILT_ENV);
+#endif
+}
+
+// The files a build depends on: the listed ones and every header they include
+static void VL__RebuildUrselfDeps(const char **src_paths, size_t path_count, const char *depPath, vl_file_paths *deps)
+{
+    vl_compile_ctx ctx = {0};
+    ctx.sourceFiles.items = src_paths;
+    ctx.sourceFiles.count = path_count;
+    DaAppendMany(deps, src_paths, path_count);
+#if VL__REBUILD_URSELF_DEPFILE
+    string_builder data = {0};
+    if(depPath && SbReadEntireFile(depPath, &data)) {
+        SbAppendNull(&data);
+        VL__ParseDeps(&ctx, data.items, data.count - 1, deps);
+        // NOTE: The paths point into data, they're copied before it's freed
+        for(size_t i = path_count; i < deps->count; i++) deps->items[i] = temp_strdup(deps->items[i]);
+        VL_DeleteFile(depPath);
+        SbFree(data);
+        return;
+    }
+    SbFree(data);
+#else
+    (void)depPath;
 #endif
+    // NOTE: The scanner skips "#include VICLIB_PATH", this header knows where both are
+    VL_ScanIncludes(&ctx, deps);
+    const char *headers[] = { __FILE__, VL__temp_IncludePath(VL__PathDirView(__FILE__), VIEW(VICLIB_PATH)) };
+    for(size_t i = 0; i < ArrayLen(headers); i++) {
+        bool found = !VL_FileExists(headers[i]);
+        for(size_t j = 0; !found && j < deps->count; j++) found = strcmp(deps->items[j], headers[i]) == 0;
+        if(!found) DaAppend(deps, temp_strdup(headers[i]));
+    }
 }
 
 VLIBPROC void VL__GoRebuildUrself(int argc, char **argv, const char **src_paths, size_t path_count)
@@ -2283,7 +9306,13 @@ VLIBPROC void VL__GoRebuildUrself(int argc, char **argv, const char **src_paths,
     // the debugger to get confused since it doesn't know that
     // the new process is the one that it needs to debug
     if(IsDebuggerPresent()) return;
+    // NOTE: Whatever the manifest says, a binary that was just rebuilt never rebuilds itself in a loop
+    if(getenv(VL__REBUILT_ENV)) {
+        VL__RebuiltEnvSet(false);
+        return;
+    }
 
+    char **args = argv;
     const char *bin_path = *argv;
     argc--;
     argv++;
@@ -2294,26 +9323,78 @@ VLIBPROC void VL__GoRebuildUrself(int argc, char **argv, const char **src_paths,
         bin_path = temp_sprintf("%s.exe", bin_path);
     }
 #endif
+    const char *manifest_path = temp_sprintf("%s.deps", bin_path);
 
-    int rebuild_is_needed = VL_NeedsRebuild_Impl(bin_path, src_paths, path_count);
+#ifdef VL_REBUILD_URSELF_ID
+    // NOTE: No other check is needed while every file the build used is as it was
+    if(VL__RebuildManifestUpToDate(manifest_path, VL_REBUILD_URSELF_ID)) return;
+    int rebuild_is_needed = 1;
+#else
+    // NOTE: Not built by this function, so the manifest is tied to the binary's own time and size instead of an id.
+    // The includes are only scanned while there's no such manifest, which is written once the binary is up to date
+    int rebuild_is_needed = 1;
+    u64 bin_id = 0;
+    vl_file_stat bin_stat;
+    if(VL_GetFileStat(bin_path, &bin_stat)) {
+        bin_id = VL_HashBytes(&bin_stat.mtime, sizeof(bin_stat.mtime), VL_HashBytes(&bin_stat.size, sizeof(bin_stat.size), 0));
+        if(VL__RebuildManifestUpToDate(manifest_path, bin_id)) return;
+    }
+    {
+        u64 scan_time = VL__FileTimeNow();
+        vl_file_paths inputs = {0};
+        VL__RebuildUrselfDeps(src_paths, path_count, NULL, &inputs);
+        rebuild_is_needed = VL_NeedsRebuild_Impl(bin_path, inputs.items, inputs.count);
+        if(rebuild_is_needed == 0 && bin_id) VL__RebuildWriteManifest(manifest_path, bin_id, inputs, scan_time);
+        DaFree(inputs);
+    }
+#endif
     if(rebuild_is_needed < 0) exit(1);
     if(!rebuild_is_needed) return;
 
     vl_cmd cmd = {0};
 
     const char *old_bin_path = temp_sprintf("%s.old", bin_path);
+    const char *dep_path = temp_sprintf("%s.d", bin_path);
+    // NOTE: Any value that's new each build works as the id
+    u64 now = VL_GetNanos();
+    u64 id = VL_HashBytes(&now, sizeof(now), VL_HashBytes(bin_path, strlen(bin_path), 0));
+    // NOTE: A file changed while compiling could have been read before the change, it's rebuilt next time
+    u64 start_time = VL__FileTimeNow();
 
     if(!VL_Rename(bin_path, old_bin_path)) exit(1);
     CmdAppend(&cmd, VL_REBUILD_URSELF(bin_path, src_paths[0]));
+    CmdAppend(&cmd, temp_sprintf("-DVL_REBUILD_URSELF_ID=0x%016llxULL", (unsigned long long)id));
+#if VL__REBUILD_URSELF_DEPFILE
+    CmdAppend(&cmd, "-MMD", "-MF", dep_path);
+#endif
     if(!CmdRun(&cmd)) {
         VL_Rename(old_bin_path, bin_path);
         exit(1);
     }
 #ifdef VL_EXPERIMENTAL_DELETE_OLD
     // NOTE: Must not delete on windows at least
-    VL_DeleteFile(old_binary_path);
+    VL_DeleteFile(old_bin_path);
 #endif
 
+    vl_file_paths deps = {0};
+    VL__RebuildUrselfDeps(src_paths, path_count, dep_path, &deps);
+    bool written = VL__RebuildWriteManifest(manifest_path, id, deps, start_time);
+    DaFree(deps);
+    if(!written) {
+        VL_Log(VL_ERROR, "Could not write %s, %s would rebuild itself on every run", manifest_path, bin_path);
+        exit(1);
+    }
+    VL__RebuiltEnvSet(true);
+
+#if !OS_WINDOWS
+    // NOTE: Same pid, same stdio, nothing waits for a child
+    fflush(stdout);
+    fflush(stderr);
+    execv(bin_path, args);
+    VL_Log(VL_WARNING, "Could not exec %s: %s, running it as a child", bin_path, strerror(errno));
+#else
+    (void)args;
+#endif
     CmdAppend(&cmd, bin_path);
     DaAppendMany(&cmd, argv, argc);
     if(!CmdRun(&cmd)) exit(1);
@@ -3,6 +3,10 @@
 #ifndef VL_SERIALIZE_H
 #define VL_SERIALIZE_H
 
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE
+#endif
+
 #include <math.h>
 #include <float.h> /* NAN */
 #include <stdint.h>
@@ -181,6 +185,12 @@ SERIALIZE_PROC void VL_SerializeFloat(vl_serialize_context *ctx, double val);
 SERIALIZE_PROC void VL_SerializeString(vl_serialize_context *ctx, const char *s);
 SERIALIZE_PROC void VL_SerializeView(vl_serialize_context *ctx, view v);
 
+/* Writes the events recorded since VL_TraceEnable (see vl_build.h) as Chrome trace-event JSON,
+ * open it in chrome://tracing or ui.perfetto.dev. Processes are shown in the job slot they ran in */
+SERIALIZE_PROC bool VL_TraceSave(const char *path);
+/* Enables tracing and saves it to path when the program exits */
+SERIALIZE_PROC void VL_TraceSaveAtExit(const char *path);
+
 #ifdef VL_SERIALIZE_IMPLEMENTATION
 
 static vl_serialize_scope *VL__SerializeScopePush(vl_serialize_context *ctx, vl_serialize_scope_type type)
@@ -1181,5 +1191,109 @@ SERIALIZE_PROC void VL_SerializeView(vl_serialize_context *ctx, view v)
     ctx->ElementEnd(ctx);
 }
 
+
+static void VL__TraceThreadName(vl_serialize_context *ctx, int64_t tid, const char *name)
+{
+    VL_ObjectBegin(ctx);
+        VL_AttributeName(ctx, "name");
+        VL_SerializeString(ctx, "thread_name");
+        VL_AttributeName(ctx, "ph");
+        VL_SerializeString(ctx, "M");
+        VL_AttributeName(ctx, "pid");
+        VL_SerializeInt(ctx, 1);
+        VL_AttributeName(ctx, "tid");
+        VL_SerializeInt(ctx, tid);
+        VL_AttributeName(ctx, "args");
+        VL_ObjectBegin(ctx);
+            VL_AttributeName(ctx, "name");
+            VL_SerializeString(ctx, name);
+        VL_ObjectEnd(ctx);
+    VL_ObjectEnd(ctx);
+}
+
+SERIALIZE_PROC bool VL_TraceSave(const char *path)
+{
+    if(!VL_trace.enabled) {
+        VL_Log(VL_ERROR, "Could not save trace '%s': VL_TraceEnable was not called", path);
+        return false;
+    }
+    u64 now = VL_GetNanos();
+    // NOTE: Threads other than the main one get a row after the job slots
+    struct {
+        u64 *items;
+        size_t count;
+        size_t capacity;
+    } threads = {0};
+    vl_serialize_context ctx = GetSerializeContext(SerializeType_JSON, .float_fmt = "%.3f");
+
+    VL_MutexLock(&VL_trace.lock);
+    int64_t threadBase = VL_trace.slots.count > 0 ? (int64_t)VL_trace.slots.count : 1;
+    VL_ObjectBegin(&ctx);
+        VL_AttributeName(&ctx, "traceEvents");
+        VL_ArrayBegin(&ctx);
+            VL__TraceThreadName(&ctx, 0, "build");
+            for(size_t slot = 1; slot < VL_trace.slots.count; slot++) {
+                VL__TraceThreadName(&ctx, (int64_t)slot, temp_sprintf("job slot %zu", slot));
+            }
+
+            for(size_t i = 0; i < VL_trace.events.count; i++) {
+                vl_trace_event *event = &VL_trace.events.items[i];
+                int64_t tid = (int64_t)event->slot;
+                if(!event->slot && event->thread != VL_trace.mainThread) {
+                    size_t t = 0;
+                    while(t < threads.count && threads.items[t] != event->thread) t++;
+                    if(t == threads.count) {
+                        DaAppend(&threads, event->thread);
+                        VL__TraceThreadName(&ctx, threadBase + (int64_t)t, temp_sprintf("thread %zu", t + 1));
+                    }
+                    tid = threadBase + (int64_t)t;
+                }
+                u64 end = event->end ? event->end : now;
+
+                VL_ObjectBegin(&ctx);
+                    VL_AttributeName(&ctx, "name");
+                    VL_SerializeString(&ctx, event->name);
+                    VL_AttributeName(&ctx, "cat");
+                    VL_SerializeString(&ctx, event->category);
+                    VL_AttributeName(&ctx, "ph");
+                    VL_SerializeString(&ctx, "X");
+                    // NOTE: Microseconds
+                    VL_AttributeName(&ctx, "ts");
+                    VL_SerializeFloat(&ctx, (double)(event->start - VL_trace.origin)/1000.0);
+                    VL_AttributeName(&ctx, "dur");
+                    VL_SerializeFloat(&ctx, (double)(end - event->start)/1000.0);
+                    VL_AttributeName(&ctx, "pid");
+                    VL_SerializeInt(&ctx, 1);
+                    VL_AttributeName(&ctx, "tid");
+                    VL_SerializeInt(&ctx, tid);
+                VL_ObjectEnd(&ctx);
+            }
+        VL_ArrayEnd(&ctx);
+        VL_AttributeName(&ctx, "displayTimeUnit");
+        VL_SerializeString(&ctx, "ms");
+    VL_ObjectEnd(&ctx);
+    VL_MutexUnlock(&VL_trace.lock);
+
+    bool result = WriteEntireFile(path, ctx.output.items, ctx.output.count);
+    if(!result) VL_Log(VL_ERROR, "Could not save trace '%s': %s", path, VL_GetError());
+    VL_SerializeFree(&ctx);
+    DaFree(threads);
+    return result;
+}
+
+static const char *VL__traceSavePath = NULL;
+
+static void VL__TraceSaveOnExit(void)
+{
+    if(VL__traceSavePath) VL_TraceSave(VL__traceSavePath);
+}
+
+SERIALIZE_PROC void VL_TraceSaveAtExit(const char *path)
+{
+    VL_TraceEnable();
+    if(!VL__traceSavePath) atexit(VL__TraceSaveOnExit);
+    VL__traceSavePath = path;
+}
+
 #endif // VL_SERIALIZE_IMPLEMENTATION
 #endif // VL_SERIALIZE_H
\ No newline at end of file